@@ -23,66 +23,77 @@
 #include "helper.h"
 
 /*
- * Hint where to look for the next free block (level 0 only).
- * Updated if a free block is found. If the level 0 amap bitmap
- * block is exhausted we still scan all amap blocks.
+ * In-memory copy of the level 0 allocation map bitmaps. The bitmaps are
+ * concatenated in disk order, so bit n (MSB first) stands for disk block n.
+ * Every change is written through to the on-disk amap.
  */
-struct amap_alloction_hint {
-	/* addr of amap bitmap block to check */
-	off_t amap_addr;
-	/* disk addr of the last allocated or freed block */
-	off_t addr;
-	/* offset to start of the amap data block */
-	off_t offset;
+struct amap_index {
+	/* disk addresses of the level 0 bitmap blocks */
+	off_t		*blocks;
+	int		nr_blocks;
+	int		max_blocks;
+	/* bitmap copy, accessed in 64 bit words while searching */
+	u64		*map;
+	size_t		words;
+	/* all words below the hint are fully allocated */
+	size_t		hint;
 };
 
-static struct amap_alloction_hint amap_hint;
-
-static void update_amap_hint(off_t amap_addr, off_t addr)
-{
-	amap_hint.amap_addr = amap_addr;
-	amap_hint.addr = addr;
-}
+static struct amap_index amap_idx;
 
 /*
- * Get L1 block number from address.
+ * Collect the level 0 bitmap blocks and copy them into memory.
  */
-static int amap_blocknumber(off_t addr)
+static void amap_index_scan(int level, off_t amap)
 {
-	return addr / BYTES_PER_BLOCK;
+	off_t ptr;
+	int i, rc;
+
+	if (level > 0) {
+		for (i = 0; i < PTRS_PER_BLOCK; i++) {
+			ptr = get_fixed_pointer(amap + (off_t) i * PTR_SIZE);
+			if (!ptr)
+				return;
+			amap_index_scan(level - 1, ptr);
+		}
+		return;
+	}
+
+	if (amap_idx.nr_blocks == amap_idx.max_blocks)
+		return;
+	rc = _read((char *) amap_idx.map +
+		   (size_t) amap_idx.nr_blocks * cmsfs.blksize,
+		   cmsfs.blksize, amap);
+	BUG(rc < 0);
+	amap_idx.blocks[amap_idx.nr_blocks++] = amap;
 }
 
 /*
- * Get the block number for a specific level.
+ * Build the allocation map index, must be called once at mount time.
  */
-static int amap_blocknumber_level(int level, off_t addr)
+void init_amap(void)
 {
-	int entry = amap_blocknumber(addr);
-
-	while (level-- > 1)
-		entry /= PTRS_PER_BLOCK;
-	return entry;
+	off_t bits = (off_t) cmsfs.blksize * 8;
+
+	amap_idx.max_blocks = (cmsfs.total_blocks + bits - 1) / bits;
+	amap_idx.blocks = calloc(amap_idx.max_blocks, sizeof(off_t));
+	amap_idx.map = calloc(amap_idx.max_blocks, cmsfs.blksize);
+	if (amap_idx.blocks == NULL || amap_idx.map == NULL)
+		DIE_PERROR("malloc failed");
+
+	amap_index_scan(cmsfs.amap_levels, cmsfs.amap);
+	amap_idx.words = (size_t) amap_idx.nr_blocks * cmsfs.blksize /
+		sizeof(u64);
+	amap_idx.hint = 0;
+	DEBUG("amap: %d bitmap blocks\n", amap_idx.nr_blocks);
 }
 
 /*
- * Return address of to the allocation map for a block number > 0.
+ * Return the on-disk address of a byte of the concatenated bitmap.
  */
-static off_t get_amap_addr(int level, off_t addr, off_t ptr)
+static off_t amap_byte_addr(size_t byte)
 {
-	int block = amap_blocknumber_level(level, addr) % PTRS_PER_BLOCK;
-
-	if (cmsfs.amap_levels == 0)
-		return cmsfs.amap;
-
-	if (level--) {
-		ptr = get_fixed_pointer(ptr + (off_t) block * PTR_SIZE);
-		if (!ptr)
-			DIE("amap invalid ptr at addr: %llx\n",
-				(unsigned long long) ptr +
-				(off_t) block * PTR_SIZE);
-		return get_amap_addr(level, addr, ptr);
-	}
-	return ptr;
+	return amap_idx.blocks[byte / cmsfs.blksize] + byte % cmsfs.blksize;
 }
 
 /*
@@ -109,37 +120,36 @@ static void amap_block_set(off_t amap, int bit)
  */
 static void amap_block_clear(off_t addr)
 {
-	off_t amap = get_amap_addr(cmsfs.amap_levels, addr, cmsfs.amap);
-	int rc, block = amap_blocknumber(addr);
-	off_t disk_addr = addr;
-	unsigned int byte, bit;
+	off_t block = addr >> BITS_PER_DATA_BLOCK;
+	u8 *bytes = (u8 *) amap_idx.map;
+	size_t byte = block / 8;
+	unsigned int bit = block % 8;
+	off_t amap;
 	u8 entry;
+	int rc;
 
-	if (block > 0)
-		addr -= (off_t) block * BYTES_PER_BLOCK;
-
-	addr >>= BITS_PER_DATA_BLOCK;
-	byte = addr / 8;
-	bit = addr % 8;
+	BUG(byte >= amap_idx.words * sizeof(u64));
+	amap = amap_byte_addr(byte);
 
-	rc = _read(&entry, sizeof(entry), amap + byte);
+	rc = _read(&entry, sizeof(entry), amap);
 	BUG(rc < 0);
 
 	/* already cleared */
 	BUG(!(entry & (1 << (7 - bit))));
 
 	entry &= ~(1 << (7 - bit));
-	rc = _write(&entry, sizeof(entry), amap + byte);
+	rc = _write(&entry, sizeof(entry), amap);
 	BUG(rc < 0);
+	bytes[byte] = entry;
 
 	/*
-	 * If the freed addr is lower set the hint to it to ensure
-	 * the amap bitmap is packed from the start. That way we do not
-	 * need an extra check if the bitmap entry is above disk end, the
-	 * check if we overflow the total block limit is sufficient.
+	 * Move the hint back to ensure the amap bitmap is packed from the
+	 * start. That way we do not need an extra check if the bitmap entry
+	 * is above disk end, the check if we overflow the total block limit
+	 * is sufficient.
 	 */
-	if (disk_addr < amap_hint.addr)
-		update_amap_hint(amap + byte, disk_addr);
+	if (byte / sizeof(u64) < amap_idx.hint)
+		amap_idx.hint = byte / sizeof(u64);
 }
 
 /*
@@ -156,92 +166,31 @@ static inline int find_first_empty_bit(u8 entry)
 	return -1;
 }
 
-/*
- * Return the number of bytes addressed by one pointer entry for the
- * specified level.
- */
-static off_t bytes_per_level(int level)
-{
-	off_t mult = BYTES_PER_BLOCK;
-
-	if (!level)
-		return 0;
-	level--;
-	while (level--)
-		mult *= PTRS_PER_BLOCK;
-	return mult;
-}
-
-static inline int get_amap_entry_bit(off_t amap)
-{
-	u8 entry;
-	int rc;
-
-	rc = _read(&entry, sizeof(entry), amap);
-	BUG(rc < 0);
-
-	if (entry == 0xff)
-		return -1;
-	return find_first_empty_bit(entry);
-}
-
-static off_t __get_free_block_fast(void)
-{
-	off_t addr, amap = amap_hint.amap_addr & ~DATA_BLOCK_MASK;
-	int bit, i = amap_hint.amap_addr & DATA_BLOCK_MASK;
-
-	for (; i < cmsfs.blksize; i++) {
-		bit = get_amap_entry_bit(amap + i);
-		if (bit == -1)
-			continue;
-
-		/* Calculate the addr for the free block we've found. */
-		addr = (off_t) amap_blocknumber(amap_hint.addr) * BYTES_PER_BLOCK;
-		addr += i * 8 * cmsfs.blksize;
-		addr += bit * cmsfs.blksize;
-
-		amap_block_set(amap + i, bit);
-		update_amap_hint(amap + i, addr);
-		return addr;
-	}
-	return 0;
-}
-
 /*
  * Look for the first unallocated block and return addr of allocated block.
+ * Fully allocated words below the hint are never scanned again, so the
+ * amortized cost of an allocation is constant.
  */
-static off_t __get_free_block(int level, off_t amap, off_t addr)
+static off_t __get_free_block(void)
 {
-	off_t ptr;
-	int bit, i;
-
-	if (level > 0) {
-		for (i = 0; i < PTRS_PER_BLOCK; i++) {
-			ptr = get_fixed_pointer(amap);
-			if (!ptr)
-				return 0;
-			ptr = __get_free_block(level - 1, ptr,
-				addr + i * bytes_per_level(level));
-			if (ptr)
-				return ptr;
-			amap += PTR_SIZE;
-		}
+	u8 *bytes = (u8 *) amap_idx.map;
+	size_t w = amap_idx.hint;
+	size_t byte;
+	int bit;
+
+	while (w < amap_idx.words && amap_idx.map[w] == ~0ULL)
+		w++;
+	amap_idx.hint = w;
+	if (w == amap_idx.words)
 		return 0;
-	}
 
-	for (i = 0; i < cmsfs.blksize; i++) {
-		bit = get_amap_entry_bit(amap + i);
-		if (bit == -1)
-			continue;
-		amap_block_set(amap + i, bit);
-		/* add byte offset */
-		addr += i * 8 * cmsfs.blksize;
-		/* add bit offset */
-		addr += bit * cmsfs.blksize;
-		update_amap_hint(amap + i, addr);
-		return addr;
-	}
-	return 0;
+	for (byte = w * sizeof(u64); bytes[byte] == 0xff; byte++)
+		;
+	bit = find_first_empty_bit(bytes[byte]);
+	amap_block_set(amap_byte_addr(byte), bit);
+	bytes[byte] |= 1 << (7 - bit);
+
+	return ((off_t) byte * 8 + bit) * cmsfs.blksize;
 }
 
 /*
@@ -249,14 +198,11 @@ static off_t __get_free_block(int level, off_t amap, off_t addr)
  */
 off_t get_free_block(void)
 {
-	off_t addr = 0;
+	off_t addr;
 
 	if (cmsfs.used_blocks + cmsfs.reserved_blocks >= cmsfs.total_blocks)
 		return -ENOSPC;
-	if (amap_hint.amap_addr)
-		addr = __get_free_block_fast();
-	if (!addr)
-		addr = __get_free_block(cmsfs.amap_levels, cmsfs.amap, 0);
+	addr = __get_free_block();
 	BUG(!addr);
 
 	cmsfs.used_blocks++;
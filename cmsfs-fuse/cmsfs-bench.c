@@ -0,0 +1,435 @@
+/*
+ * cmsfs-fuse - CMS EDF filesystem support for Linux
+ *
+ * Benchmark for codepage conversion and block allocation
+ *
+ * Translate EBCDIC text records to ASCII and back with the translation
+ * table and with iconv() and verify that both produce the same output.
+ *
+ * Fill a nearly full disk image with data blocks, once with the allocation
+ * map index and once with the previous search through the on-disk
+ * allocation map, and verify that both allocate the same blocks.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib/zt_common.h"
+
+#include "cmsfs-fuse.h"
+#include "edf.h"
+#include "helper.h"
+
+#define DEFAULT_SIZE	(64 * 1024 * 1024)
+/* Disk image with 1 GiB and 95 percent of the blocks in use */
+#define IMAGE_BLKSIZE	4096
+#define IMAGE_BLOCKS	(256 * 1024)
+#define IMAGE_FILL	95
+
+struct cmsfs cmsfs;
+FILE *logfile;
+
+static struct timespec start_ts;
+
+static void timer_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+}
+
+static void timer_report(const char *name, unsigned long count,
+			 size_t bytes)
+{
+	struct timespec ts;
+	double sec;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sec = (ts.tv_sec - start_ts.tv_sec) +
+		(ts.tv_nsec - start_ts.tv_nsec) / 1e9;
+	printf("%-28s %10lu %10.3f s %8.1f MiB/s\n", name, count, sec,
+	       bytes / sec / (1024 * 1024));
+	fflush(stdout);
+}
+
+/*
+ * Convert @size bytes in records of @reclen bytes like cmsfs_read() and
+ * cmsfs_write() do
+ */
+static void convert_records(const char *name, struct codepage_conv *conv,
+			    char *in, char *out, size_t size, int reclen)
+{
+	unsigned long count = 0;
+	size_t off;
+	int len;
+
+	timer_start();
+	for (off = 0; off < size; off += len) {
+		len = MIN((size_t) reclen, size - off);
+		if (convert_text(conv, in + off, out + off, len)) {
+			fprintf(stderr, "%s: conversion failed\n", name);
+			exit(EXIT_FAILURE);
+		}
+		count++;
+	}
+	timer_report(name, count, size);
+}
+
+/*
+ * Compare table and iconv for one direction and record length
+ */
+static void bench_conv(const char *dir, struct codepage_conv *conv,
+		       char *in, size_t size, int reclen)
+{
+	struct codepage_conv conv_iconv = *conv;
+	char *out_table, *out_iconv, name[32];
+
+	out_table = malloc(size);
+	out_iconv = malloc(size);
+	if (!out_table || !out_iconv)
+		DIE_PERROR("malloc failed");
+
+	conv_iconv.sbcs = 0;
+	snprintf(name, sizeof(name), "%s table %d", dir, reclen);
+	convert_records(name, conv, in, out_table, size, reclen);
+	snprintf(name, sizeof(name), "%s iconv %d", dir, reclen);
+	convert_records(name, &conv_iconv, in, out_iconv, size, reclen);
+	if (memcmp(out_table, out_iconv, size) != 0) {
+		fprintf(stderr, "%s: table and iconv output differ\n", dir);
+		exit(EXIT_FAILURE);
+	}
+	free(out_table);
+	free(out_iconv);
+}
+
+/*
+ * Disk access on the mapped image file, like cmsfs-fuse does with mmap
+ */
+int _read(void *buf, size_t size, off_t addr)
+{
+	memcpy(buf, cmsfs.map + addr, size);
+	return 0;
+}
+
+int _write(const void *buf, size_t size, off_t addr)
+{
+	if (buf == NULL)
+		memset(cmsfs.map + addr, 0, size);
+	else
+		memcpy(cmsfs.map + addr, buf, size);
+	return 0;
+}
+
+int _zero(off_t addr, size_t size)
+{
+	return _write(NULL, size, addr);
+}
+
+off_t get_fixed_pointer(off_t addr)
+{
+	struct fixed_ptr ptr;
+
+	if (!addr)
+		return NULL_BLOCK;
+	_read(&ptr, sizeof(ptr), addr);
+	if (!ptr.next)
+		return NULL_BLOCK;
+	return ABS((off_t) ptr.next);
+}
+
+/*
+ * Previous block allocation that searches the on-disk allocation map
+ */
+static struct {
+	off_t amap_addr;
+	off_t addr;
+} old_hint;
+
+static void old_update_hint(off_t amap_addr, off_t addr)
+{
+	old_hint.amap_addr = amap_addr;
+	old_hint.addr = addr;
+}
+
+static int old_amap_blocknumber(off_t addr)
+{
+	return addr / BYTES_PER_BLOCK;
+}
+
+static off_t old_bytes_per_level(int level)
+{
+	off_t mult = BYTES_PER_BLOCK;
+
+	if (!level)
+		return 0;
+	level--;
+	while (level--)
+		mult *= PTRS_PER_BLOCK;
+	return mult;
+}
+
+static int old_get_amap_entry_bit(off_t amap)
+{
+	u8 entry;
+	int i;
+
+	_read(&entry, sizeof(entry), amap);
+	if (entry == 0xff)
+		return -1;
+	for (i = 0; i < 8; i++)
+		if (!(entry & 1 << (7 - i)))
+			return i;
+	return -1;
+}
+
+static void old_amap_block_set(off_t amap, int bit)
+{
+	u8 entry;
+
+	_read(&entry, sizeof(entry), amap);
+	entry |= (1 << (7 - bit));
+	_write(&entry, sizeof(entry), amap);
+}
+
+static off_t old_get_free_block_fast(void)
+{
+	off_t addr, amap = old_hint.amap_addr & ~DATA_BLOCK_MASK;
+	int bit, i = old_hint.amap_addr & DATA_BLOCK_MASK;
+
+	for (; i < cmsfs.blksize; i++) {
+		bit = old_get_amap_entry_bit(amap + i);
+		if (bit == -1)
+			continue;
+		addr = (off_t) old_amap_blocknumber(old_hint.addr) *
+			BYTES_PER_BLOCK;
+		addr += i * 8 * cmsfs.blksize;
+		addr += bit * cmsfs.blksize;
+		old_amap_block_set(amap + i, bit);
+		old_update_hint(amap + i, addr);
+		return addr;
+	}
+	return 0;
+}
+
+static off_t old_get_free_block_scan(int level, off_t amap, off_t addr)
+{
+	off_t ptr;
+	int bit, i;
+
+	if (level > 0) {
+		for (i = 0; i < PTRS_PER_BLOCK; i++) {
+			ptr = get_fixed_pointer(amap);
+			if (!ptr)
+				return 0;
+			ptr = old_get_free_block_scan(level - 1, ptr,
+				addr + i * old_bytes_per_level(level));
+			if (ptr)
+				return ptr;
+			amap += PTR_SIZE;
+		}
+		return 0;
+	}
+
+	for (i = 0; i < cmsfs.blksize; i++) {
+		bit = old_get_amap_entry_bit(amap + i);
+		if (bit == -1)
+			continue;
+		old_amap_block_set(amap + i, bit);
+		addr += i * 8 * cmsfs.blksize;
+		addr += bit * cmsfs.blksize;
+		old_update_hint(amap + i, addr);
+		return addr;
+	}
+	return 0;
+}
+
+static off_t old_get_free_block(void)
+{
+	off_t addr = 0;
+
+	if (cmsfs.used_blocks + cmsfs.reserved_blocks >= cmsfs.total_blocks)
+		return -ENOSPC;
+	if (old_hint.amap_addr)
+		addr = old_get_free_block_fast();
+	if (!addr)
+		addr = old_get_free_block_scan(cmsfs.amap_levels, cmsfs.amap,
+					       0);
+	BUG(!addr);
+
+	cmsfs.used_blocks++;
+	return addr;
+}
+
+/*
+ * Create the disk image. Block 1 holds the pointers to the allocation map
+ * blocks, which follow directly.
+ */
+static void image_create(void)
+{
+	char path[] = "/tmp/cmsfs-bench.XXXXXX";
+	int fd;
+
+	cmsfs.blksize = IMAGE_BLKSIZE;
+	cmsfs.total_blocks = IMAGE_BLOCKS;
+	cmsfs.size = (off_t) cmsfs.total_blocks * cmsfs.blksize;
+	cmsfs.data_block_mask = cmsfs.blksize - 1;
+	cmsfs.fixed_ptrs_per_block = cmsfs.blksize / sizeof(struct fixed_ptr);
+	cmsfs.bits_per_data_block = __builtin_ctz(cmsfs.blksize);
+	cmsfs.amap_bytes_per_block = (off_t) cmsfs.blksize * 8 *
+		cmsfs.blksize;
+	cmsfs.amap_levels = 1;
+	cmsfs.amap = cmsfs.blksize;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		DIE_PERROR("Could not create image file");
+	unlink(path);
+	if (ftruncate(fd, cmsfs.size))
+		DIE_PERROR("Could not resize image file");
+	cmsfs.map = mmap(NULL, cmsfs.size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+	if (cmsfs.map == MAP_FAILED)
+		DIE_PERROR("Could not map image file");
+	cmsfs.fd = fd;
+}
+
+/*
+ * Write the allocation map with IMAGE_FILL percent of the blocks in use.
+ * Return the number of free blocks.
+ */
+static int image_fill(void)
+{
+	int bits = cmsfs.blksize * 8, nr_maps, block, i;
+	off_t map = cmsfs.amap + cmsfs.blksize;
+	struct fixed_ptr ptr;
+	u8 *bytes;
+
+	nr_maps = (cmsfs.total_blocks + bits - 1) / bits;
+	memset(cmsfs.map + cmsfs.amap, 0, cmsfs.blksize);
+	for (i = 0; i < nr_maps; i++) {
+		ptr.next = REL((map + (off_t) i * cmsfs.blksize));
+		_write(&ptr, sizeof(ptr), cmsfs.amap + i * PTR_SIZE);
+	}
+
+	bytes = (u8 *) cmsfs.map + map;
+	memset(bytes, 0xff, (size_t) nr_maps * cmsfs.blksize);
+	srand(2);
+	cmsfs.used_blocks = cmsfs.total_blocks;
+	for (block = 2 + nr_maps; block < cmsfs.total_blocks; block++) {
+		if (rand() % 100 < IMAGE_FILL)
+			continue;
+		bytes[block / 8] &= ~(1 << (7 - block % 8));
+		cmsfs.used_blocks--;
+	}
+	old_update_hint(0, 0);
+	return cmsfs.total_blocks - cmsfs.used_blocks;
+}
+
+/*
+ * Write @count data blocks, each to a block returned by @alloc_fn
+ */
+static void bench_write(const char *name, off_t (*alloc_fn)(void),
+			off_t *addr_vec, int count)
+{
+	char data[IMAGE_BLKSIZE];
+	int i;
+
+	memset(data, 0x40, sizeof(data));
+	timer_start();
+	for (i = 0; i < count; i++) {
+		addr_vec[i] = alloc_fn();
+		if (addr_vec[i] <= 0)
+			DIE("%s: allocation failed\n", name);
+		_write(data, cmsfs.blksize, addr_vec[i]);
+	}
+	timer_report(name, count, (size_t) count * cmsfs.blksize);
+}
+
+/*
+ * Fill the free blocks of the image with the previous and the new allocation
+ */
+static void bench_amap(void)
+{
+	off_t *old_vec, *new_vec;
+	int count;
+
+	image_create();
+	count = image_fill();
+	old_vec = malloc(count * sizeof(off_t));
+	new_vec = malloc(count * sizeof(off_t));
+	if (!old_vec || !new_vec)
+		DIE_PERROR("malloc failed");
+
+	bench_write("write amap search", old_get_free_block, old_vec, count);
+	image_fill();
+	init_amap();
+	bench_write("write amap index", get_free_block, new_vec, count);
+	if (memcmp(old_vec, new_vec, count * sizeof(off_t)) != 0)
+		DIE("Allocated blocks differ\n");
+
+	munmap(cmsfs.map, cmsfs.size);
+	close(cmsfs.fd);
+	free(old_vec);
+	free(new_vec);
+}
+
+/*
+ * Run the benchmarks with an optional data size and codepages
+ */
+int main(int argc, char *argv[])
+{
+	const char *cp_ebcdic = "CP1047", *cp_ascii = "ISO-8859-1";
+	size_t size = DEFAULT_SIZE, i;
+	char *ascii, *ebcdic;
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 0);
+	if (argc > 3) {
+		cp_ebcdic = argv[2];
+		cp_ascii = argv[3];
+	}
+	if (!size) {
+		fprintf(stderr, "Usage: %s [SIZE [EBCDIC ASCII]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	setup_iconv(&cmsfs.conv_from, cp_ebcdic, cp_ascii);
+	setup_iconv(&cmsfs.conv_to, cp_ascii, cp_ebcdic);
+	if (!cmsfs.conv_from.sbcs || !cmsfs.conv_to.sbcs) {
+		fprintf(stderr, "%s and %s are not both single byte\n",
+			cp_ebcdic, cp_ascii);
+		return EXIT_FAILURE;
+	}
+
+	/* Printable ASCII text */
+	ascii = malloc(size);
+	ebcdic = malloc(size);
+	if (!ascii || !ebcdic)
+		DIE_PERROR("malloc failed");
+	srand(1);
+	for (i = 0; i < size; i++)
+		ascii[i] = ' ' + rand() % ('~' - ' ' + 1);
+	if (convert_text(&cmsfs.conv_to, ascii, ebcdic, size))
+		DIE("Could not convert test data\n");
+
+	printf("%-28s %10s %12s %14s\n", "Benchmark", "Records", "Time",
+	       "Throughput");
+	bench_conv("read", &cmsfs.conv_from, ebcdic, size, 80);
+	bench_conv("read", &cmsfs.conv_from, ebcdic, size, 4096);
+	bench_conv("write", &cmsfs.conv_to, ascii, size, 80);
+	bench_conv("write", &cmsfs.conv_to, ascii, size, 4096);
+	free(ascii);
+	free(ebcdic);
+
+	printf("\n%-28s %10s %12s %14s\n", "Benchmark", "Blocks", "Time",
+	       "Throughput");
+	bench_amap();
+	return EXIT_SUCCESS;
+}
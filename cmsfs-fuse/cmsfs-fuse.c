@@ -23,7 +23,6 @@
 #include <linux/xattr.h>
 #endif
 #include <math.h>
-#include <search.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -254,6 +253,8 @@ struct file {
 	int		write_count;
 	/* unlink flag */
 	int		unlinked;
+	/* serializes concurrent readers of the record list and iconv buffer */
+	pthread_mutex_t	lock;
 };
 
 struct xattr {
@@ -273,15 +274,13 @@ static struct xattr xattr_mode = { .name = "user.file_mode", .size = 2 };
 #define SHOW_UNLINKED		0
 #define HIDE_UNLINKED		1
 
-#define WALK_FLAG_LOOKUP	0x1
+#define WALK_FLAG_INDEX		0x1
 #define WALK_FLAG_READDIR	0x2
 #define WALK_FLAG_LOCATE_EMPTY	0x4
 #define WALK_FLAG_CACHE_DBLOCKS	0x8
 
 struct walk_file {
 	int		flag;
-	char		*name;
-	char		*type;
 	void		*buf;
 	off_t		addr;
 	fuse_fill_dir_t	filler;
@@ -311,14 +310,6 @@ static unsigned int hex_to_dec(unsigned int num)
 	return res & 0xffffffff;
 }
 
-static void setup_iconv(iconv_t *conv, const char *from, const char *to)
-{
-	*conv = iconv_open(to, from);
-	if (*conv == ((iconv_t) -1))
-		DIE("Could not initialize conversion table %s->%s.\n",
-			from, to);
-}
-
 static inline struct file *get_fobj(struct fuse_file_info *fi)
 {
 	return (struct file *)(unsigned long) fi->fh;
@@ -1365,105 +1356,136 @@ static int linefeed_mode_enabled(struct fst_entry *fst)
 }
 
 /*
- * Workaround glibc 2.9 bug with less than 3 files and give room for some
- * new files. If cache is full it will be purged and rebuild.
+ * Index of all FST entries on the disk, hashed by the EBCDIC file name and
+ * type. It is built at mount time and kept up to date by every operation
+ * that adds, moves or removes an FST entry, so lookups never have to walk
+ * the directory. Modifications require the exclusive lock.
  */
-static int max_cache_entries(void)
-{
-	return cmsfs.files + 10 + cmsfs.files / 4;
-}
+#define FST_INDEX_MIN		64
 
-static void resize_htab(void)
+static unsigned int fst_index_hash(const char *fname, const char *ftype)
 {
+	unsigned int hash = 2166136261U;
 	int i;
 
-	for (i = 0; i < cmsfs.fcache_used; i++)
-		free(cmsfs.fcache[i].str);
-	hdestroy_r(&cmsfs.htab);
-	free(cmsfs.fcache);
-	cmsfs.fcache_used = 0;
-	cmsfs.fcache_max = max_cache_entries();
-
-	cmsfs.fcache = calloc(cmsfs.fcache_max, sizeof(struct fcache_entry));
-	if (!hcreate_r(cmsfs.fcache_max, &cmsfs.htab))
-		DIE("hcreate failed\n");
+	for (i = 0; i < 8; i++)
+		hash = (hash ^ (unsigned char) fname[i]) * 16777619U;
+	for (i = 0; i < 8; i++)
+		hash = (hash ^ (unsigned char) ftype[i]) * 16777619U;
+	return hash;
 }
 
-static void cache_fst_addr(off_t addr, const char *file)
+static struct fst_index_entry **fst_index_slot(const char *fname,
+					       const char *ftype)
 {
-	struct fcache_entry *fce;
-	ENTRY e, *eptr;
+	unsigned int hash = fst_index_hash(fname, ftype);
+	struct fst_index_entry **slot;
+
+	slot = &cmsfs.fidx[hash & (cmsfs.fidx_size - 1)];
+	while (*slot != NULL) {
+		if (memcmp((*slot)->fname, fname, 8) == 0 &&
+		    memcmp((*slot)->ftype, ftype, 8) == 0)
+			break;
+		slot = &(*slot)->next;
+	}
+	return slot;
+}
 
-	e.key = strdup(file);
+static void fst_index_resize(unsigned int size)
+{
+	struct fst_index_entry **old = cmsfs.fidx, *fie, *next;
+	unsigned int i, old_size = cmsfs.fidx_size;
+	unsigned int hash;
 
-again:
-	if (hsearch_r(e, FIND, &eptr, &cmsfs.htab) == 0) {
-		/* cache it */
-		if (cmsfs.fcache_used == cmsfs.fcache_max - 1) {
-			DEBUG("hsearch: hash table full: %d\n", cmsfs.fcache_used);
-			resize_htab();
-			goto again;
+	cmsfs.fidx = calloc(size, sizeof(*cmsfs.fidx));
+	if (cmsfs.fidx == NULL)
+		DIE_PERROR("malloc failed");
+	cmsfs.fidx_size = size;
+
+	for (i = 0; i < old_size; i++) {
+		for (fie = old[i]; fie != NULL; fie = next) {
+			next = fie->next;
+			hash = fst_index_hash(fie->fname, fie->ftype);
+			fie->next = cmsfs.fidx[hash & (size - 1)];
+			cmsfs.fidx[hash & (size - 1)] = fie;
 		}
+	}
+	free(old);
+}
 
-		fce = &cmsfs.fcache[cmsfs.fcache_used];
-		cmsfs.fcache_used++;
-		fce->fst_addr = addr;
-		fce->str = e.key;
+static off_t fst_index_find(const char *fname, const char *ftype)
+{
+	struct fst_index_entry *fie = *fst_index_slot(fname, ftype);
 
-		e.data = fce;
-		if (hsearch_r(e, ENTER, &eptr, &cmsfs.htab) == 0)
-			DIE("hsearch: hash table full\n");
-	} else
-		free(e.key);
+	return fie ? fie->fst_addr : 0;
 }
 
-static void update_htab_entry(off_t addr, const char *file)
+static void fst_index_add(const char *fname, const char *ftype, off_t addr)
 {
-	struct fcache_entry *fce;
-	ENTRY e, *eptr;
+	struct fst_index_entry **slot = fst_index_slot(fname, ftype);
+	struct fst_index_entry *fie = *slot;
 
-	e.key = strdup(file);
-
-	if (hsearch_r(e, FIND, &eptr, &cmsfs.htab) == 0) {
-		/* not yet cached, nothing to do */
-		free(e.key);
+	if (fie != NULL) {
+		fie->fst_addr = addr;
 		return;
-	} else {
-		/* update it */
-		fce = eptr->data;
-		fce->fst_addr = addr;
-		e.data = fce;
-		if (hsearch_r(e, ENTER, &eptr, &cmsfs.htab) == 0)
-			DIE("%s: hash table full\n", __func__);
 	}
+
+	fie = malloc(sizeof(*fie));
+	if (fie == NULL)
+		DIE_PERROR("malloc failed");
+	memcpy(fie->fname, fname, 8);
+	memcpy(fie->ftype, ftype, 8);
+	fie->fst_addr = addr;
+	fie->next = NULL;
+	*slot = fie;
+
+	/* keep the average chain length below one */
+	if (++cmsfs.fidx_used > cmsfs.fidx_size)
+		fst_index_resize(cmsfs.fidx_size * 2);
 }
 
-static void invalidate_htab_entry(const char *name)
+static void fst_index_update(const char *fname, const char *ftype, off_t addr)
 {
-	struct fcache_entry *fce;
-	ENTRY e, *eptr;
+	struct fst_index_entry *fie = *fst_index_slot(fname, ftype);
 
-	e.key = strdup(name);
+	BUG(fie == NULL);
+	fie->fst_addr = addr;
+}
+
+static void fst_index_remove(const char *fname, const char *ftype)
+{
+	struct fst_index_entry **slot = fst_index_slot(fname, ftype);
+	struct fst_index_entry *fie = *slot;
 
-	if (hsearch_r(e, FIND, &eptr, &cmsfs.htab) == 0) {
-		/* nothing to do if not cached */
-		free(e.key);
+	if (fie == NULL)
 		return;
-	}
+	*slot = fie->next;
+	free(fie);
+	cmsfs.fidx_used--;
+}
+
+static void fst_index_free(void)
+{
+	struct fst_index_entry *fie, *next;
+	unsigned int i;
 
-	fce = eptr->data;
-	fce->fst_addr = 0;
-	e.data = fce;
-	if (hsearch_r(e, ENTER, &eptr, &cmsfs.htab) == 0)
-		DIE("hsearch: hash table full\n");
+	for (i = 0; i < cmsfs.fidx_size; i++) {
+		for (fie = cmsfs.fidx[i]; fie != NULL; fie = next) {
+			next = fie->next;
+			free(fie);
+		}
+	}
+	free(cmsfs.fidx);
+	cmsfs.fidx = NULL;
+	cmsfs.fidx_size = cmsfs.fidx_used = 0;
 }
 
 /*
  * For each FST entry in a directory block do action.
  *
  * Return:
- *	hit == NULL : lookup file not found
- *	hit != NULL : lookup file found, addr of the fst entry
+ *	*hit == 0 : no empty fst entry found
+ *	*hit != 0 : addr of the empty fst entry
  */
 static void walk_dir_block(struct fst_entry *fst, struct walk_file *walk,
 			   int level, off_t *hit)
@@ -1502,22 +1524,14 @@ static void walk_dir_block(struct fst_entry *fst, struct walk_file *walk,
 		/* directory and allocmap type are skipped */
 
 		if (ret == READDIR_FILE_ENTRY) {
-			if (walk->flag == WALK_FLAG_LOOKUP) {
-				if ((memcmp(fst->name, walk->name, 8) == 0) &&
-				    (memcmp(fst->type, walk->type, 8) == 0)) {
-					/* got it */
-					*hit = walk->addr;
-					return;
-				}
-			}
+			if (walk->flag == WALK_FLAG_INDEX)
+				fst_index_add(fst->name, fst->type, walk->addr);
 
 			if (walk->flag == WALK_FLAG_READDIR) {
 				memset(file, 0, sizeof(file));
 				decode_edf_name(file, fst->name, fst->type);
-				if (!file_unlinked(file)) {
-					cache_fst_addr(walk->addr, file);
+				if (!file_unlinked(file))
 					walk->filler(walk->buf, file, NULL, 0);
-				}
 			}
 		}
 
@@ -1543,6 +1557,21 @@ static void walk_directory(struct fst_entry *fst, struct walk_file *walk,
 	walk_dir_block(fst, walk, cmsfs.dir_levels, hit);
 }
 
+static void build_fst_index(void)
+{
+	struct walk_file walk;
+	struct fst_entry fst;
+	unsigned int size = FST_INDEX_MIN;
+
+	while (size < (unsigned int) cmsfs.files)
+		size *= 2;
+	fst_index_resize(size);
+
+	memset(&walk, 0, sizeof(walk));
+	walk.flag = WALK_FLAG_INDEX;
+	walk_directory(&fst, &walk, NULL);
+}
+
 /*
  * Check FST record format only when reading FST entry from disk.
  */
@@ -1560,12 +1589,9 @@ static int check_fst_valid(struct fst_entry *fst)
  */
 static off_t lookup_file(const char *name, struct fst_entry *fst, int flag)
 {
-	struct fcache_entry *fce;
 	char uc_name[MAX_FNAME];
 	char fname[8], ftype[8];
-	struct walk_file walk;
-	ENTRY e, *eptr;
-	off_t faddr = 0;
+	off_t faddr;
 	int rc;
 
 	util_strlcpy(uc_name, name, MAX_FNAME);
@@ -1574,41 +1600,18 @@ static off_t lookup_file(const char *name, struct fst_entry *fst, int flag)
 	if (flag == HIDE_UNLINKED && file_unlinked(uc_name))
 		return 0;
 
-	e.key = strdup(uc_name);
-
-	/* already cached ? */
-	if (hsearch_r(e, FIND, &eptr, &cmsfs.htab)) {
-		fce = eptr->data;
-
-		/* check if fst is valid, may be zero for a stale entry */
-		if (!fce->fst_addr)
-			goto renew;
-
-		/* read in the fst entry */
-		rc = _read(fst, sizeof(*fst), fce->fst_addr);
-		BUG(rc < 0);
-
-		if (!check_fst_valid(fst))
-			DIE("Invalid file format in file: %s\n", uc_name);
-
-		free(e.key);
-		return fce->fst_addr;
-	}
-
-renew:
-	free(e.key);
 	if (encode_edf_name(uc_name, fname, ftype))
 		return 0;
-	memset(&walk, 0, sizeof(walk));
-	walk.flag = WALK_FLAG_LOOKUP;
-	walk.name = fname;
-	walk.type = ftype;
-	walk_directory(fst, &walk, &faddr);
+	faddr = fst_index_find(fname, ftype);
 	if (!faddr)
 		return 0;
+
+	/* read in the fst entry */
+	rc = _read(fst, sizeof(*fst), faddr);
+	BUG(rc < 0);
+
 	if (!check_fst_valid(fst))
 		DIE("Invalid file format in file: %s\n", uc_name);
-	cache_fst_addr(faddr, uc_name);
 	return faddr;
 }
 
@@ -1728,7 +1731,7 @@ static off_t get_file_size_logical(struct fst_entry *fst)
 	return total;
 }
 
-static int cmsfs_getattr(const char *path, struct stat *stbuf)
+static int __cmsfs_getattr(const char *path, struct stat *stbuf)
 {
 	int mask = (cmsfs.allow_other) ? 0444 : 0440;
 	struct fst_entry fst;
@@ -1782,8 +1785,9 @@ static int cmsfs_getattr(const char *path, struct stat *stbuf)
 	return 0;
 }
 
-static int cmsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-			 off_t offset, struct fuse_file_info *fi)
+static int __cmsfs_readdir(const char *path, void *buf,
+			   fuse_fill_dir_t filler, off_t offset,
+			   struct fuse_file_info *fi)
 {
 	struct walk_file walk;
 	struct fst_entry fst;
@@ -1812,7 +1816,7 @@ static int cmsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	return 0;
 }
 
-static int cmsfs_open(const char *path, struct fuse_file_info *fi)
+static int __cmsfs_open(const char *path, struct fuse_file_info *fi)
 {
 	struct fst_entry fst;
 	struct file *f;
@@ -2099,8 +2103,8 @@ static void update_block_count(void)
 	BUG(rc < 0);
 }
 
-static int cmsfs_create(const char *path, mode_t mode,
-			struct fuse_file_info *fi)
+static int __cmsfs_create(const char *path, mode_t mode,
+			  struct fuse_file_info *fi)
 {
 	char fname[8], ftype[8];
 	char uc_name[MAX_FNAME];
@@ -2118,7 +2122,7 @@ static int cmsfs_create(const char *path, mode_t mode,
 	 * opened.
 	 */
 	if (lookup_file(path + 1, &fst, SHOW_UNLINKED))
-		return cmsfs_open(path, fi);
+		return __cmsfs_open(path, fi);
 
 	if (cmsfs.readonly)
 		return -EACCES;
@@ -2189,9 +2193,9 @@ static int cmsfs_create(const char *path, mode_t mode,
 
 	rc = _write(&fst, sizeof(fst), fst_addr);
 	BUG(rc < 0);
-	cache_fst_addr(fst_addr, uc_name);
+	fst_index_add(fname, ftype, fst_addr);
 	increase_file_count();
-	return cmsfs_open(path, fi);
+	return __cmsfs_open(path, fi);
 }
 
 static int purge_pointer_block_fixed(struct file *f, int level, off_t addr)
@@ -2570,22 +2574,8 @@ static void get_block_data_from_record(struct record *rec, off_t offset,
 	}
 }
 
-static int convert_text(iconv_t conv, char *in_buf, char *out_buf, int size)
-{
-	size_t out_count = size;
-	size_t in_count = size;
-	int rc;
-
-	rc = iconv(conv, &in_buf, &in_count, &out_buf, &out_count);
-	if ((rc == -1) || (in_count != 0)) {
-		DEBUG("Code page translation EBCDIC-ASCII failed\n");
-		return -EIO;
-	}
-	return 0;
-}
-
-static int cmsfs_read(const char *path, char *buf, size_t size, off_t offset,
-		      struct fuse_file_info *fi)
+static int __cmsfs_read(const char *path, char *buf, size_t size,
+			off_t offset, struct fuse_file_info *fi)
 {
 	struct file *f = get_fobj(fi);
 	size_t len, copied = 0;
@@ -2641,7 +2631,8 @@ static int cmsfs_read(const char *path, char *buf, size_t size, off_t offset,
 			rc = _read(f->iconv_buf, chunk, addr);
 			if (rc < 0)
 				return rc;
-			rc = convert_text(cmsfs.iconv_from, f->iconv_buf, buf, chunk);
+			rc = convert_text(&cmsfs.conv_from, f->iconv_buf, buf,
+					  chunk);
 			if (rc < 0)
 				return rc;
 		} else {
@@ -2660,7 +2651,7 @@ out:
 	return copied;
 }
 
-static int cmsfs_statfs(const char *path, struct statvfs *buf)
+static int __cmsfs_statfs(const char *path, struct statvfs *buf)
 {
 	unsigned int inode_size = cmsfs.blksize + sizeof(struct fst_entry);
 	unsigned int free_blocks = cmsfs.total_blocks - cmsfs.used_blocks;
@@ -2683,7 +2674,7 @@ static int cmsfs_statfs(const char *path, struct statvfs *buf)
 	return 0;
 }
 
-static int cmsfs_utimens(const char *path, const struct timespec ts[2])
+static int __cmsfs_utimens(const char *path, const struct timespec ts[2])
 {
 	struct fst_entry fst;
 	off_t fst_addr;
@@ -2776,10 +2767,8 @@ static int delete_file(const char *path)
 	else
 		fst_last = find_last_fdir_entry(cmsfs.fdir, cmsfs.dir_levels);
 
-	/* remove unlinked file from fcache */
-	util_strlcpy(file, path + 1, MAX_FNAME);
-	str_toupper(file);
-	invalidate_htab_entry(file);
+	/* remove unlinked file from the index */
+	fst_index_remove(f->fst->name, f->fst->type);
 
 	if (fst_last == fst_kill)
 		goto skip_copy;
@@ -2790,10 +2779,10 @@ static int delete_file(const char *path)
 	rc = _write(&fst, sizeof(struct fst_entry), fst_kill);
 	BUG(rc < 0);
 
-	/* update moved fcache entry */
+	/* update index entry of moved FST */
+	fst_index_update(fst.name, fst.type, fst_kill);
 	memset(file, 0, sizeof(file));
 	decode_edf_name(file, fst.name, fst.type);
-	update_htab_entry(fst_kill, file);
 	/* update cached address of moved FST */
 	f_moved = file_open(file);
 	if (f_moved != NULL)
@@ -2825,7 +2814,7 @@ error:
 	return rc;
 }
 
-static int cmsfs_rename(const char *path, const char *new_path)
+static int __cmsfs_rename(const char *path, const char *new_path)
 {
 	struct fst_entry fst, fst_new;
 	off_t fst_addr, fst_addr_new;
@@ -2865,12 +2854,12 @@ static int cmsfs_rename(const char *path, const char *new_path)
 	if (rc)
 		return rc;
 
+	fst_index_remove(fst.name, fst.type);
 	memcpy(&fst.name[0], fname, 8);
 	memcpy(&fst.type[0], ftype, 8);
 
 	util_strlcpy(uc_old_name, path + 1, MAX_FNAME);
 	str_toupper(uc_old_name);
-	invalidate_htab_entry(uc_old_name);
 
 	/* update name in file object if the file is opened */
 	f = file_open(uc_old_name);
@@ -2883,11 +2872,12 @@ static int cmsfs_rename(const char *path, const char *new_path)
 
 	rc = _write(&fst, sizeof(fst), fst_addr);
 	BUG(rc < 0);
+	fst_index_add(fname, ftype, fst_addr);
 	return 0;
 }
 
-static int cmsfs_fsync(const char *path, int datasync,
-		       struct fuse_file_info *fi)
+static int __cmsfs_fsync(const char *path, int datasync,
+			 struct fuse_file_info *fi)
 {
 	(void) path;
 	(void) datasync;
@@ -3232,7 +3222,7 @@ static void update_fst(struct file *f, off_t addr)
 	unhide_null_blocks(f);
 }
 
-static int cmsfs_truncate(const char *path, off_t size)
+static int __cmsfs_truncate(const char *path, off_t size)
 {
 	struct fst_entry fst;
 	off_t fst_addr, len;
@@ -3282,8 +3272,8 @@ static int cmsfs_truncate(const char *path, off_t size)
 }
 
 #ifdef HAVE_SETXATTR
-static int cmsfs_setxattr(const char *path, const char *name, const char *value,
-			  size_t size, int flags)
+static int __cmsfs_setxattr(const char *path, const char *name,
+			    const char *value, size_t size, int flags)
 {
 	struct fst_entry fst;
 	off_t fst_addr;
@@ -3361,8 +3351,8 @@ write:
 	return 0;
 }
 
-static int cmsfs_getxattr(const char *path, const char *name, char *value,
-			  size_t size)
+static int __cmsfs_getxattr(const char *path, const char *name,
+			    char *value, size_t size)
 {
 	char buf[xattr_lrecl.size + 1];
 	struct fst_entry fst;
@@ -3414,7 +3404,7 @@ static int cmsfs_getxattr(const char *path, const char *name, char *value,
 	return -ENODATA;
 }
 
-static int cmsfs_listxattr(const char *path, char *list, size_t size)
+static int __cmsfs_listxattr(const char *path, char *list, size_t size)
 {
 	struct fst_entry fst;
 	size_t list_len;
@@ -4234,7 +4224,8 @@ static int cmsfs_write_strings(struct file *f, const char *buf,
 	}
 
 	/* translate */
-	rc = convert_text(cmsfs.iconv_to, f->wcache, f->iconv_buf, f->wcache_used);
+	rc = convert_text(&cmsfs.conv_to, f->wcache, f->iconv_buf,
+			  f->wcache_used);
 	if (rc < 0)
 		return rc;
 
@@ -4270,8 +4261,8 @@ static int cmsfs_write_strings(struct file *f, const char *buf,
 	return rc;
 }
 
-static int cmsfs_write(const char *path, const char *buf, size_t size,
-		       off_t offset, struct fuse_file_info *fi)
+static int __cmsfs_write(const char *path, const char *buf, size_t size,
+			 off_t offset, struct fuse_file_info *fi)
 {
 	struct file *f = get_fobj(fi);
 	int rc, written, nbytes;
@@ -4300,7 +4291,7 @@ static int cmsfs_write(const char *path, const char *buf, size_t size,
 	return written;
 }
 
-static int cmsfs_unlink(const char *path)
+static int __cmsfs_unlink(const char *path)
 {
 	struct fst_entry fst;
 	off_t fst_addr;
@@ -4327,7 +4318,8 @@ static int flush_wcache(struct file *f)
 	int rc;
 
 	/* translate */
-	rc = convert_text(cmsfs.iconv_to, f->wcache, f->iconv_buf, f->wcache_used);
+	rc = convert_text(&cmsfs.conv_to, f->wcache, f->iconv_buf,
+			  f->wcache_used);
 	if (rc < 0)
 		return rc;
 
@@ -4343,7 +4335,7 @@ static int flush_wcache(struct file *f)
 	return 0;
 }
 
-static int cmsfs_release(const char *path, struct fuse_file_info *fi)
+static int __cmsfs_release(const char *path, struct fuse_file_info *fi)
 {
 	struct file *f = get_fobj(fi);
 	int rc = 0;
@@ -4399,6 +4391,7 @@ static struct file *create_file_object(struct fst_entry *fst, int *rc)
 		goto oom_f;
 
 	memcpy(f->fst, fst, sizeof(*fst));
+	pthread_mutex_init(&f->lock, NULL);
 	workaround_nr_blocks(f);
 	init_fops(f);
 
@@ -4475,6 +4468,7 @@ static void destroy_file_object(struct file *f)
 	free(f->rlist);
 	free(f->blist);
 	free(f->fst);
+	pthread_mutex_destroy(&f->lock);
 	free(f);
 }
 
@@ -4492,6 +4486,199 @@ static struct file_operations fops_variable = {
 	.write_pointers = rewrite_pointer_block_variable,
 };
 
+/*
+ * Locking for multi-threaded FUSE: Lookups and reads run concurrently under
+ * the shared lock. Operations that modify the directory, the allocation map
+ * or the list of open files hold the lock exclusively. Readers of the same
+ * file object are serialized by the per-file lock.
+ */
+static inline void lock_shared(void)
+{
+	pthread_rwlock_rdlock(&cmsfs.lock);
+}
+
+static inline void lock_exclusive(void)
+{
+	pthread_rwlock_wrlock(&cmsfs.lock);
+}
+
+static inline void unlock(void)
+{
+	pthread_rwlock_unlock(&cmsfs.lock);
+}
+
+static int cmsfs_getattr(const char *path, struct stat *stbuf)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_getattr(path, stbuf);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_statfs(const char *path, struct statvfs *buf)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_statfs(path, buf);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+			 off_t offset, struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_readdir(path, buf, filler, offset, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_open(const char *path, struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_open(path, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_release(const char *path, struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_release(path, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_read(const char *path, char *buf, size_t size, off_t offset,
+		      struct fuse_file_info *fi)
+{
+	struct file *f = get_fobj(fi);
+	int rc;
+
+	lock_shared();
+	pthread_mutex_lock(&f->lock);
+	rc = __cmsfs_read(path, buf, size, offset, fi);
+	pthread_mutex_unlock(&f->lock);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_utimens(const char *path, const struct timespec ts[2])
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_utimens(path, ts);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_rename(const char *path, const char *new_path)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_rename(path, new_path);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_fsync(const char *path, int datasync,
+		       struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_fsync(path, datasync, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_truncate(const char *path, off_t size)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_truncate(path, size);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_create(const char *path, mode_t mode,
+			struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_create(path, mode, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_write(const char *path, const char *buf, size_t size,
+		       off_t offset, struct fuse_file_info *fi)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_write(path, buf, size, offset, fi);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_unlink(const char *path)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_unlink(path);
+	unlock();
+	return rc;
+}
+
+#ifdef HAVE_SETXATTR
+static int cmsfs_setxattr(const char *path, const char *name, const char *value,
+			  size_t size, int flags)
+{
+	int rc;
+
+	lock_exclusive();
+	rc = __cmsfs_setxattr(path, name, value, size, flags);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_getxattr(const char *path, const char *name, char *value,
+			  size_t size)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_getxattr(path, name, value, size);
+	unlock();
+	return rc;
+}
+
+static int cmsfs_listxattr(const char *path, char *list, size_t size)
+{
+	int rc;
+
+	lock_shared();
+	rc = __cmsfs_listxattr(path, list, size);
+	unlock();
+	return rc;
+}
+#endif
+
 static struct fuse_operations cmsfs_oper = {
 	.getattr	= cmsfs_getattr,
 	.statfs		= cmsfs_statfs,
@@ -4610,16 +4797,13 @@ static void cmsfs_init(int fd)
 	cmsfs.dir_levels = get_levels(cmsfs.fdir);
 	cmsfs.files = get_files_count(cmsfs.fdir);
 
-	/* alloc cache entries for all files */
-	cmsfs.fcache_max = max_cache_entries();
-	cmsfs.fcache = calloc(cmsfs.fcache_max, sizeof(struct fcache_entry));
-
 	cmsfs.amap = get_fop(cmsfs.fdir + sizeof(struct fst_entry));
 	cmsfs.amap_levels = get_levels(cmsfs.fdir + sizeof(struct fst_entry));
 	cmsfs.amap_bytes_per_block = cmsfs.blksize * 8 * cmsfs.blksize;
+	init_amap();
 
-	if (!hcreate_r(cmsfs.fcache_max, &cmsfs.htab))
-		DIE("hcreate failed\n");
+	build_fst_index();
+	pthread_rwlock_init(&cmsfs.lock, NULL);
 
 	util_list_init(&open_file_list, struct file, list);
 	util_list_init(&text_type_list, struct filetype, list);
@@ -4667,8 +4851,6 @@ int main(int argc, char *argv[])
 
 	if (cmsfs.readonly)
 		fuse_opt_add_arg(&args, "-oro");
-	/* force single threaded mode which requires no locking */
-	fuse_opt_add_arg(&args, "-s");
 	/* force immediate file removal */
 	fuse_opt_add_arg(&args, "-ohard_remove");
 
@@ -4682,9 +4864,9 @@ int main(int argc, char *argv[])
 		if (cmsfs.codepage_to == NULL)
 			cmsfs.codepage_to = CODEPAGE_LINUX;
 
-		setup_iconv(&cmsfs.iconv_from, cmsfs.codepage_from,
+		setup_iconv(&cmsfs.conv_from, cmsfs.codepage_from,
 			    cmsfs.codepage_to);
-		setup_iconv(&cmsfs.iconv_to, cmsfs.codepage_to,
+		setup_iconv(&cmsfs.conv_to, cmsfs.codepage_to,
 			    cmsfs.codepage_from);
 	}
 
@@ -4694,6 +4876,7 @@ int main(int argc, char *argv[])
 #ifdef DEBUG_ENABLED
 	fclose(logfile);
 #endif
-	hdestroy_r(&cmsfs.htab);
+	fst_index_free();
+	pthread_rwlock_destroy(&cmsfs.lock);
 	return rc;
 }
@@ -13,7 +13,7 @@
 #define _CMSFS_H
 
 #include <iconv.h>
-#include <search.h>
+#include <pthread.h>
 
 #include "lib/util_list.h"
 
@@ -24,13 +24,24 @@ extern struct cmsfs cmsfs;
 #define ABS(x)			((off_t) (x - 1) * cmsfs.blksize)
 #define REL(x)			((x / cmsfs.blksize) + 1)
 
-struct fcache_entry {
-	/* filename used as hash key */
-	char		name[18];
+struct fst_index_entry {
+	/* EBCDIC file name and type used as hash key */
+	char		fname[8];
+	char		ftype[8];
 	/* location of fst entry */
 	off_t		fst_addr;
-	/* filename string address */
-	char		*str;
+	/* next entry in hash chain */
+	struct fst_index_entry *next;
+};
+
+/* codepage conversion in one direction */
+struct codepage_conv {
+	iconv_t		cd;
+	/* translate with the table if both codepages are single byte */
+	int		sbcs;
+	unsigned char	table[256];
+	/* non-zero for bytes without a mapping */
+	unsigned char	invalid[256];
 };
 
 enum cmsfs_mode {
@@ -74,8 +85,8 @@ struct cmsfs {
 	/* iconv codepage options */
 	const char	*codepage_from;
 	const char	*codepage_to;
-	iconv_t		iconv_from;
-	iconv_t		iconv_to;
+	struct codepage_conv conv_from;
+	struct codepage_conv conv_to;
 
 	/* disk stats */
 	int		total_blocks;
@@ -91,11 +102,13 @@ struct cmsfs {
 	int		data_block_mask;
 	off_t		amap_bytes_per_block;
 
-	/* file cache */
-	struct		fcache_entry *fcache;
-	int		fcache_used;
-	int		fcache_max;
-	struct hsearch_data htab;
+	/* index of all fst entries */
+	struct fst_index_entry **fidx;
+	unsigned int	fidx_size;
+	unsigned int	fidx_used;
+
+	/* protects directory, allocation map and the open file list */
+	pthread_rwlock_t lock;
 };
 
 #define MAX_TYPE_LEN		9
@@ -124,9 +137,14 @@ int _write(const void *, size_t, off_t);
 int _zero(off_t, size_t);
 off_t get_fixed_pointer(off_t);
 
+void init_amap(void);
 off_t get_free_block(void);
 off_t get_zero_block(void);
 void free_block(off_t);
+
+void setup_iconv(struct codepage_conv *conv, const char *from, const char *to);
+int convert_text(struct codepage_conv *conv, char *in_buf, char *out_buf,
+		 int size);
 #endif
 
 #endif
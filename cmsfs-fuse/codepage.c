@@ -0,0 +1,123 @@
+/*
+ * cmsfs-fuse - CMS EDF filesystem support for Linux
+ *
+ * Codepage conversion functions
+ *
+ * Copyright IBM Corp. 2010, 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <errno.h>
+#include <iconv.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "cmsfs-fuse.h"
+#include "helper.h"
+
+/*
+ * Convert a single byte with iconv. Return the number of output bytes or
+ * -1 if the byte has no mapping. Stateful or multibyte conversions return
+ * a value other than 1.
+ */
+static int iconv_byte(iconv_t cd, unsigned char c, unsigned char *out)
+{
+	char *in_buf = (char *) &c, *out_buf = (char *) out;
+	size_t in_count = 1, out_count = 4;
+	size_t rc;
+
+	iconv(cd, NULL, NULL, NULL, NULL);
+	rc = iconv(cd, &in_buf, &in_count, &out_buf, &out_count);
+	if (rc == (size_t) -1)
+		return (errno == EILSEQ) ? -1 : 0;
+	/* flush shift state, anything written means not single byte */
+	if (iconv(cd, NULL, NULL, &out_buf, &out_count) == (size_t) -1)
+		return 0;
+	return 4 - out_count;
+}
+
+/*
+ * Open the iconv conversion @from -> @to and build a translation table if
+ * both codepages are single byte.
+ */
+void setup_iconv(struct codepage_conv *conv, const char *from, const char *to)
+{
+	unsigned char out[4];
+	int c, rc;
+
+	conv->cd = iconv_open(to, from);
+	if (conv->cd == ((iconv_t) -1))
+		DIE("Could not initialize conversion table %s->%s.\n",
+			from, to);
+
+	/* build a translation table for single byte codepages */
+	conv->sbcs = 1;
+	for (c = 0; c < 256; c++) {
+		rc = iconv_byte(conv->cd, c, out);
+		if (rc < 0) {
+			conv->invalid[c] = 1;
+			continue;
+		}
+		if (rc != 1) {
+			conv->sbcs = 0;
+			break;
+		}
+		conv->table[c] = out[0];
+	}
+	iconv(conv->cd, NULL, NULL, NULL, NULL);
+	DEBUG("codepage %s->%s: %s\n", from, to,
+	      conv->sbcs ? "table" : "iconv");
+}
+
+/*
+ * Translate with the single byte table. The loop has no data dependent
+ * branches, so the compiler can unroll it and check all bytes at once.
+ */
+static int convert_table(struct codepage_conv *conv, const char *in_buf,
+			 char *out_buf, int size)
+{
+	const unsigned char *in = (const unsigned char *) in_buf;
+	unsigned char *out = (unsigned char *) out_buf;
+	unsigned char invalid = 0;
+	int i;
+
+	for (i = 0; i < size; i++) {
+		invalid |= conv->invalid[in[i]];
+		out[i] = conv->table[in[i]];
+	}
+	if (invalid) {
+		DEBUG("Code page translation EBCDIC-ASCII failed\n");
+		return -EIO;
+	}
+	return 0;
+}
+
+/*
+ * Convert @size bytes from @in_buf to @out_buf, return -EIO if a byte has
+ * no mapping.
+ */
+int convert_text(struct codepage_conv *conv, char *in_buf, char *out_buf,
+		 int size)
+{
+	static pthread_mutex_t iconv_lock = PTHREAD_MUTEX_INITIALIZER;
+	size_t out_count = size;
+	size_t in_count = size;
+	size_t rc;
+
+	if (conv->sbcs)
+		return convert_table(conv, in_buf, out_buf, size);
+
+	/* iconv descriptors carry state and must not be used concurrently */
+	pthread_mutex_lock(&iconv_lock);
+	rc = iconv(conv->cd, &in_buf, &in_count, &out_buf, &out_count);
+	pthread_mutex_unlock(&iconv_lock);
+	if ((rc == (size_t) -1) || (in_count != 0)) {
+		DEBUG("Code page translation EBCDIC-ASCII failed\n");
+		return -EIO;
+	}
+	return 0;
+}
@@ -38,6 +38,13 @@
 #define DEFAULT_READ_CHUNK_SIZE		(512 * 1024)
 #define DEFAULT_MAX_BUFFER_SIZE		(2 * 1024 * 1024)
 
+/* Uncompressed data size after which a gzip member is written (bytes) */
+#define GZ_MEMBER_SIZE			(1024 * 1024)
+/* Minimum free space in gzip member buffer per deflate call (bytes) */
+#define GZ_OUT_CHUNK_SIZE		(64 * 1024)
+/* deflate() window bits for gzip encoding */
+#define GZ_WINDOW_BITS			(15 + 16)
+
 #define _SET_ABORTED(task)	_set_aborted((task), __func__, __LINE__)
 #define SET_ABORTED(task)	set_aborted((task), __func__, __LINE__)
 
@@ -89,6 +96,7 @@ struct job {
 	struct dref *dref;
 	int cmd_status;
 	struct buffer *content;
+	bool written;	/* Tar entry was already written by direct copy */
 };
 
 /* Run-time statistics */
@@ -118,10 +126,8 @@ struct task {
 	/* output_mutex serializes access to output file */
 	pthread_mutex_t output_mutex;
 	int output_fd;
+	bool output_pipe;
 	size_t output_written;
-#ifdef HAVE_ZLIB
-	gzFile output_gzfd;
-#endif /* HAVE_ZLIB */
 	unsigned long output_num_files;
 
 	/* No protection needed (only accessed in single-threaded mode) */
@@ -129,6 +135,21 @@ struct task {
 	struct timespec start_ts;
 };
 
+#ifdef HAVE_ZLIB
+/* Independently compressed gzip member. Each thread compresses tar entries
+ * into its own member without holding the output lock. Completed members are
+ * written to the output file in one piece. Like other buffered data, the
+ * compressed data is moved to a temporary file when it exceeds
+ * --max-buffer-size. */
+struct gzmember {
+	z_stream strm;
+	bool active;		/* Has strm been initialized? */
+	struct buffer out;	/* Compressed data */
+	size_t in;		/* Number of uncompressed bytes in member */
+	unsigned long num_files;/* Number of tar entries in member */
+};
+#endif /* HAVE_ZLIB */
+
 /* Per thread management data */
 struct per_thread {
 	long num;
@@ -138,6 +159,9 @@ struct per_thread {
 	struct stats stats;
 	struct job *job;
 	struct buffer buffer;
+#ifdef HAVE_ZLIB
+	struct gzmember gz;
+#endif /* HAVE_ZLIB */
 	struct task *task;
 };
 
@@ -488,34 +512,12 @@ void job_print(struct job *job)
 	printf("DEBUG:   content=%p\n", job->content);
 }
 
-/* Return the number of bytes written to the output file */
-static size_t get_output_size(struct task *task)
-{
-#ifdef HAVE_ZLIB
-	if (task->opts->gzip) {
-		gzflush(task->output_gzfd, Z_SYNC_FLUSH);
-		return gztell(task->output_gzfd);
-	}
-#endif /* HAVE_ZLIB */
-	return task->output_written;
-}
-
 /* Write @len bytes at address @ptr to the output file */
 static int write_output(struct task *task, const char *ptr, size_t len)
 {
 	size_t todo = len;
 	ssize_t w;
 
-#ifdef HAVE_ZLIB
-	if (task->opts->gzip) {
-		if (gzwrite(task->output_gzfd, ptr, len) == 0)
-			goto err_write;
-		task->output_written += len;
-
-		return EXIT_OK;
-	}
-#endif /* HAVE_ZLIB */
-
 	while (todo > 0) {
 		w = write(task->output_fd, ptr, todo);
 		if (w < 0)
@@ -533,27 +535,152 @@ err_write:
 	return EXIT_RUNTIME;
 }
 
+/* Abort processing if the output file exceeds the --max-size limit. Must be
+ * called with output_lock held. */
+static void _check_output_size(struct task *task)
+{
+	if (task->opts->max_size > 0 &&
+	    task->output_written > task->opts->max_size) {
+		mwarnx("Archive size exceeds maximum of %ld bytes - aborting",
+		      task->opts->max_size);
+		SET_ABORTED(task);
+	}
+}
+
+#ifdef HAVE_ZLIB
+/* Compress @len bytes at address @addr into gzip member @gz. If @finish is
+ * %true, complete the member after adding the data. Compressed data exceeding
+ * @max_buffer_size is stored in a temporary file. */
+static int gzmember_deflate(struct gzmember *gz, void *addr, size_t len,
+			    bool finish, size_t max_buffer_size)
+{
+	size_t todo = len;
+	int rc, flush;
+	ssize_t c;
+
+	if (!gz->active) {
+		memset(&gz->strm, 0, sizeof(gz->strm));
+		if (deflateInit2(&gz->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				 GZ_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return EXIT_RUNTIME;
+		gz->active = true;
+	}
+
+	gz->strm.next_in = addr;
+	do {
+		/* Feed data in pieces that fit into the z_stream counters */
+		gz->strm.avail_in = todo > GZ_MEMBER_SIZE ? GZ_MEMBER_SIZE :
+							   todo;
+		todo -= gz->strm.avail_in;
+		flush = (finish && todo == 0) ? Z_FINISH : Z_NO_FLUSH;
+		do {
+			c = buffer_make_room(&gz->out, GZ_OUT_CHUNK_SIZE, true,
+					     max_buffer_size);
+			if (c < 0)
+				return EXIT_RUNTIME;
+			gz->strm.next_out = (Bytef *) gz->out.addr +
+					    gz->out.off;
+			gz->strm.avail_out = c;
+			rc = deflate(&gz->strm, flush);
+			if (rc == Z_STREAM_ERROR)
+				return EXIT_RUNTIME;
+			c -= gz->strm.avail_out;
+			gz->out.off += c;
+			gz->out.total += c;
+		} while (gz->strm.avail_in > 0 ||
+			 (flush == Z_FINISH && rc != Z_STREAM_END));
+	} while (todo > 0);
+	gz->in += len;
+
+	return EXIT_OK;
+}
+
+/* Release compression state of @gz but keep the data buffer for reuse */
+static void gzmember_reset(struct gzmember *gz)
+{
+	if (gz->active)
+		deflateEnd(&gz->strm);
+	buffer_reset(&gz->out);
+	gz->active = false;
+	gz->in = 0;
+	gz->num_files = 0;
+}
+
+/* Release all resources associated with @gz */
+static void gzmember_free(struct gzmember *gz)
+{
+	gzmember_reset(gz);
+	buffer_free(&gz->out, false);
+}
+
+/* Callback for writing out chunks of a gzip member */
+static int _write_gzmember_cb(void *data, void *addr, size_t len)
+{
+	return write_output(data, addr, len);
+}
+
+/* Write completed gzip member @gz to the output file. Must be called with
+ * output_lock held. */
+static void _write_gzmember(struct task *task, struct gzmember *gz)
+{
+	buffer_iterate(&gz->out, _write_gzmember_cb, task);
+	task->output_num_files += gz->num_files;
+	_check_output_size(task);
+}
+
+/* Write @len bytes at address @addr as separate gzip member to the output
+ * file. Must be called with output_lock held. */
+static void _write_gzdata(struct task *task, void *addr, size_t len)
+{
+	struct gzmember gz;
+
+	memset(&gz, 0, sizeof(gz));
+	if (gzmember_deflate(&gz, addr, len, true,
+			     task->opts->max_buffer_size))
+		write_error(task, "Cannot compress output");
+	else
+		_write_gzmember(task, &gz);
+	gzmember_free(&gz);
+}
+#endif /* HAVE_ZLIB */
+
 /* Write an end-of-file marker to the output file */
 static void write_eof(struct task *task)
 {
-	char zeroes[TAR_BLOCKSIZE];
+	char zeroes[2 * TAR_BLOCKSIZE];
 
 	memset(zeroes, 0, sizeof(zeroes));
-	write_output(task, zeroes, TAR_BLOCKSIZE);
-	write_output(task, zeroes, TAR_BLOCKSIZE);
+#ifdef HAVE_ZLIB
+	if (task->opts->gzip) {
+		_write_gzdata(task, zeroes, sizeof(zeroes));
+		return;
+	}
+#endif /* HAVE_ZLIB */
+	write_output(task, zeroes, sizeof(zeroes));
 }
 
 /* Callback for writing out chunks of job data */
 static int _write_job_data_cb(void *data, void *addr, size_t len)
 {
-	struct task *task = data;
+	struct per_thread *thread = data;
 
-	return write_output(task, addr, len);
+#ifdef HAVE_ZLIB
+	if (thread->task->opts->gzip) {
+		if (gzmember_deflate(&thread->gz, addr, len, false,
+				     thread->task->opts->max_buffer_size)) {
+			write_error(thread->task, "Cannot compress output");
+			return EXIT_RUNTIME;
+		}
+		return EXIT_OK;
+	}
+#endif /* HAVE_ZLIB */
+
+	return write_output(thread->task, addr, len);
 }
 
 /* Write tar entry for a file containing the exit status of the process that
  * ran command job @job */
-static int write_job_status_file(struct task *task, struct job *job)
+static int write_job_status_file(struct per_thread *thread, struct job *job)
 {
 	char *name, *content;
 	size_t len;
@@ -577,18 +704,22 @@ static int write_job_status_file(struct task *task, struct job *job)
 	len = strlen(content);
 	set_dummy_stat(&st);
 	rc = tar_emit_file_from_data(name, NULL, len, &st, TYPE_REGULAR,
-				     content, _write_job_data_cb, task);
+				     content, _write_job_data_cb, thread);
 	free(name);
 	free(content);
 
 	return rc;
 }
 
-/* Write tar entry for data in @job to output. Must be called with output_lock
- * held. */
-static void _write_job_data(struct task *task, struct job *job)
+/* Emit tar entry for data in @job via _write_job_data_cb(). Return the number
+ * of emitted tar entries. */
+static unsigned long emit_job_data(struct per_thread *thread, struct job *job)
 {
 	struct buffer *buffer = job->content;
+	unsigned long num = 0;
+
+	if (job->written)
+		return 0;
 
 	switch (job->status) {
 	case JOB_DONE:
@@ -596,52 +727,61 @@ static void _write_job_data(struct task *task, struct job *job)
 		break;
 	case JOB_FAILED:
 		/* Create empty entries for failed reads */
-		if (task->opts->ignore_failed_read)
+		if (thread->task->opts->ignore_failed_read)
 			break;
-		return;
+		return 0;
 	default:
-		return;
+		return 0;
 	}
 
 	switch (job->type) {
 	case JOB_CMD:
 		tar_emit_file_from_buffer(job->outname, NULL, buffer->total,
 					  &job->stat, TYPE_REGULAR, buffer,
-					  _write_job_data_cb, task);
-		task->output_num_files++;
-		if (task->opts->add_cmd_status) {
-			write_job_status_file(task, job);
-			task->output_num_files++;
+					  _write_job_data_cb, thread);
+		num++;
+		if (thread->task->opts->add_cmd_status) {
+			write_job_status_file(thread, job);
+			num++;
 		}
 		break;
 	case JOB_FILE:
 		tar_emit_file_from_buffer(job->outname, NULL, buffer->total,
 					  &job->stat, TYPE_REGULAR, buffer,
-					  _write_job_data_cb, task);
-		task->output_num_files++;
+					  _write_job_data_cb, thread);
+		num++;
 		break;
 	case JOB_LINK:
 		tar_emit_file_from_buffer(job->outname, buffer->addr, 0,
 					  &job->stat, TYPE_LINK, NULL,
-					  _write_job_data_cb, task);
-		task->output_num_files++;
+					  _write_job_data_cb, thread);
+		num++;
 		break;
 	case JOB_DIR:
 		tar_emit_file_from_buffer(job->outname, NULL, 0, &job->stat,
 					  TYPE_DIR, NULL, _write_job_data_cb,
-					  task);
-		task->output_num_files++;
+					  thread);
+		num++;
 		break;
 	default:
 		break;
 	}
 
-	if (task->opts->max_size > 0 &&
-	    get_output_size(task) > task->opts->max_size) {
-		mwarnx("Archive size exceeds maximum of %ld bytes - aborting",
-		      task->opts->max_size);
-		SET_ABORTED(task);
-	}
+	return num;
+}
+
+/* Write tar entry for data in @job to output. Must be called with output_lock
+ * held. */
+static void _write_job_data(struct per_thread *thread, struct job *job)
+{
+	struct task *task = thread->task;
+	unsigned long num;
+
+	num = emit_job_data(thread, job);
+	if (num == 0)
+		return;
+	task->output_num_files += num;
+	_check_output_size(task);
 }
 
 /* Read the contents of the symbolic link at @filename. On success, the
@@ -749,16 +889,173 @@ static int read_fd(struct task *task, const char *name, int fd,
 	return EXIT_OK;
 }
 
-/* Read data from the file at @filename until an end-of-file condition is
- * encountered. On success, @buffer contains the data read and the return
- * value is %EXIT_OK. If @relname is non-null it points to the name of the
- * file relative to its parent directory for which @dirfd is an open file
- * handle. */
-static int read_regular(struct task *task, const char *filename,
-			const char *relname, int dirfd, struct buffer *buffer)
+/* Check if regular file @fd with size @size should be copied directly to
+ * the output file instead of being read into a buffer first */
+static bool use_direct_copy(struct task *task, int fd, off_t *size)
+{
+	struct stat st;
+
+	/* Data must be written unmodified and without risk of cancelation
+	 * while the output lock is held */
+	if (task->opts->gzip || task->opts->file_timeout > 0)
+		return false;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+		return false;
+	/* Small files and pseudo files with unreliable size use the buffer */
+	if ((size_t) st.st_size <= task->opts->max_buffer_size)
+		return false;
+	*size = st.st_size;
+
+	return true;
+}
+
+/* Methods for copying file data to the output file, in order of preference */
+enum copy_method {
+	COPY_RANGE,	/* In-kernel copy via copy_file_range() */
+	COPY_SPLICE,	/* In-kernel copy to output pipe via splice() */
+	COPY_USER,	/* Copy via read() and write() */
+};
+
+/* Check if @err indicates that a copy method is not supported for the
+ * combination of input and output file */
+static bool copy_unsupported(int err)
+{
+	return err == EXDEV || err == EINVAL || err == EBADF ||
+	       err == ENOSYS || err == EOPNOTSUPP;
+}
+
+/* Copy @len bytes from @fd to the output file. Pad with zeroes if the file
+ * ends prematurely. Return %EXIT_OK on success. Must be called with
+ * output_lock held. */
+static int _copy_output(struct task *task, const char *name, int fd,
+			size_t len)
 {
+	size_t done = 0, todo, chunk = task->opts->read_chunk_size;
+	enum copy_method method = COPY_RANGE;
+	char zeroes[TAR_BLOCKSIZE], *addr = NULL;
+	int rc = EXIT_OK;
+	ssize_t r;
+
+	while (done < len && !is_aborted(task)) {
+		todo = len - done;
+		switch (method) {
+		case COPY_RANGE:
+			r = copy_file_range(fd, NULL, task->output_fd, NULL,
+					    todo, 0);
+			if (r < 0 && copy_unsupported(errno)) {
+				method = task->output_pipe ? COPY_SPLICE :
+							     COPY_USER;
+				continue;
+			}
+			if (r > 0)
+				task->output_written += r;
+			break;
+		case COPY_SPLICE:
+			r = splice(fd, NULL, task->output_fd, NULL, todo,
+				   SPLICE_F_MORE);
+			if (r < 0 && copy_unsupported(errno)) {
+				method = COPY_USER;
+				continue;
+			}
+			if (r > 0)
+				task->output_written += r;
+			break;
+		default:
+			if (!addr)
+				addr = mmalloc(chunk);
+			r = read(fd, addr, todo < chunk ? todo : chunk);
+			if (r > 0 && write_output(task, addr, r)) {
+				rc = EXIT_RUNTIME;
+				goto out;
+			}
+			break;
+		}
+		if (r < 0) {
+			read_error(task, name, "Cannot read file");
+			rc = EXIT_RUNTIME;
+			break;
+		}
+		if (r == 0) {
+			mwarnx("%s: Warning: File shrank by %zu bytes - "
+			       "padding with zeroes", name, len - done);
+			break;
+		}
+		done += r;
+	}
+	if (is_aborted(task)) {
+		rc = EXIT_RUNTIME;
+		goto out;
+	}
+
+	/* Keep the archive consistent with the size stored in the header */
+	memset(zeroes, 0, sizeof(zeroes));
+	while (done < len) {
+		todo = len - done < TAR_BLOCKSIZE ? len - done : TAR_BLOCKSIZE;
+		if (write_output(task, zeroes, todo)) {
+			rc = EXIT_RUNTIME;
+			goto out;
+		}
+		done += todo;
+	}
+
+out:
+	free(addr);
+
+	return rc;
+}
+
+/* Write tar entry for @job with @size bytes of content read directly from
+ * regular file @fd to output. Return %EXIT_OK on success. */
+static int copy_regular(struct per_thread *thread, struct job *job, int fd,
+			const char *filename, off_t size)
+{
+	struct task *task = thread->task;
+	char zeroes[TAR_BLOCKSIZE];
+	size_t len = size;
+	int rc;
+
+	/* Ensure that content doesn't exceed --file-max-size limit */
+	if (task->opts->file_max_size > 0 &&
+	    len > task->opts->file_max_size) {
+		len = task->opts->file_max_size;
+		mwarnx("%s: Warning: Data exceeds maximum size of %ld "
+		      "bytes - truncating", filename,
+		      task->opts->file_max_size);
+	}
+
+	DBG("direct copy of %s (%zu bytes)", filename, len);
+	output_lock(task);
+	tar_emit_file_from_data(job->outname, NULL, len, &job->stat,
+				TYPE_REGULAR, NULL, _write_job_data_cb,
+				thread);
+	rc = _copy_output(task, filename, fd, len);
+	if (!is_aborted(task) && len % TAR_BLOCKSIZE > 0) {
+		memset(zeroes, 0, sizeof(zeroes));
+		write_output(task, zeroes, TAR_BLOCKSIZE - len % TAR_BLOCKSIZE);
+	}
+	task->output_num_files++;
+	job->written = true;
+	_check_output_size(task);
+	output_unlock(task);
+
+	if (rc == EXIT_OK && is_aborted(task))
+		rc = EXIT_RUNTIME;
+
+	return rc;
+}
+
+/* Read the contents of the regular file at @job into the buffer of
+ * @thread. Large regular files are copied to the output directly. If
+ * @relname is non-null it points to the name of the file relative to its
+ * parent directory for which @dirfd is an open file handle. */
+static int read_regular(struct per_thread *thread, struct job *job,
+			const char *relname, int dirfd)
+{
+	struct task *task = thread->task;
+	const char *filename = job->inname;
 	int fd, rc = EXIT_OK;
 	bool need_close = true;
+	off_t size;
 
 	/* Opening a named pipe can block when peer is not ready */
 	cancel_enable();
@@ -777,7 +1074,12 @@ static int read_regular(struct task *task, const char *filename,
 		return EXIT_RUNTIME;
 	}
 
-	rc = read_fd(task, filename, fd, buffer);
+	if (use_direct_copy(task, fd, &size)) {
+		rc = copy_regular(thread, job, fd, filename, size);
+		goto out;
+	}
+
+	rc = read_fd(task, filename, fd, &thread->buffer);
 	if (rc) {
 		if (is_aborted(task))
 			mwarnx("%s: Read aborted", filename);
@@ -785,6 +1087,7 @@ static int read_regular(struct task *task, const char *filename,
 			read_error(task, filename, "Cannot read file");
 	}
 
+out:
 	if (need_close)
 		close(fd);
 
@@ -999,24 +1302,6 @@ static int open_output(struct task *task)
 	}
 
 	cancel_enable();
-#ifdef HAVE_ZLIB
-	if (task->opts->gzip) {
-		if (to_stdout) {
-			task->output_gzfd =
-				gzdopen(STDOUT_FILENO,
-					task->opts->append ? "ab" : "wb");
-		} else {
-			task->output_gzfd =
-				gzopen(task->opts->output_file,
-				       task->opts->append ? "ab" : "wb");
-		}
-
-		if (!task->output_gzfd)
-			rc = EXIT_RUNTIME;
-		goto out;
-	}
-#endif /* HAVE_ZLIB */
-
 	if (to_stdout) {
 		task->output_fd = STDOUT_FILENO;
 	} else {
@@ -1027,17 +1312,14 @@ static int open_output(struct task *task)
 
 	if (task->output_fd < 0)
 		rc = EXIT_RUNTIME;
-	else if (!task->opts->append) {
-		if (fstat(task->output_fd, &st) == -1)
-			rc = EXIT_RUNTIME;
-		else if (S_ISREG(st.st_mode) &&
-			 ftruncate(task->output_fd, 0) == -1)
-			rc = EXIT_RUNTIME;
-	}
+	else if (fstat(task->output_fd, &st) == -1)
+		rc = EXIT_RUNTIME;
+	else if (!task->opts->append && S_ISREG(st.st_mode) &&
+		 ftruncate(task->output_fd, 0) == -1)
+		rc = EXIT_RUNTIME;
+	else
+		task->output_pipe = S_ISFIFO(st.st_mode);
 
-#ifdef HAVE_ZLIB
-out:
-#endif /* HAVE_ZLIB */
 	cancel_disable();
 
 	if (rc != EXIT_OK) {
@@ -1118,7 +1400,7 @@ static void process_job(struct per_thread *thread, struct job *job)
 	case JOB_FILE: /* Read file contents */
 		tverb("Dumping file '%s'\n", job->inname);
 
-		if (read_regular(task, job->inname, relname, dirfd, buffer))
+		if (read_regular(thread, job, relname, dirfd))
 			status = JOB_FAILED;
 
 		break;
@@ -1178,6 +1460,9 @@ static void cleanup_thread(struct per_thread *thread)
 	if (thread->job)
 		free_job(thread->task, thread->job);
 	buffer_free(&thread->buffer, false);
+#ifdef HAVE_ZLIB
+	gzmember_free(&thread->gz);
+#endif /* HAVE_ZLIB */
 }
 
 /* Register activate @job at @thread */
@@ -1237,20 +1522,71 @@ static void cleanup_unlock(void *data)
 }
 
 /* Write entry for data in @job to output */
-static void write_job_data(struct task *task, struct job *job)
+static void write_job_data(struct per_thread *thread, struct job *job)
 {
+	struct task *task = thread->task;
+
 	DBG("write_job_data");
 	output_lock(task);
 	pthread_cleanup_push(cleanup_unlock, &task->output_mutex);
 	cancel_enable();
 
-	_write_job_data(task, job);
+	_write_job_data(thread, job);
 
 	cancel_disable();
 	pthread_cleanup_pop(0);
 	output_unlock(task);
 }
 
+#ifdef HAVE_ZLIB
+/* Complete the gzip member of @thread and write it to output */
+static void write_thread_gzmember(struct per_thread *thread, bool cancelable)
+{
+	struct task *task = thread->task;
+	struct gzmember *gz = &thread->gz;
+
+	if (!gz->active)
+		return;
+	DBG("write_thread_gzmember");
+	if (gzmember_deflate(gz, NULL, 0, true, task->opts->max_buffer_size)) {
+		write_error(task, "Cannot compress output");
+		goto out;
+	}
+	if (!cancelable) {
+		_write_gzmember(task, gz);
+		goto out;
+	}
+
+	output_lock(task);
+	pthread_cleanup_push(cleanup_unlock, &task->output_mutex);
+	cancel_enable();
+
+	_write_gzmember(task, gz);
+
+	cancel_disable();
+	pthread_cleanup_pop(0);
+	output_unlock(task);
+
+out:
+	gzmember_reset(gz);
+}
+
+/* Compress tar entry for data in @job into the gzip member of @thread. The
+ * compression runs without holding the output lock so that multiple threads
+ * can compress in parallel. */
+static void compress_job_data(struct per_thread *thread, struct job *job,
+			      bool cancelable)
+{
+	struct gzmember *gz = &thread->gz;
+
+	gz->num_files += emit_job_data(thread, job);
+
+	/* Write member per entry to enforce --max-size limit exactly */
+	if (gz->in >= GZ_MEMBER_SIZE || thread->task->opts->max_size > 0)
+		write_thread_gzmember(thread, cancelable);
+}
+#endif /* HAVE_ZLIB */
+
 /* Perform second part of job processing for @job at @thread by writing the
  * resulting tar file entry */
 static void postprocess_job(struct per_thread *thread, struct job *job,
@@ -1259,10 +1595,16 @@ static void postprocess_job(struct per_thread *thread, struct job *job,
 	struct task *task = thread->task;
 
 	account_stats(task, &thread->stats, job);
+#ifdef HAVE_ZLIB
+	if (task->opts->gzip) {
+		compress_job_data(thread, job, cancelable);
+		return;
+	}
+#endif /* HAVE_ZLIB */
 	if (cancelable)
-		write_job_data(task, job);
+		write_job_data(thread, job);
 	else
-		_write_job_data(task, job);
+		_write_job_data(thread, job);
 }
 
 /* Mark @job as complete by releasing all associated resources. If this was
@@ -1300,6 +1642,9 @@ static int process_queue(struct task *task)
 	}
 
 	task->stats = thread.stats;
+#ifdef HAVE_ZLIB
+	write_thread_gzmember(&thread, false);
+#endif /* HAVE_ZLIB */
 	cleanup_thread(&thread);
 
 	return EXIT_OK;
@@ -1565,10 +1910,10 @@ static int wait_for_completion(struct task *task, struct per_thread *threads)
 static void close_output(struct task *task)
 {
 #ifdef HAVE_ZLIB
-	if (task->opts->gzip) {
-		gzclose(task->output_gzfd);
-		return;
-	}
+	/* Ensure that an empty archive is still a valid gzip file */
+	if (task->opts->gzip && task->output_written == 0 &&
+	    task->output_fd >= 0)
+		_write_gzdata(task, NULL, 0);
 #endif /* HAVE_ZLIB */
 
 	if (task->output_fd != STDOUT_FILENO)
@@ -1605,6 +1950,14 @@ static int process_queue_threaded(struct task *task)
 		}
 		DBG("join %p", thread->thread);
 		pthread_join(thread->thread, NULL);
+	}
+
+	/* All threads are stopped - no further output locking required */
+	for (i = 0; i < task->opts->jobs; i++) {
+		thread = &threads[i];
+#ifdef HAVE_ZLIB
+		write_thread_gzmember(thread, false);
+#endif /* HAVE_ZLIB */
 		add_stats(&task->stats, &thread->stats);
 		cleanup_thread(thread);
 	}
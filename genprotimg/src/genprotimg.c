@@ -7,9 +7,7 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
-#include <errno.h>
 #include <glib.h>
-#include <glib/gstdio.h>
 #include <glib/gtypes.h>
 #include <locale.h>
 #include <signal.h>
@@ -26,44 +24,9 @@ enum {
 };
 
 static gint log_level = LOG_LEVEL_CRITICAL;
-static gchar *tmp_dir;
-
-static void rmdir_recursive(gchar *dir_path, GError **err)
-{
-	const gchar *file = NULL;
-	g_autoptr(GDir) d = NULL;
-
-	if (!dir_path)
-		return;
-
-	d = g_dir_open(dir_path, 0, err);
-	if (!d) {
-		g_set_error(err, G_FILE_ERROR,
-			    (gint)g_file_error_from_errno(errno),
-			    _("Failed to open directory '%s': %s"), dir_path,
-			    g_strerror(errno));
-		return;
-	}
-
-	while ((file = g_dir_read_name(d)) != NULL) {
-		g_autofree gchar *file_path =
-			g_build_filename(dir_path, file, NULL);
-		/* ignore error */
-		(void)g_unlink(file_path);
-	}
-
-	if (g_rmdir(dir_path) != 0) {
-		g_set_error(err, G_FILE_ERROR,
-			    (gint)g_file_error_from_errno(errno),
-			    _("Failed to remove directory '%s': %s"), dir_path,
-			    g_strerror(errno));
-		return;
-	}
-}
 
 static void sig_term_handler(int signal G_GNUC_UNUSED)
 {
-	rmdir_recursive(tmp_dir, NULL);
 	exit(EXIT_FAILURE);
 }
 
@@ -135,16 +98,6 @@ gint main(gint argc, gchar *argv[])
 	/* set new log level */
 	log_level = args->log_level;
 
-	/* if the user has not specified a temporary directory let's
-	 * create one
-	 */
-	if (!args->tmp_dir) {
-		tmp_dir = g_dir_make_tmp("genprotimg-XXXXXX", &err);
-		if (!tmp_dir)
-			goto error;
-		args->tmp_dir = g_strdup(tmp_dir);
-	}
-
 	/* allocate and initialize ``pv_img`` data structure */
 	img = pv_img_new(args, GENPROTIMG_STAGE3A_PATH, &err);
 	if (!img)
@@ -174,9 +127,7 @@ error:
 		fputc('\n', stderr);
 		g_clear_error(&err);
 	}
-	rmdir_recursive(tmp_dir, NULL);
 	remove_signal_handler(signals, G_N_ELEMENTS(signals));
-	g_free(tmp_dir);
 	g_clear_pointer(&img, pv_img_free);
 	g_clear_pointer(&args, pv_args_free);
 	exit(ret);
@@ -383,7 +383,6 @@ void pv_args_free(PvArgs *args)
 	g_slist_free_full(args->comps, (GDestroyNotify)pv_arg_free);
 	g_ptr_array_free(args->unused_values, TRUE);
 	g_free(args->output_path);
-	g_free(args->tmp_dir);
 	g_free(args);
 }
 
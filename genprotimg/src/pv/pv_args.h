@@ -37,7 +37,6 @@ typedef struct {
 	gchar *xts_key_path;
 	GSList *comps;
 	gchar *output_path;
-	gchar *tmp_dir;
 	GPtrArray *unused_values;
 } PvArgs;
 
@@ -7,6 +7,8 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gtypes.h>
 #include <openssl/bn.h>
@@ -14,6 +16,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "boot/s390.h"
 #include "common.h"
@@ -25,6 +28,9 @@
 #include "pv_comp.h"
 #include "pv_error.h"
 
+/* Number of bytes that are read, encrypted, hashed and written at once */
+#define PV_COMP_CHUNK_SIZE (256 * PAGE_SIZE)
+
 static void comp_file_free(CompFile *comp)
 {
 	if (!comp)
@@ -69,7 +75,6 @@ PvComponent *pv_component_new_file(PvComponentType type, const gchar *path,
 		return NULL;
 
 	file->path = g_strdup(path);
-	file->size = size;
 	return pv_component_new(type, size, DATA_FILE, (void **)&file, err);
 }
 
@@ -123,16 +128,15 @@ const gchar *pv_component_name(const PvComponent *component)
 	g_assert_not_reached();
 }
 
+/* Size of the component in the image. The component is padded to full
+ * pages, an empty component still occupies one page.
+ */
 uint64_t pv_component_size(const PvComponent *component)
 {
-	switch ((PvComponentDataType)component->d_type) {
-	case DATA_BUFFER:
-		return component->buf->size;
-	case DATA_FILE:
-		return component->file->size;
-	}
+	if (component->orig_size == 0)
+		return PAGE_SIZE;
 
-	g_assert_not_reached();
+	return PAGE_ALIGN(component->orig_size);
 }
 
 uint64_t pv_component_get_src_addr(const PvComponent *component)
@@ -155,99 +159,6 @@ gboolean pv_component_is_stage3b(const PvComponent *component)
 	return pv_component_type(component) == PV_COMP_TYPE_STAGE3B;
 }
 
-gint pv_component_align_and_encrypt(PvComponent *component, const gchar *tmp_path,
-				    void *opaque, GError **err)
-{
-	struct cipher_parms *parms = opaque;
-
-	switch ((PvComponentDataType)component->d_type) {
-	case DATA_BUFFER: {
-		g_autoptr(Buffer) enc_buf = NULL;
-
-		if (!(IS_PAGE_ALIGNED(pv_component_size(component)))) {
-			g_autoptr(Buffer) new = NULL;
-
-			/* create a page aligned copy */
-			new = buffer_dup(component->buf, TRUE);
-			buffer_clear(&component->buf);
-			component->buf = g_steal_pointer(&new);
-		}
-		enc_buf = encrypt_buf(parms, component->buf, err);
-		if (!enc_buf)
-			return -1;
-
-		buffer_clear(&component->buf);
-		component->buf = g_steal_pointer(&enc_buf);
-		return 0;
-	}
-	case DATA_FILE: {
-		const gchar *comp_name = pv_component_name(component);
-		gchar *path_in = component->file->path;
-		g_autofree gchar *path_out = NULL;
-		gsize orig_size;
-		gsize prep_size;
-
-		g_assert(path_in);
-
-		path_out = g_build_filename(tmp_path, comp_name, NULL);
-		if (encrypt_file(parms, path_in, path_out, &orig_size,
-				 &prep_size, err) < 0)
-			return -1;
-
-		if (component->orig_size != orig_size) {
-			g_set_error(err, G_FILE_ERROR, PV_ERROR_INTERNAL,
-				    _("File has changed during the preparation '%s'"),
-				    path_out);
-			return -1;
-		}
-
-		g_free(component->file->path);
-		component->file->size = prep_size;
-		component->file->path = g_steal_pointer(&path_out);
-		return 0;
-	}
-	}
-
-	g_assert_not_reached();
-}
-
-/* Page align the size of the component */
-gint pv_component_align(PvComponent *component, const gchar *tmp_path,
-			void *opaque G_GNUC_UNUSED, GError **err)
-{
-	if (IS_PAGE_ALIGNED(pv_component_size(component)))
-		return 0;
-
-	switch (component->d_type) {
-	case DATA_BUFFER: {
-		g_autoptr(Buffer) buf = NULL;
-
-		buf = buffer_dup(component->buf, TRUE);
-		buffer_clear(&component->buf);
-		component->buf = g_steal_pointer(&buf);
-		return 0;
-	} break;
-	case DATA_FILE: {
-		const gchar *comp_name = pv_component_name(component);
-		g_autofree gchar *path_out =
-			g_build_filename(tmp_path, comp_name, NULL);
-		gchar *path_in = component->file->path;
-		gsize size_out;
-
-		if (pad_file_right(path_out, path_in, &size_out, PAGE_SIZE,
-				   err) < 0)
-			return -1;
-
-		g_free(component->file->path);
-		component->file->path = g_steal_pointer(&path_out);
-		component->file->size = size_out;
-		return 0;
-	} break;
-	}
-
-	g_assert_not_reached();
-}
-
 /* Convert uint64_t address to byte array */
 static void uint64_to_uint8_buf(uint8_t dst[8], uint64_t addr)
 {
@@ -291,83 +202,6 @@ int64_t pv_component_update_ald(const PvComponent *comp, EVP_MD_CTX *ctx,
 	return nep;
 }
 
-int64_t pv_component_update_pld(const PvComponent *comp, EVP_MD_CTX *ctx,
-				GError **err)
-{
-	uint64_t size = pv_component_size(comp);
-	int64_t nep = 0;
-
-	g_assert(IS_PAGE_ALIGNED(size) && size != 0);
-
-	switch (comp->d_type) {
-	case DATA_BUFFER: {
-		const Buffer *buf = comp->buf;
-
-		g_assert(buf->size <= INT64_MAX);
-		g_assert(buf->size == size);
-
-		if (EVP_DigestUpdate(ctx, buf->data, buf->size) != 1) {
-			g_set_error(err, PV_CRYPTO_ERROR,
-				    PV_CRYPTO_ERROR_INTERNAL,
-				    _("EVP_DigestUpdate failed"));
-			return -1;
-		}
-
-		nep = (int64_t)(buf->size / PAGE_SIZE);
-		break;
-	}
-	case DATA_FILE: {
-		const gchar *in_path = comp->file->path;
-		guchar in_buf[PAGE_SIZE];
-		gsize num_bytes_read_total = 0;
-		gsize num_bytes_read = 0;
-		FILE *f_in;
-
-		f_in = file_open(in_path, "rb", err);
-		if (!f_in)
-			return -1;
-
-		do {
-			/* Read data in blocks. Update the digest
-			 * context each read.
-			 */
-			if (file_read(f_in, in_buf, sizeof(*in_buf),
-				      sizeof(in_buf), &num_bytes_read,
-				      err) < 0) {
-				fclose(f_in);
-				return -1;
-			}
-			num_bytes_read_total += num_bytes_read;
-
-			if (EVP_DigestUpdate(ctx, in_buf, sizeof(in_buf)) != 1) {
-				g_set_error(err, PV_CRYPTO_ERROR,
-					    PV_CRYPTO_ERROR_INTERNAL,
-					    _("EVP_DigestUpdate failed"));
-				fclose(f_in);
-				return -1;
-			}
-
-			nep++;
-		} while (num_bytes_read_total < pv_component_size(comp) &&
-			 num_bytes_read != 0);
-
-		if (num_bytes_read_total != pv_component_size(comp)) {
-			g_set_error(err, G_FILE_ERROR, PV_ERROR_INTERNAL,
-				    _("'%s' has changed during the preparation"),
-				    in_path);
-			fclose(f_in);
-			return -1;
-		}
-		fclose(f_in);
-		break;
-	}
-	default:
-		g_assert_not_reached();
-	}
-
-	return nep;
-}
-
 int64_t pv_component_update_tld(const PvComponent *comp, EVP_MD_CTX *ctx,
 				GError **err)
 {
@@ -417,30 +251,120 @@ int64_t pv_component_update_tld(const PvComponent *comp, EVP_MD_CTX *ctx,
 	return nep;
 }
 
-gint pv_component_write(const PvComponent *component, FILE *f, GError **err)
+/* Reads the data of @comp at @offset into @buf and pads it with zeros to
+ * @size bytes
+ */
+static gint pv_component_read(const PvComponent *comp, gint fd,
+			      uint64_t offset, guchar *buf, gsize size,
+			      GError **err)
 {
-	uint64_t offset = pv_component_get_src_addr(component);
-
-	g_assert(f);
+	uint64_t orig_size = pv_component_get_orig_size(comp);
+	gsize len = 0, num_bytes_read;
 
-	switch (component->d_type) {
-	case DATA_BUFFER: {
-		const Buffer *buf = component->buf;
+	if (offset < orig_size)
+		len = (gsize)MIN(size, orig_size - offset);
 
-		if (seek_and_write_buffer(f, buf, offset, err) < 0)
+	switch ((PvComponentDataType)comp->d_type) {
+	case DATA_BUFFER:
+		memcpy(buf, (guchar *)comp->buf->data + offset, len);
+		break;
+	case DATA_FILE:
+		if (file_pread(fd, buf, len, offset, &num_bytes_read, err) < 0) {
+			g_prefix_error(err, _("Failed to read file '%s': "),
+				       comp->file->path);
 			return -1;
-
-		return 0;
+		}
+		if (num_bytes_read != len) {
+			g_set_error(err, G_FILE_ERROR, PV_ERROR_INTERNAL,
+				    _("'%s' has changed during the preparation"),
+				    comp->file->path);
+			return -1;
+		}
+		break;
+	default:
+		g_assert_not_reached();
 	}
-	case DATA_FILE: {
-		const CompFile *file = component->file;
 
-		if (seek_and_write_file(f, file, offset, err) < 0)
+	memset(buf + len, 0, size - len);
+	return 0;
+}
+
+/* Reads, pads and, if @parms is given, encrypts the component in chunks
+ * of PV_COMP_CHUNK_SIZE bytes. Each chunk is passed to @func together with
+ * its offset in the component. This way the component data is only read
+ * once.
+ */
+gint pv_component_prepare(const PvComponent *comp,
+			  const struct cipher_parms *parms,
+			  pv_component_chunk_func func, void *opaque,
+			  GError **err)
+{
+	uint64_t size = pv_component_size(comp);
+	g_autoptr(EVP_CIPHER_CTX) ctx = NULL;
+	g_autofree guchar *out_buf = NULL;
+	g_autofree guchar *in_buf = NULL;
+	union tweak tweak = comp->tweak;
+	gsize num_bytes_read;
+	guchar tail;
+	gint ret = -1;
+	gint fd = -1;
+
+	g_assert(IS_PAGE_ALIGNED(size) && size != 0);
+
+	if (parms) {
+		ctx = cipher_ctx_new(parms, err);
+		if (!ctx)
 			return -1;
+		out_buf = g_malloc(PV_COMP_CHUNK_SIZE);
+	}
+	in_buf = g_malloc(PV_COMP_CHUNK_SIZE);
+
+	if (comp->d_type == DATA_FILE) {
+		fd = open(comp->file->path, O_RDONLY);
+		if (fd < 0) {
+			g_set_error(err, G_FILE_ERROR,
+				    (gint)g_file_error_from_errno(errno),
+				    _("Failed to open file '%s': %s"),
+				    comp->file->path, g_strerror(errno));
+			return -1;
+		}
+	}
 
-		return 0;
+	for (uint64_t offset = 0; offset < size; offset += PV_COMP_CHUNK_SIZE) {
+		gsize len = (gsize)MIN(PV_COMP_CHUNK_SIZE, size - offset);
+		const guchar *data = in_buf;
+
+		if (pv_component_read(comp, fd, offset, in_buf, len, err) < 0)
+			goto out;
+
+		if (parms) {
+			if (encrypt_pages(ctx, &tweak, in_buf, out_buf, len,
+					  err) < 0)
+				goto out;
+			data = out_buf;
+		}
+
+		if ((*func)(comp, data, offset, len, opaque, err) < 0)
+			goto out;
 	}
+
+	/* the file must not have grown in the meantime */
+	if (fd >= 0) {
+		if (file_pread(fd, &tail, sizeof(tail),
+			       pv_component_get_orig_size(comp),
+			       &num_bytes_read, err) < 0)
+			goto out;
+		if (num_bytes_read != 0) {
+			g_set_error(err, G_FILE_ERROR, PV_ERROR_INTERNAL,
+				    _("'%s' has changed during the preparation"),
+				    comp->file->path);
+			goto out;
+		}
 	}
 
-	g_assert_not_reached();
+	ret = 0;
+out:
+	if (fd >= 0)
+		close(fd);
+	return ret;
 }
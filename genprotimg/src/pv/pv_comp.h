@@ -33,7 +33,6 @@ typedef enum {
 
 typedef struct comp_file {
 	gchar *path;
-	gsize size;
 } CompFile;
 
 typedef struct {
@@ -49,6 +48,11 @@ typedef struct {
 	union tweak tweak; /* used for the AES XTS encryption */
 } PvComponent;
 
+/* Called for each prepared chunk of a component */
+typedef gint (*pv_component_chunk_func)(const PvComponent *comp,
+					const guchar *data, uint64_t offset,
+					gsize size, void *opaque, GError **err);
+
 PvComponent *pv_component_new_file(PvComponentType type, const gchar *path,
 				   GError **err);
 PvComponent *pv_component_new_buf(PvComponentType type, const Buffer *buf,
@@ -61,17 +65,14 @@ uint64_t pv_component_get_src_addr(const PvComponent *component);
 uint64_t pv_component_get_orig_size(const PvComponent *component);
 uint64_t pv_component_get_tweak_prefix(const PvComponent *component);
 gboolean pv_component_is_stage3b(const PvComponent *component);
-gint pv_component_align_and_encrypt(PvComponent *component, const gchar *tmp_path,
-				    void *opaque, GError **err);
-gint pv_component_align(PvComponent *component, const gchar *tmp_path,
-			void *opaque G_GNUC_UNUSED, GError **err);
-int64_t pv_component_update_pld(const PvComponent *comp, EVP_MD_CTX *ctx,
-				GError **err);
 int64_t pv_component_update_ald(const PvComponent *comp, EVP_MD_CTX *ctx,
 				GError **err);
 int64_t pv_component_update_tld(const PvComponent *comp, EVP_MD_CTX *ctx,
 				GError **err);
-gint pv_component_write(const PvComponent *component, FILE *f, GError **err);
+gint pv_component_prepare(const PvComponent *comp,
+			  const struct cipher_parms *parms,
+			  pv_component_chunk_func func, void *opaque,
+			  GError **err);
 
 WRAPPED_G_DEFINE_AUTOPTR_CLEANUP_FUNC(PvComponent, pv_component_free)
 
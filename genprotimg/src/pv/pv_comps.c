@@ -17,12 +17,16 @@
 #include "common.h"
 #include "utils/align.h"
 #include "utils/crypto.h"
+#include "utils/file_utils.h"
 
 #include "pv_comp.h"
 #include "pv_comps.h"
 #include "pv_error.h"
 #include "pv_stage3.h"
 
+/* Number of bytes that are read back at once from the image file */
+#define PV_COMPS_CATCH_UP_SIZE (256 * PAGE_SIZE)
+
 struct _pv_img_comps {
 	gboolean finalized;
 	uint64_t next_src;
@@ -33,6 +37,31 @@ struct _pv_img_comps {
 	GSList *comps; /* elements sorted by component type */
 };
 
+/* The components are encrypted and written in parallel, one thread per
+ * component. The digests must be calculated in the order of the
+ * components, therefore only the job whose turn it is updates them. A job
+ * that gets its turn late hashes the data it has already written from the
+ * image file first and then continues with the data in memory.
+ */
+typedef struct {
+	PvImgComps *comps;
+	const struct cipher_parms *parms;
+	gint fd; /* image file */
+	GMutex mutex;
+	GCond cond;
+	guint turn; /* index of the job that updates the digests */
+} PvCompsWriter;
+
+typedef struct {
+	PvCompsWriter *writer;
+	const PvComponent *comp;
+	guint idx;
+	gboolean own_turn;
+	uint64_t hashed; /* number of bytes already hashed */
+	gint rc;
+	GError *err;
+} PvCompJob;
+
 void pv_img_comps_free(PvImgComps *comps)
 {
 	if (!comps)
@@ -70,39 +99,6 @@ guint pv_img_comps_length(const PvImgComps *comps)
 	return g_slist_length(comps->comps);
 }
 
-/* Update hashes and nep */
-/* Returns 0 in case of success and -1 in case of a failure */
-static gint pv_img_comps_hash_comp(PvImgComps *comps, const PvComponent *comp,
-				   GError **err)
-{
-	int64_t nep_1 = 0;
-	int64_t nep_2 = 0;
-	int64_t nep_3 = 0;
-
-	/* update pld */
-	nep_1 = pv_component_update_pld(comp, comps->pld, err);
-	if (nep_1 < 0)
-		return -1;
-
-	/* update ald */
-	nep_2 = pv_component_update_ald(comp, comps->ald, err);
-	if (nep_2 < 0)
-		return -1;
-
-	/* update tld */
-	nep_3 = pv_component_update_tld(comp, comps->tld, err);
-	if (nep_3 < 0)
-		return -1;
-
-	g_assert(nep_1 == nep_2);
-	g_assert(nep_2 == nep_3);
-
-	/* update comps->nep */
-	g_assert_true(g_uint64_checked_add(&comps->nep, comps->nep,
-					   (uint64_t)nep_1));
-	return 0;
-}
-
 gint pv_img_comps_add_component(PvImgComps *comps, PvComponent **comp,
 				GError **err)
 {
@@ -210,6 +206,201 @@ GSList *pv_img_comps_get_comps(const PvImgComps *comps)
 	return comps->comps;
 }
 
+static gboolean pv_comp_job_has_turn(PvCompJob *job)
+{
+	PvCompsWriter *writer = job->writer;
+
+	if (job->own_turn)
+		return TRUE;
+
+	g_mutex_lock(&writer->mutex);
+	job->own_turn = writer->turn == job->idx;
+	g_mutex_unlock(&writer->mutex);
+	return job->own_turn;
+}
+
+static void pv_comp_job_wait_turn(PvCompJob *job)
+{
+	PvCompsWriter *writer = job->writer;
+
+	g_mutex_lock(&writer->mutex);
+	while (writer->turn != job->idx)
+		g_cond_wait(&writer->cond, &writer->mutex);
+	g_mutex_unlock(&writer->mutex);
+	job->own_turn = TRUE;
+}
+
+static void pv_comp_job_pass_turn(PvCompJob *job)
+{
+	PvCompsWriter *writer = job->writer;
+
+	g_mutex_lock(&writer->mutex);
+	writer->turn++;
+	g_cond_broadcast(&writer->cond);
+	g_mutex_unlock(&writer->mutex);
+}
+
+static gint pv_comp_job_update_pld(PvCompJob *job, const guchar *data,
+				   gsize size, GError **err)
+{
+	if (EVP_DigestUpdate(job->writer->comps->pld, data, size) != 1) {
+		g_set_error(err, PV_CRYPTO_ERROR, PV_CRYPTO_ERROR_INTERNAL,
+			    _("EVP_DigestUpdate failed"));
+		return -1;
+	}
+
+	job->hashed += size;
+	return 0;
+}
+
+/* Hash the data of the component that was written before the job got its
+ * turn. The data is read back from the image file.
+ */
+static gint pv_comp_job_catch_up(PvCompJob *job, uint64_t end, GError **err)
+{
+	uint64_t src_addr = pv_component_get_src_addr(job->comp);
+	g_autofree guchar *buf = NULL;
+	gsize size, num_bytes_read;
+
+	if (job->hashed >= end)
+		return 0;
+
+	buf = g_malloc(PV_COMPS_CATCH_UP_SIZE);
+	while (job->hashed < end) {
+		size = (gsize)MIN(PV_COMPS_CATCH_UP_SIZE, end - job->hashed);
+		if (file_pread(job->writer->fd, buf, size,
+			       src_addr + job->hashed, &num_bytes_read,
+			       err) < 0)
+			return -1;
+
+		if (num_bytes_read != size) {
+			g_set_error(err, PV_ERROR, PV_ERROR_INTERNAL,
+				    _("Image file is too short"));
+			return -1;
+		}
+
+		if (pv_comp_job_update_pld(job, buf, size, err) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static gint pv_comp_job_write_chunk(const PvComponent *comp,
+				    const guchar *data, uint64_t offset,
+				    gsize size, void *opaque, GError **err)
+{
+	PvCompJob *job = opaque;
+
+	if (file_pwrite(job->writer->fd, data, size,
+			pv_component_get_src_addr(comp) + offset, err) < 0)
+		return -1;
+
+	if (!pv_comp_job_has_turn(job))
+		return 0;
+
+	if (pv_comp_job_catch_up(job, offset, err) < 0)
+		return -1;
+
+	return pv_comp_job_update_pld(job, data, size, err);
+}
+
+/* Update the digests and nep for the whole component */
+static gint pv_comp_job_finish(PvCompJob *job, GError **err)
+{
+	PvImgComps *comps = job->writer->comps;
+	const PvComponent *comp = job->comp;
+	int64_t nep_1, nep_2;
+
+	if (pv_comp_job_catch_up(job, pv_component_size(comp), err) < 0)
+		return -1;
+
+	nep_1 = pv_component_update_ald(comp, comps->ald, err);
+	if (nep_1 < 0)
+		return -1;
+
+	nep_2 = pv_component_update_tld(comp, comps->tld, err);
+	if (nep_2 < 0)
+		return -1;
+
+	g_assert(nep_1 == nep_2);
+	g_assert((uint64_t)nep_1 * PAGE_SIZE == job->hashed);
+
+	g_assert_true(g_uint64_checked_add(&comps->nep, comps->nep,
+					   (uint64_t)nep_1));
+	return 0;
+}
+
+static gpointer pv_comp_job_run(gpointer data)
+{
+	PvCompJob *job = data;
+
+	job->rc = pv_component_prepare(job->comp, job->writer->parms,
+				       pv_comp_job_write_chunk, job,
+				       &job->err);
+
+	/* the digests are always updated in the order of the components */
+	pv_comp_job_wait_turn(job);
+	if (job->rc == 0)
+		job->rc = pv_comp_job_finish(job, &job->err);
+	pv_comp_job_pass_turn(job);
+	return NULL;
+}
+
+/* Encrypts (if @parms is given), hashes and writes all components to the
+ * image file @fd in a single pass. No components can be added afterwards.
+ */
+gint pv_img_comps_write(PvImgComps *comps, gint fd,
+			const struct cipher_parms *parms, GError **err)
+{
+	guint num = pv_img_comps_length(comps);
+	g_autofree PvCompJob *jobs = g_new0(PvCompJob, num);
+	g_autofree GThread **threads = g_new0(GThread *, num);
+	PvCompsWriter writer = {
+		.comps = comps,
+		.parms = parms,
+		.fd = fd,
+	};
+	GSList *iterator = comps->comps;
+	gint ret = 0;
+
+	g_assert(!comps->finalized);
+
+	comps->finalized = TRUE;
+	g_mutex_init(&writer.mutex);
+	g_cond_init(&writer.cond);
+
+	for (guint i = 0; i < num; i++, iterator = iterator->next) {
+		jobs[i].writer = &writer;
+		jobs[i].comp = iterator->data;
+		jobs[i].idx = i;
+
+		threads[i] = g_thread_try_new(pv_component_name(jobs[i].comp),
+					      pv_comp_job_run, &jobs[i], NULL);
+		/* fall back to the calling thread */
+		if (!threads[i])
+			pv_comp_job_run(&jobs[i]);
+	}
+
+	for (guint i = 0; i < num; i++) {
+		if (threads[i])
+			g_thread_join(threads[i]);
+
+		if (jobs[i].rc == 0)
+			continue;
+
+		if (ret == 0)
+			g_propagate_error(err, g_steal_pointer(&jobs[i].err));
+		else
+			g_clear_error(&jobs[i].err);
+		ret = -1;
+	}
+
+	g_cond_clear(&writer.cond);
+	g_mutex_clear(&writer.mutex);
+	return ret;
+}
+
 gint pv_img_comps_finalize(PvImgComps *comps, Buffer **pld_digest,
 			   Buffer **ald_digest, Buffer **tld_digest,
 			   uint64_t *nep, GError **err)
@@ -218,14 +409,8 @@ gint pv_img_comps_finalize(PvImgComps *comps, Buffer **pld_digest,
 	g_autoptr(Buffer) tmp_ald_digest = NULL;
 	g_autoptr(Buffer) tmp_tld_digest = NULL;
 
-	comps->finalized = TRUE;
-	for (GSList *iterator = comps->comps; iterator; iterator = iterator->next) {
-		const PvComponent *comp = iterator->data;
-
-		/* update hashes and nep */
-		if (pv_img_comps_hash_comp(comps, comp, err) < 0)
-			return -1;
-	}
+	/* the digests are calculated by `pv_img_comps_write` */
+	g_assert(comps->finalized);
 
 	tmp_pld_digest = digest_ctx_finalize(comps->pld, err);
 	if (!tmp_pld_digest)
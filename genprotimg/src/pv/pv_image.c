@@ -48,50 +48,6 @@ const PvComponent *pv_img_get_stage3b_comp(const PvImage *img, GError **err)
 	return comp;
 }
 
-typedef gint (*prepare_func)(PvComponent *obj, const gchar *tmp_path,
-			     void *opaque, GError **err);
-
-static gint pv_img_prepare_component(const PvImage *img, PvComponent *comp,
-				     GError **err)
-{
-	struct cipher_parms parms = { 0 };
-	g_autoptr(Buffer) tweak = NULL;
-	prepare_func func = NULL;
-	void *opaque = NULL;
-	gint rc;
-
-	if (img->pcf & PV_CFLAG_NO_DECRYPTION) {
-		/* we only need to align the components */
-		func = pv_component_align;
-		opaque = NULL;
-	} else {
-		const EVP_CIPHER *cipher = img->xts_cipher;
-
-		g_assert_cmpint((int)img->xts_key->size, ==,
-				EVP_CIPHER_key_length(cipher));
-		g_assert_cmpint((int)PAGE_SIZE % EVP_CIPHER_block_size(cipher),
-				==, 0);
-		g_assert_cmpint(sizeof(comp->tweak), ==,
-				EVP_CIPHER_iv_length(cipher));
-		g_assert(img->xts_key->size <= UINT_MAX);
-
-		tweak = buffer_alloc(sizeof(comp->tweak.data));
-		memcpy(tweak->data, comp->tweak.data, tweak->size);
-		func = pv_component_align_and_encrypt;
-		parms.cipher = cipher;
-		parms.key = img->xts_key;
-		parms.iv_or_tweak = tweak;
-
-		opaque = &parms;
-	}
-
-	rc = (*func)(comp, img->tmp_dir, opaque, err);
-	if (rc < 0)
-		return -1;
-
-	return 0;
-}
-
 static Buffer *pv_img_read_key(const gchar *path, guint key_size,
 			       GError **err)
 {
@@ -400,7 +356,6 @@ PvImage *pv_img_new(PvArgs *args, const gchar *stage3a_path, GError **err)
 	g_autoptr(PvImage) ret = g_new0(PvImage, 1);
 	uint64_t offset;
 
-	g_assert(args->tmp_dir);
 	g_assert(stage3a_path);
 
 	if (args->no_verify)
@@ -415,7 +370,6 @@ PvImage *pv_img_new(PvArgs *args, const gchar *stage3a_path, GError **err)
 	ret->initial_psw.addr = DEFAULT_INITIAL_PSW_ADDR;
 	ret->initial_psw.mask = DEFAULT_INITIAL_PSW_MASK;
 	ret->nid = NID_secp521r1;
-	ret->tmp_dir = g_strdup(args->tmp_dir);
 	ret->xts_cipher = EVP_aes_256_xts();
 
 	/* set initial PSW that will be loaded by the stage3b */
@@ -460,7 +414,6 @@ void pv_img_free(PvImage *img)
 	EVP_PKEY_free(img->cust_pub_priv_key);
 	buffer_clear(&img->stage3a);
 	pv_img_comps_free(img->comps);
-	g_free(img->tmp_dir);
 	buffer_free(img->xts_key);
 	buffer_free(img->cust_root_key);
 	buffer_free(img->gcm_iv);
@@ -468,28 +421,6 @@ void pv_img_free(PvImage *img)
 	g_free(img);
 }
 
-static gint pv_img_prepare_and_add_component(PvImage *img, PvComponent **comp,
-					     GError **err)
-{
-	g_assert(comp);
-	g_assert(*comp);
-
-	/* prepares the component: does the alignment and encryption
-	 * if required
-	 */
-	if (pv_img_prepare_component(img, *comp, err) < 0)
-		return -1;
-
-	/* calculates the memory layout and adds the component to its
-	 * internal list
-	 */
-	if (pv_img_comps_add_component(img->comps, comp, err) < 0)
-		return -1;
-
-	g_assert(!*comp);
-	return 0;
-}
-
 gint pv_img_add_component(PvImage *img, const PvArg *arg, GError **err)
 {
 	g_autoptr(PvComponent) comp = NULL;
@@ -498,7 +429,11 @@ gint pv_img_add_component(PvImage *img, const PvArg *arg, GError **err)
 	if (!comp)
 		return -1;
 
-	if (pv_img_prepare_and_add_component(img, &comp, err) < 0)
+	/* calculates the memory layout and adds the component to its
+	 * internal list. The component is encrypted when the image is
+	 * written.
+	 */
+	if (pv_img_comps_add_component(img->comps, &comp, err) < 0)
 		return -1;
 
 	g_assert(!comp);
@@ -543,7 +478,7 @@ gint pv_img_add_stage3b_comp(PvImage *img, const gchar *path, GError **err)
 	if (!comp)
 		return -1;
 
-	if (pv_img_prepare_and_add_component(img, &comp, err) < 0)
+	if (pv_img_comps_add_component(img->comps, &comp, err) < 0)
 		return -1;
 
 	g_assert(!comp);
@@ -708,8 +643,6 @@ static Buffer *pv_img_create_pv_hdr(PvImage *img, GError **err)
  */
 gint pv_img_finalize(PvImage *pv, const gchar *stage3b_path, GError **err)
 {
-	g_autoptr(Buffer) hdr = NULL;
-
 	/* load stage3b template into memory and add it to the list of
 	 * components. This must be done before calling
 	 * `pv_img_load_and_set_stage3a`.
@@ -717,6 +650,40 @@ gint pv_img_finalize(PvImage *pv, const gchar *stage3b_path, GError **err)
 	if (pv_img_add_stage3b_comp(pv, stage3b_path, err) < 0)
 		return -1;
 
+	return 0;
+}
+
+/* Encrypts (if required), hashes and writes all components to @fd */
+static gint pv_img_write_comps(const PvImage *img, gint fd, GError **err)
+{
+	struct cipher_parms parms = { 0 };
+
+	if (img->pcf & PV_CFLAG_NO_DECRYPTION) {
+		/* we only need to align the components */
+		return pv_img_comps_write(img->comps, fd, NULL, err);
+	}
+
+	g_assert_cmpint((int)img->xts_key->size, ==,
+			EVP_CIPHER_key_length(img->xts_cipher));
+	g_assert_cmpint((int)PAGE_SIZE % EVP_CIPHER_block_size(img->xts_cipher),
+			==, 0);
+	g_assert_cmpint(AES_256_XTS_TWEAK_SIZE, ==,
+			EVP_CIPHER_iv_length(img->xts_cipher));
+
+	/* the tweak is set per component and page */
+	parms.cipher = img->xts_cipher;
+	parms.key = img->xts_key;
+	parms.iv_or_tweak = NULL;
+	return pv_img_comps_write(img->comps, fd, &parms, err);
+}
+
+/* Generates the PV header and the stage3a. At this point in time all
+ * components must be encrypted and hashed.
+ */
+static gint pv_img_build_hdr_and_stage3a(PvImage *pv, GError **err)
+{
+	g_autoptr(Buffer) hdr = NULL;
+
 	/* create the PV header */
 	hdr = pv_img_create_pv_hdr(pv, err);
 	if (!hdr)
@@ -788,6 +755,18 @@ gint pv_img_write(PvImage *img, const gchar *path, GError **err)
 	if (!f)
 		return -1;
 
+	/* The components are written first in a single pass, because the
+	 * PV header in the stage3a contains their digests. The list is
+	 * sorted by component type => by address.
+	 */
+	if (pv_img_write_comps(img, fileno(f), err) < 0) {
+		g_prefix_error(err, _("Failed to write image '%s': "), path);
+		goto err;
+	}
+
+	if (pv_img_build_hdr_and_stage3a(img, err) < 0)
+		goto err;
+
 	if (write_short_psw(f, &img->stage3a_psw, err) < 0) {
 		g_prefix_error(err, _("Failed to write image '%s': "), path);
 		goto err;
@@ -799,18 +778,12 @@ gint pv_img_write(PvImage *img, const gchar *path, GError **err)
 		goto err;
 	}
 
-	/* list is sorted by component type => by address */
-	for (GSList *iterator = pv_img_comps_get_comps(img->comps); iterator;
-	     iterator = iterator->next) {
-		gint rc;
-		const PvComponent *comp = iterator->data;
-
-		rc = pv_component_write(comp, f, err);
-		if (rc < 0) {
-			g_prefix_error(err, _("Failed to write image '%s': "),
-				       path);
-			goto err;
-		}
+	if (fflush(f) != 0) {
+		g_set_error(err, G_FILE_ERROR,
+			    (gint)g_file_error_from_errno(errno),
+			    _("Failed to write image '%s': %s"), path,
+			    g_strerror(errno));
+		goto err;
 	}
 
 	ret = 0;
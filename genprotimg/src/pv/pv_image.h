@@ -24,7 +24,6 @@
 #include "pv_stage3.h"
 
 typedef struct {
-	gchar *tmp_dir; /* directory used for temporary files */
 	Buffer *stage3a; /* stage3a containing IPIB and PV header */
 	gsize stage3a_bin_size; /* size of stage3a.bin */
 	struct psw_t stage3a_psw; /* (short) PSW that is written to
@@ -685,6 +685,75 @@ G_GNUC_UNUSED static gint decrypt_file(const struct cipher_parms *parms,
 				      out_size, FALSE, err);
 }
 
+/* Returns a cipher context for the encryption with @parms. If no
+ * IV/tweak is given it must be set for each encryption.
+ */
+EVP_CIPHER_CTX *cipher_ctx_new(const struct cipher_parms *parms, GError **err)
+{
+	g_autoptr(EVP_CIPHER_CTX) ctx = EVP_CIPHER_CTX_new();
+	const Buffer *iv = parms->iv_or_tweak;
+
+	if (!ctx)
+		g_abort();
+
+	g_assert(parms->key);
+	g_assert((int)parms->key->size == EVP_CIPHER_key_length(parms->cipher));
+	g_assert(!iv || (int)iv->size == EVP_CIPHER_iv_length(parms->cipher));
+
+	if (EVP_CipherInit_ex(ctx, parms->cipher, NULL, parms->key->data,
+			      iv ? iv->data : NULL, 1) != 1) {
+		g_set_error(err, PV_CRYPTO_ERROR, PV_CRYPTO_ERROR_INTERNAL,
+			    _("EVP_CipherInit_ex failed"));
+		return NULL;
+	}
+
+	return g_steal_pointer(&ctx);
+}
+
+/* Add @value to the big-endian tweak @tweak */
+static void tweak_add(union tweak *tweak, guint value)
+{
+	for (gint i = (gint)sizeof(tweak->data) - 1; i >= 0 && value; i--) {
+		value += tweak->data[i];
+		tweak->data[i] = (uint8_t)(value & 0xff);
+		value >>= 8;
+	}
+}
+
+/* Encrypts @size bytes of @in page by page to @out using AES-XTS. @tweak
+ * is used for the first page and is increased by PAGE_SIZE for each
+ * page, so that consecutive calls continue where the last call stopped.
+ */
+gint encrypt_pages(EVP_CIPHER_CTX *ctx, union tweak *tweak, const guchar *in,
+		   guchar *out, gsize size, GError **err)
+{
+	gint out_len;
+
+	g_assert(size % PAGE_SIZE == 0);
+
+	for (gsize cur = 0; cur < size; cur += PAGE_SIZE) {
+		if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, tweak->data, 1) != 1) {
+			g_set_error(err, PV_CRYPTO_ERROR,
+				    PV_CRYPTO_ERROR_INTERNAL,
+				    _("EVP_CipherInit_ex failed"));
+			return -1;
+		}
+
+		if (EVP_CipherUpdate(ctx, out + cur, &out_len, in + cur,
+				     (int)PAGE_SIZE) != 1) {
+			g_set_error(err, PV_CRYPTO_ERROR,
+				    PV_CRYPTO_ERROR_INTERNAL,
+				    _("EVP_CipherUpdate failed"));
+			return -1;
+		}
+		g_assert(out_len == (gint)PAGE_SIZE);
+
+		tweak_add(tweak, PAGE_SIZE);
+	}
+
+	return 0;
+}
+
 /* GCM mode uses (zero-)padding */
 static int64_t gcm_encrypt_decrypt(const Buffer *in, const Buffer *aad,
 				   const struct cipher_parms *parms,
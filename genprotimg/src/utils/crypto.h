@@ -98,6 +98,9 @@ gint encrypt_file(const struct cipher_parms *parms, const gchar *in_path,
 		  GError **err);
 Buffer *encrypt_buf(const struct cipher_parms *parms, const Buffer *in,
 		    GError **err);
+EVP_CIPHER_CTX *cipher_ctx_new(const struct cipher_parms *parms, GError **err);
+gint encrypt_pages(EVP_CIPHER_CTX *ctx, union tweak *tweak, const guchar *in,
+		   guchar *out, gsize size, GError **err);
 G_GNUC_UNUSED Buffer *decrypt_buf(const struct cipher_parms *parms,
 				  const Buffer *in, GError **err);
 
@@ -15,10 +15,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "pv/pv_error.h"
 
-#include "align.h"
 #include "buffer.h"
 #include "common.h"
 #include "file_utils.h"
@@ -126,51 +126,6 @@ static gint file_seek(FILE *f, uint64_t offset, GError **err)
 	return 0;
 }
 
-gint seek_and_write_file(FILE *o, const CompFile *ifile, uint64_t offset,
-			 GError **err)
-{
-	gsize bytes_read, bytes_written;
-	gsize total_bytes_read = 0;
-	FILE *i = NULL;
-	gchar buf[4096];
-	gint ret = -1;
-
-	if (file_seek(o, offset, err) < 0)
-		return -1;
-
-	i = file_open(ifile->path, "rb", err);
-	if (!i)
-		return -1;
-
-	do {
-		if (file_read(i, buf, 1, sizeof(buf), &bytes_read, err) < 0) {
-			g_prefix_error(err, _("Failed to read file '%s': "),
-				       ifile->path);
-			goto err;
-		}
-
-		if (bytes_read == 0)
-			break;
-
-		total_bytes_read += bytes_read;
-
-		if (file_write(o, buf, bytes_read, 1, &bytes_written, err) < 0)
-			goto err;
-	} while (bytes_written != 0);
-
-	if (ifile->size != total_bytes_read) {
-		g_set_error(err, PV_ERROR, PV_ERROR_INTERNAL,
-			    _("'%s' has changed during the preparation"),
-			    ifile->path);
-		goto err;
-	}
-
-	ret = 0;
-err:
-	fclose(i);
-	return ret;
-}
-
 gint seek_and_write_buffer(FILE *o, const Buffer *buf, uint64_t offset,
 			   GError **err)
 {
@@ -183,52 +138,57 @@ gint seek_and_write_buffer(FILE *o, const Buffer *buf, uint64_t offset,
 	return 0;
 }
 
-gint pad_file_right(const gchar *path_out, const gchar *path_in, gsize *size_out,
-		    guint padding, GError **err)
+/* Reads exactly @size bytes at @offset unless the end of the file is
+ * reached. Stores the number of bytes read in @count_read.
+ */
+gint file_pread(gint fd, void *ptr, gsize size, uint64_t offset,
+		gsize *count_read, GError **err)
 {
-	FILE *f_in, *f_out = NULL;
-	guchar buf[padding];
-	gsize num_bytes_written;
-	gsize num_bytes_read;
-	uint64_t size_in = 0;
-	gint ret = -1;
-
-	*size_out = 0;
-	f_in = file_open(path_in, "rb", err);
-	if (!f_in)
-		goto err;
-
-	f_out = file_open(path_out, "wb", err);
-	if (!f_out)
-		goto err;
-
-	do {
-		memset(buf, 0, sizeof(buf));
-
-		if (file_read(f_in, buf, 1, sizeof(buf), &num_bytes_read, err) < 0) {
-			g_prefix_error(err, _("Failed to read file '%s': "),
-				       path_in);
-			goto err;
+	gsize total = 0;
+	gssize rc;
+
+	while (total < size) {
+		rc = pread(fd, (guchar *)ptr + total, size - total,
+			   (off_t)(offset + total));
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0) {
+			g_set_error(err, G_FILE_ERROR,
+				    (gint)g_file_error_from_errno(errno),
+				    _("Failed to read file: %s"),
+				    g_strerror(errno));
+			return -1;
 		}
+		if (rc == 0)
+			break;
+		total += (gsize)rc;
+	}
 
-		size_in += num_bytes_read;
+	*count_read = total;
+	return 0;
+}
 
-		if (file_write(f_out, buf, 1, sizeof(buf), &num_bytes_written, err)) {
-			g_prefix_error(err, _("Failed to write file '%s': "),
-				       path_out);
-			goto err;
+/* Writes @size bytes at @offset */
+gint file_pwrite(gint fd, const void *ptr, gsize size, uint64_t offset,
+		 GError **err)
+{
+	gsize total = 0;
+	gssize rc;
+
+	while (total < size) {
+		rc = pwrite(fd, (const guchar *)ptr + total, size - total,
+			    (off_t)(offset + total));
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0) {
+			g_set_error(err, G_FILE_ERROR,
+				    (gint)g_file_error_from_errno(errno),
+				    _("Failed to write file: %s"),
+				    g_strerror(errno));
+			return -1;
 		}
+		total += (gsize)rc;
+	}
 
-		*size_out += num_bytes_written;
-	} while (num_bytes_read == padding);
-
-	g_assert(num_bytes_written == ALIGN(num_bytes_read, padding));
-
-	ret = 0;
-err:
-	if (f_out)
-		fclose(f_out);
-	if (f_in)
-		fclose(f_in);
-	return ret;
+	return 0;
 }
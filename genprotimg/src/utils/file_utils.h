@@ -14,8 +14,6 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "pv/pv_comp.h"
-
 #include "buffer.h"
 
 FILE *file_open(const gchar *filename, const gchar *mode, GError **err);
@@ -24,11 +22,11 @@ gint file_read(FILE *in, void *ptr, gsize size, gsize count,
 	       gsize *count_read, GError **err);
 gint file_write(FILE *out, const void *ptr, gsize size, gsize count,
 		gsize *count_written, GError **err);
-gint pad_file_right(const gchar *path_out, const gchar *path_in,
-		    gsize *size_out, guint padding, GError **err);
+gint file_pread(gint fd, void *ptr, gsize size, uint64_t offset,
+		gsize *count_read, GError **err);
+gint file_pwrite(gint fd, const void *ptr, gsize size, uint64_t offset,
+		 GError **err);
 gint seek_and_write_buffer(FILE *out, const Buffer *buf, uint64_t offset,
 			   GError **err);
-gint seek_and_write_file(FILE *o, const CompFile *ifile, uint64_t offset,
-			 GError **err);
 
 #endif
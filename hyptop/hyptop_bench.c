@@ -0,0 +1,438 @@
+/*
+ * hyptop - Show hypervisor performance data on System z
+ *
+ * Benchmark for the system data update and the system table
+ *
+ * Feed synthetic diag 2fc data for many z/VM guests and diag 204 data for
+ * many LPAR CPUs through the debugfs data gatherers. Each refresh updates
+ * the system data and builds the sorted table of the system list window.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <fcntl.h>
+#include <iconv.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/* Include the z/VM data gatherer to register it without /proc/sysinfo */
+#include "dg_debugfs_vm.c"
+
+#include "table.h"
+
+#define DEFAULT_GUESTS	5000
+#define REFRESH_CNT	100
+#define LPAR_CNT	250
+#define LPAR_CPUS	20
+
+/* Structures of the diag 204 debugfs file, see dg_debugfs_lpar.c */
+struct bench_d204_hdr {
+	u64	len;
+	u16	version;
+	u8	reserved[54];
+	u8	npar;
+	u8	flags;
+	u8	reserved1[6];
+	u64	curtod1;
+	u64	curtod2;
+	u8	reserved2[40];
+} __attribute__ ((packed));
+
+struct bench_d204_sys {
+	u8	reserved1;
+	u8	cpus;
+	u8	rcpus;
+	u8	reserved2[5];
+	char	sys_name[8];
+	u8	reserved3[33];
+	u8	mtid;
+	u8	reserved4[46];
+} __attribute__ ((packed));
+
+struct bench_d204_cpu {
+	u16	cpu_addr;
+	u8	reserved1[2];
+	u8	ctidx;
+	u8	reserved2[3];
+	u64	acc_time;
+	u64	lp_time;
+	u8	reserved3[8];
+	u64	online_time;
+	u8	reserved4[24];
+	u64	mt_idle_time;
+	u8	reserved5[24];
+} __attribute__ ((packed));
+
+struct hyptop_globals g;
+
+static char l_debugfs_dir[] = "hyptop_bench.XXXXXX";
+static struct table_col l_col_sys = TABLE_COL_STR_LEFT('y', "system");
+static void (*l_fill_fn)(unsigned int, void *);
+static void *l_fill_data;
+static unsigned int l_snapshot_nr;
+static struct timespec l_ts;
+static int l_timer_running;
+static double l_sec;
+
+static void timer_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &l_ts);
+	l_timer_running = 1;
+}
+
+static void timer_stop(void)
+{
+	struct timespec ts;
+
+	if (!l_timer_running)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	l_sec += (ts.tv_sec - l_ts.tv_sec) + (ts.tv_nsec - l_ts.tv_nsec) / 1e9;
+	l_timer_running = 0;
+}
+
+static void timer_report(const char *name, unsigned long count)
+{
+	printf("%-28s %10lu %10.3f s %8.3f ms/refresh\n", name, count, l_sec,
+	       l_sec * 1e3 / REFRESH_CNT);
+	fflush(stdout);
+	l_sec = 0;
+}
+
+/*
+ * The benchmark does not use curses
+ */
+void hyptop_text_mode(void)
+{
+}
+
+void __noreturn hyptop_exit(int rc)
+{
+	exit(rc);
+}
+
+/*
+ * Open a file of the synthetic debugfs directory
+ *
+ * Each open returns a new snapshot, as if the kernel had updated the data
+ * in the meantime. Writing the snapshot is not measured.
+ */
+int dg_debugfs_open(const char *file)
+{
+	int running = l_timer_running;
+	char path[PATH_MAX];
+	int fh;
+
+	if (l_fill_fn) {
+		timer_stop();
+		l_fill_fn(++l_snapshot_nr, l_fill_data);
+		if (running)
+			timer_start();
+	}
+	snprintf(path, sizeof(path), "%s/%s", l_debugfs_dir, file);
+	fh = open(path, O_RDONLY);
+	if (fh == -1)
+		return -errno;
+	return fh;
+}
+
+static void l_file_write(const char *file, void *buf, size_t size)
+{
+	char path[PATH_MAX];
+	FILE *fh;
+
+	snprintf(path, sizeof(path), "%s/%s", l_debugfs_dir, file);
+	fh = fopen(path, "w");
+	if (!fh || fwrite(buf, size, 1, fh) != 1)
+		ERR_EXIT_ERRNO("Could not write '%s'", path);
+	fclose(fh);
+}
+
+static void l_file_remove(const char *file)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", l_debugfs_dir, file);
+	unlink(path);
+}
+
+/*
+ * Convert blank padded system name to EBCDIC
+ */
+static void l_name_set(char *out, const char *fmt, int nr)
+{
+	char name[NAME_LEN + 1], *in = name;
+	size_t size_in = NAME_LEN, size_out = NAME_LEN;
+	iconv_t cd;
+
+	snprintf(name, sizeof(name), fmt, nr);
+	memset(name + strlen(name), ' ', NAME_LEN - strlen(name));
+	cd = iconv_open("EBCDIC-US", "ISO-8859-1");
+	if (cd == (iconv_t) -1 ||
+	    iconv(cd, &in, &size_in, &out, &size_out) == (size_t) -1)
+		ERR_EXIT("Could not convert system name\n");
+	iconv_close(cd);
+}
+
+/*
+ * Add system item to table row, see win_sys_list.c
+ */
+static void l_sys_item_add(struct table_row *table_row, struct sd_sys *sys,
+			   struct sd_sys_item *item)
+{
+	switch (sd_sys_item_type(item)) {
+	case SD_TYPE_U64:
+	case SD_TYPE_U32:
+	case SD_TYPE_U16:
+		table_row_entry_u64_add(table_row,
+					sd_sys_item_table_col(item),
+					sd_sys_item_u64(sys, item));
+		break;
+	case SD_TYPE_S64:
+		table_row_entry_s64_add(table_row,
+					sd_sys_item_table_col(item),
+					sd_sys_item_s64(sys, item));
+		break;
+	case SD_TYPE_STR:
+		table_row_entry_str_add(table_row,
+					sd_sys_item_table_col(item),
+					sd_sys_item_str(sys, item));
+		break;
+	}
+}
+
+/*
+ * Create the table of the system list window, sorted by CPU time
+ */
+static struct table *l_table_new(void)
+{
+	struct sd_sys_item *item;
+	struct table *t;
+	unsigned int i;
+
+	t = table_new(1, 1, 1, 1);
+	table_col_add(t, &l_col_sys);
+	sd_sys_item_iterate(item, i)
+		table_col_add(t, sd_sys_item_table_col(item));
+	table_col_select(t, 'c');
+	return t;
+}
+
+/*
+ * Fill system data into table, see win_sys_list.c
+ */
+static void l_table_create(struct table *t)
+{
+	struct sd_sys *parent, *sys;
+	struct table_row *table_row;
+	struct sd_sys_item *item;
+	unsigned int i;
+
+	table_row_del_all(t);
+	parent = sd_sys_root_get();
+	sd_sys_iterate(parent, sys) {
+		table_row = table_row_alloc(t);
+		table_row_entry_str_add(table_row, &l_col_sys, sd_sys_id(sys));
+		sd_sys_item_iterate(item, i) {
+			if (!sd_sys_item_set(sys, item))
+				continue;
+			l_sys_item_add(table_row, sys, item);
+		}
+		table_row_add(t, table_row);
+	}
+	table_finish(t);
+}
+
+/*
+ * Run refreshes and measure the data update and the table build
+ */
+static void l_refresh(const char *name, unsigned long count)
+{
+	char str[64];
+	struct table *t;
+	unsigned int i;
+
+	t = l_table_new();
+	for (i = 0; i < REFRESH_CNT; i++) {
+		timer_start();
+		sd_update();
+		timer_stop();
+	}
+	snprintf(str, sizeof(str), "%s update", name);
+	timer_report(str, count);
+
+	for (i = 0; i < REFRESH_CNT; i++) {
+		timer_start();
+		l_table_create(t);
+		timer_stop();
+	}
+	snprintf(str, sizeof(str), "%s table", name);
+	timer_report(str, count);
+}
+
+/*
+ * Write diag 2fc data with random CPU times for refresh "nr"
+ */
+static void l_2fc_fill(unsigned int nr, void *data)
+{
+	struct l_debugfs_d2fc *d2fc = data;
+	struct l_diag2fc_data *guest = (void *) d2fc->diag2fc_buf;
+	unsigned int i;
+
+	*(u64 *) d2fc->h.tod_ext = (u64) nr << 24;
+	for (i = 0; i < d2fc->h.count; i++) {
+		guest[i].used_cpu += rand() % 1000000;
+		guest[i].el_time = (u64) nr * 1000000;
+	}
+	l_file_write(DEBUGFS_FILE, d2fc, sizeof(d2fc->h) + d2fc->h.len);
+}
+
+/*
+ * Benchmark the z/VM data gatherer with "count" guests
+ */
+static void l_bench_2fc(unsigned long count)
+{
+	struct l_diag2fc_data *guest;
+	struct l_debugfs_d2fc *d2fc;
+	unsigned int i;
+
+	d2fc = ht_zalloc(sizeof(*d2fc) + count * sizeof(*guest));
+	d2fc->h.len = count * sizeof(*guest);
+	d2fc->h.count = count;
+	guest = (void *) d2fc->diag2fc_buf;
+	for (i = 0; i < count; i++) {
+		l_name_set(guest[i].guest_name, "G%07u", i);
+		guest[i].lcpus = 64;
+		guest[i].vcpus = 4;
+		guest[i].ocpus = 2;
+		guest[i].cpu_max = 100;
+		guest[i].cpu_shares = 100;
+		guest[i].mem_max_kb = 4 << 20;
+		guest[i].mem_used_kb = 1 << 20;
+	}
+	l_fill_fn = l_2fc_fill;
+	l_fill_data = d2fc;
+	l_2fc_buf_size = sizeof(struct l_debugfs_d2fc_hdr);
+	sd_dg_register(&dg_debugfs_vm_dg, 0);
+	l_refresh("diag 2fc", count);
+	l_file_remove(DEBUGFS_FILE);
+	ht_free(d2fc);
+}
+
+/*
+ * Write diag 204 data with random CPU times for refresh "nr"
+ */
+static void l_204_fill(unsigned int nr, void *data)
+{
+	struct bench_d204_hdr *hdr = data;
+	struct bench_d204_cpu *cpu;
+	struct bench_d204_sys *sys;
+	unsigned int i, j;
+
+	hdr->curtod1 = (u64) nr << 24;
+	sys = (void *) (hdr + 1);
+	for (i = 0; i < hdr->npar; i++) {
+		cpu = (void *) (sys + 1);
+		for (j = 0; j < sys->rcpus; j++, cpu++) {
+			cpu->lp_time += rand() % 1000000;
+			cpu->acc_time = cpu->lp_time + 1000;
+			cpu->online_time = (u64) nr * 1000000;
+		}
+		sys = (void *) cpu;
+	}
+	l_file_write("diag_204", hdr,
+		     offsetof(struct bench_d204_hdr, npar) + hdr->len);
+}
+
+/*
+ * Benchmark the LPAR data gatherer with the maximum number of LPARs
+ */
+static void l_bench_204(void)
+{
+	struct bench_d204_hdr *hdr;
+	struct bench_d204_cpu *cpu;
+	struct bench_d204_sys *sys;
+	unsigned int i, j;
+	size_t len;
+
+	len = sizeof(*hdr) + LPAR_CNT * (sizeof(*sys) +
+					 LPAR_CPUS * sizeof(*cpu));
+	hdr = ht_zalloc(len);
+	hdr->len = len - offsetof(struct bench_d204_hdr, npar);
+	hdr->npar = LPAR_CNT;
+	sys = (void *) (hdr + 1);
+	for (i = 0; i < LPAR_CNT; i++) {
+		l_name_set(sys->sys_name, "LP%03u", i);
+		sys->cpus = sys->rcpus = LPAR_CPUS;
+		cpu = (void *) (sys + 1);
+		for (j = 0; j < LPAR_CPUS; j++, cpu++) {
+			cpu->cpu_addr = j;
+			cpu->ctidx = (j % 2) ? 3 : 0;
+		}
+		sys = (void *) cpu;
+	}
+	l_fill_fn = l_204_fill;
+	l_fill_data = hdr;
+	if (dg_debugfs_lpar_init())
+		ERR_EXIT("Could not initialize LPAR data gatherer\n");
+	l_refresh("diag 204", LPAR_CNT * LPAR_CPUS);
+	l_file_remove("diag_204");
+	ht_free(hdr);
+}
+
+/*
+ * Run a benchmark in a child process with its own system data
+ */
+static void l_bench_run(void (*bench_fn)(unsigned long), unsigned long count)
+{
+	int status;
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		ERR_EXIT_ERRNO("Could not fork");
+	if (pid == 0) {
+		hyptop_helper_init();
+		sd_init();
+		srand(1);
+		bench_fn(count);
+		exit(EXIT_SUCCESS);
+	}
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		ERR_EXIT("Benchmark failed\n");
+}
+
+static void l_bench_204_run(unsigned long UNUSED(count))
+{
+	l_bench_204();
+}
+
+/*
+ * Run the benchmarks with an optional number of z/VM guests
+ */
+int main(int argc, char *argv[])
+{
+	unsigned long count = DEFAULT_GUESTS;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (!count) {
+		fprintf(stderr, "Usage: %s [GUESTS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	g.o.batch_mode_specified = 1;
+	if (!mkdtemp(l_debugfs_dir))
+		ERR_EXIT_ERRNO("Could not create debugfs directory");
+
+	printf("%-28s %10s %12s %17s\n", "Benchmark", "Entries", "Time",
+	       "Refresh");
+	l_bench_run(l_bench_2fc, count);
+	l_bench_run(l_bench_204_run, LPAR_CNT * LPAR_CPUS);
+	rmdir(l_debugfs_dir);
+	return EXIT_SUCCESS;
+}
@@ -70,19 +70,31 @@ struct sd_info {
 
 struct sd_cpu;
 
+/*
+ * Hash index for the children or CPUs of a system (key is the ID)
+ */
+struct sd_hash {
+	void	**bucket;
+	u32	size;
+	u32	cnt;
+};
+
 /*
  * SD System (can be e.g. CEC, VM or guest/LPAR)
  */
 struct sd_sys {
 	struct util_list_node	list;
+	struct sd_sys		*hash_next;
 	struct sd_info		i;
 	u64			update_time_us;
 	u32			child_cnt;
 	u32			child_cnt_active;
 	struct util_list	child_list;
+	struct sd_hash		child_hash;
 	u32			cpu_cnt;
 	u32			cpu_cnt_active;
 	struct util_list	cpu_list;
+	struct sd_hash		cpu_hash;
 	u32			threads_per_core;
 	char			id[SD_SYS_ID_SIZE];
 	struct sd_sys_name	name;
@@ -192,6 +204,7 @@ enum sd_cpu_state {
 
 struct sd_cpu {
 	struct util_list_node	list;
+	struct sd_cpu		*hash_next;
 	struct sd_info		i;
 	char			id[9];
 	struct sd_cpu_type	*type;
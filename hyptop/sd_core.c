@@ -180,6 +180,77 @@ int sd_dg_has_core_data(void)
 	return l_has_core_data;
 }
 
+/*
+ * Hash function for system and CPU IDs (FNV-1a)
+ */
+static u32 l_hash_idx(struct sd_hash *hash, const char *id)
+{
+	u32 h = 2166136261U;
+
+	while (*id) {
+		h ^= (unsigned char) *id++;
+		h *= 16777619U;
+	}
+	return h % hash->size;
+}
+
+/*
+ * Resize hash index, if it has more entries than buckets
+ *
+ * Returns 1 if the caller has to rebuild the index.
+ */
+static int l_hash_grow(struct sd_hash *hash)
+{
+	if (hash->cnt < hash->size)
+		return 0;
+	ht_free(hash->bucket);
+	hash->size = hash->size ? hash->size * 2 : 16;
+	hash->bucket = ht_zalloc(hash->size * sizeof(void *));
+	return 1;
+}
+
+/*
+ * Add CPU to hash index of system
+ */
+static void l_cpu_hash_add(struct sd_sys *sys, struct sd_cpu *cpu)
+{
+	struct sd_cpu **bucket;
+	struct sd_cpu *tmp;
+
+	if (l_hash_grow(&sys->cpu_hash)) {
+		/* Rebuild index with all CPUs, including the new one */
+		sys->cpu_hash.cnt = 0;
+		util_list_iterate(&sys->cpu_list, tmp) {
+			bucket = (struct sd_cpu **) &sys->cpu_hash.bucket[
+				l_hash_idx(&sys->cpu_hash, tmp->id)];
+			tmp->hash_next = *bucket;
+			*bucket = tmp;
+			sys->cpu_hash.cnt++;
+		}
+		return;
+	}
+	bucket = (struct sd_cpu **)
+		&sys->cpu_hash.bucket[l_hash_idx(&sys->cpu_hash, cpu->id)];
+	cpu->hash_next = *bucket;
+	*bucket = cpu;
+	sys->cpu_hash.cnt++;
+}
+
+/*
+ * Remove CPU from hash index of system
+ */
+static void l_cpu_hash_del(struct sd_sys *sys, struct sd_cpu *cpu)
+{
+	struct sd_cpu **ptr;
+
+	ptr = (struct sd_cpu **)
+		&sys->cpu_hash.bucket[l_hash_idx(&sys->cpu_hash, cpu->id)];
+	while (*ptr != cpu)
+		ptr = &(*ptr)->hash_next;
+	*ptr = cpu->hash_next;
+	sys->cpu_hash.cnt--;
+}
+
 /*
  * Get CPU from sys by ID
  */
@@ -187,7 +258,10 @@ struct sd_cpu *sd_cpu_get(struct sd_sys *sys, const char* id)
 {
 	struct sd_cpu *cpu;
 
-	util_list_iterate(&sys->cpu_list, cpu) {
+	if (!sys->cpu_hash.size)
+		return NULL;
+	cpu = sys->cpu_hash.bucket[l_hash_idx(&sys->cpu_hash, id)];
+	for (; cpu; cpu = cpu->hash_next) {
 		if (strcmp(cpu->id, id) == 0)
 			return cpu;
 	}
@@ -225,10 +299,55 @@ struct sd_cpu *sd_cpu_new(struct sd_sys *parent, const char *id,
 	cpu->cnt = cnt;
 
 	util_list_add_tail(&parent->cpu_list, cpu);
+	l_cpu_hash_add(parent, cpu);
 
 	return cpu;
 }
 
+/*
+ * Add system to hash index of parent
+ */
+static void l_sys_hash_add(struct sd_sys *parent, struct sd_sys *sys)
+{
+	struct sd_sys **bucket;
+	struct sd_sys *tmp;
+
+	if (l_hash_grow(&parent->child_hash)) {
+		/* Rebuild index with all children, including the new one */
+		parent->child_hash.cnt = 0;
+		util_list_iterate(&parent->child_list, tmp) {
+			bucket = (struct sd_sys **) &parent->child_hash.bucket[
+				l_hash_idx(&parent->child_hash, tmp->id)];
+			tmp->hash_next = *bucket;
+			*bucket = tmp;
+			parent->child_hash.cnt++;
+		}
+		return;
+	}
+	bucket = (struct sd_sys **)
+		&parent->child_hash.bucket[l_hash_idx(&parent->child_hash,
+						      sys->id)];
+	sys->hash_next = *bucket;
+	*bucket = sys;
+	parent->child_hash.cnt++;
+}
+
+/*
+ * Remove system from hash index of parent
+ */
+static void l_sys_hash_del(struct sd_sys *parent, struct sd_sys *sys)
+{
+	struct sd_sys **ptr;
+
+	ptr = (struct sd_sys **)
+		&parent->child_hash.bucket[l_hash_idx(&parent->child_hash,
+						      sys->id)];
+	while (*ptr != sys)
+		ptr = &(*ptr)->hash_next;
+	*ptr = sys->hash_next;
+	parent->child_hash.cnt--;
+}
+
 /*
  * Get system by ID
  */
@@ -236,7 +355,10 @@ struct sd_sys *sd_sys_get(struct sd_sys *parent, const char* id)
 {
 	struct sd_sys *sys;
 
-	util_list_iterate(&parent->child_list, sys) {
+	if (!parent->child_hash.size)
+		return NULL;
+	sys = parent->child_hash.bucket[l_hash_idx(&parent->child_hash, id)];
+	for (; sys; sys = sys->hash_next) {
 		if (strcmp(sys->id, id) == 0)
 			return sys;
 	}
@@ -259,6 +381,7 @@ struct sd_sys *sd_sys_new(struct sd_sys *parent, const char *id)
 		sys_new->i.parent = parent;
 		parent->child_cnt++;
 		util_list_add_tail(&parent->child_list, sys_new);
+		l_sys_hash_add(parent, sys_new);
 	}
 	sys_new->threads_per_core = 1;
 	return sys_new;
@@ -269,6 +392,8 @@ struct sd_sys *sd_sys_new(struct sd_sys *parent, const char *id)
  */
 static void sd_sys_free(struct sd_sys *sys)
 {
+	ht_free(sys->child_hash.bucket);
+	ht_free(sys->cpu_hash.bucket);
 	ht_free(sys);
 }
 
@@ -330,6 +455,7 @@ static void l_cpu_update_end(struct sd_sys *sys)
 		if (!cpu->i.active) {
 			/* CPU has not been updated, remove it */
 			util_list_remove(&sys->cpu_list, cpu);
+			l_cpu_hash_del(sys, cpu);
 			sd_cpu_free(cpu);
 			continue;
 		}
@@ -350,6 +476,7 @@ static void l_sys_update_end(struct sd_sys *sys)
 		if (!child->i.active) {
 			/* child has not been updated, remove it */
 			util_list_remove(&sys->child_list, child);
+			l_sys_hash_del(sys, child);
 			sd_sys_free(child);
 			continue;
 		}
@@ -410,36 +410,42 @@ static void l_row_last_calc(struct table *t)
 	l_row_format(t, t->row_last);
 }
 
+/*
+ * Compare callback for linked list sorting (ordering: large to small)
+ */
+static int l_row_cmp_fn(void *a, void *b, void *data)
+{
+	return l_row_less_than(data, a, b) ? 1 : -1;
+}
+
+/*
+ * Sort table (ordering: large to small)
+ */
+static void l_table_sort(struct table *t)
+{
+	util_list_sort(&t->row_list, l_row_cmp_fn, t);
+}
+
 /*
  * Finish table after all rows have been added
  */
 void table_finish(struct table *t)
 {
+	if (t->attr_sorted_table)
+		l_table_sort(t);
 	l_row_last_calc(t);
 	t->ready = 1;
 }
 
 /*
  * Add new row to table
+ *
+ * For sorted tables the rows are sorted by table_finish().
  */
 void table_row_add(struct table *t, struct table_row *row)
 {
-	struct table_row *tmp;
-
 	l_row_format(t, row);
-
-	if (util_list_is_empty(&t->row_list) || !t->attr_sorted_table) {
-		util_list_add_tail(&t->row_list, row);
-	} else {
-		util_list_iterate(&t->row_list, tmp) {
-			if (l_row_less_than(t, tmp, row))
-				break;
-		}
-		if (tmp)
-			util_list_add_prev(&t->row_list, row, tmp);
-		else
-			util_list_add_tail(&t->row_list, row);
-	}
+	util_list_add_tail(&t->row_list, row);
 	if (l_row_is_marked(t, row)) {
 		row->marked = 1;
 		t->row_cnt_marked++;
@@ -463,22 +469,6 @@ void table_rebuild(struct table *t)
 	l_row_format(t, t->row_last);
 }
 
-/*
- * Compare callback for linked list sorting (ordering: large to small)
- */
-static int l_row_cmp_fn(void *a, void *b, void *data)
-{
-	return l_row_less_than(data, a, b) ? 1 : -1;
-}
-
-/*
- * Sort table (ordering: large to small)
- */
-static void l_table_sort(struct table *t)
-{
-	util_list_sort(&t->row_list, l_row_cmp_fn, t);
-}
-
 /*
  * Adjust table values for select mode (e.g. for window resize or scrolling)
  */
@@ -462,6 +462,13 @@ struct memberiterator;
  */
 struct dshandle;
 
+/**
+ * @struct trackcache
+ * @brief A size bounded cache of raw tracks that can be shared by
+ * several dshandles.
+ */
+struct trackcache;
+
 /**
  * @struct error_log
  * @brief A stack of error messages that are related to the last error
@@ -796,6 +803,45 @@ int lzds_dshandle_set_keepRDW(struct dshandle *dsh, int keepRDW);
  */
 void lzds_dshandle_get_keepRDW(struct dshandle *dsh, int *keepRDW);
 
+/**
+ * @brief Set the flag that causes the library to read the next track frame
+ * in a helper thread while the current one is interpreted.
+ */
+int lzds_dshandle_set_readahead(struct dshandle *dsh, int readahead);
+
+/**
+ * @brief Read out the current setting of the read-ahead flag.
+ */
+void lzds_dshandle_get_readahead(struct dshandle *dsh, int *readahead);
+
+/**
+ * @brief Let the dshandle read tracks through a track cache.
+ */
+int lzds_dshandle_set_trackcache(struct dshandle *dsh,
+				 struct trackcache *cache);
+
+/**
+ * @brief Allocate a track cache that holds up to size bytes of track data.
+ */
+int lzds_trackcache_alloc(unsigned long long size, struct trackcache **cache);
+
+/**
+ * @brief Free a track cache that is no longer used by any dshandle.
+ */
+void lzds_trackcache_free(struct trackcache *cache);
+
+/**
+ * @brief Remove all tracks from a track cache.
+ */
+void lzds_trackcache_flush(struct trackcache *cache);
+
+/**
+ * @brief Get the number of tracks that were found and not found in the cache.
+ */
+void lzds_trackcache_get_stats(struct trackcache *cache,
+			       unsigned long long *hits,
+			       unsigned long long *misses);
+
 /**
  * @brief Prepares the dsh and the related devices for read operations.
  */
@@ -853,6 +899,13 @@ void lzds_pdsmember_get_name(struct pdsmember *member, char **name);
 int lzds_zdsroot_extract_datasets_from_dasd(struct zdsroot *root,
 					    struct dasd *dasd);
 
+/**
+ * @brief Read the VTOCs of all dasds in the zdsroot in parallel and add
+ *        the data sets found on them to the list of data sets.
+ */
+int lzds_zdsroot_extract_datasets_from_dasds(struct zdsroot *root,
+					     unsigned int threads);
+
 
 void lzds_dslist_free(struct zdsroot *root);
 
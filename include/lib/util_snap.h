@@ -0,0 +1,37 @@
+/**
+ * @defgroup util_snap_h util_snap: Directory snapshot interface
+ * @{
+ * @brief Read all attribute files of a directory in one pass
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIB_UTIL_SNAP_H
+#define LIB_UTIL_SNAP_H
+
+#include <stddef.h>
+
+struct util_snap;
+
+struct util_snap *util_snap_new(const char *fmt, ...);
+int util_snap_new_vec(struct util_snap **snap_vec, char * const *path_vec,
+		      int count, int threads);
+void util_snap_free(struct util_snap *snap);
+
+const char *util_snap_path(struct util_snap *snap);
+int util_snap_count(struct util_snap *snap);
+const char *util_snap_get(struct util_snap *snap, const char *name);
+
+int util_snap_read_line(struct util_snap *snap, char *str, size_t size,
+			const char *name);
+int util_snap_read_i(struct util_snap *snap, int *val, int base,
+		     const char *name);
+int util_snap_read_ul(struct util_snap *snap, unsigned long *val, int base,
+		      const char *name);
+int util_snap_read_ull(struct util_snap *snap, unsigned long long *val,
+		       int base, const char *name);
+
+#endif /** LIB_UTIL_SNAP_H @} */
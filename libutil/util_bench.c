@@ -0,0 +1,322 @@
+/**
+ * util_bench - Benchmark for libutil data structures
+ *
+ * Measure util_list_sort(), util_rec formatting, util_scandir() and
+ * sysfs attribute reading with large synthetic inputs.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib/util_file.h"
+#include "lib/util_libc.h"
+#include "lib/util_list.h"
+#include "lib/util_rec.h"
+#include "lib/util_scandir.h"
+#include "lib/util_snap.h"
+#include "lib/zt_common.h"
+
+#define DEFAULT_COUNT	100000
+#define SNAP_ATTRS	40
+#define SNAP_THREADS	8
+
+struct entry {
+	struct util_list_node	node;
+	unsigned int		key;
+	unsigned int		seq;
+};
+
+static struct timespec start_ts;
+
+static void timer_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+}
+
+static void timer_report(const char *name, unsigned long count)
+{
+	struct timespec ts;
+	double sec;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sec = (ts.tv_sec - start_ts.tv_sec) +
+		(ts.tv_nsec - start_ts.tv_nsec) / 1e9;
+	printf("%-28s %10lu %10.3f s\n", name, count, sec);
+	fflush(stdout);
+}
+
+static int entry_cmp(void *a, void *b, void *UNUSED(data))
+{
+	struct entry *e1 = a, *e2 = b;
+
+	return (e1->key > e2->key) - (e1->key < e2->key);
+}
+
+/*
+ * Sort a list and verify that the result is sorted and stable
+ */
+static void bench_list_sort(const char *name, unsigned long count,
+			    unsigned int (*key_fn)(unsigned long i))
+{
+	struct entry *vec, *e, *prev = NULL;
+	struct util_list list;
+	unsigned long i;
+
+	vec = util_malloc(count * sizeof(*vec));
+	util_list_init(&list, struct entry, node);
+	for (i = 0; i < count; i++) {
+		vec[i].key = key_fn(i);
+		vec[i].seq = i;
+		util_list_add_tail(&list, &vec[i]);
+	}
+	timer_start();
+	util_list_sort(&list, entry_cmp, NULL);
+	timer_report(name, count);
+	util_list_iterate(&list, e) {
+		if (prev && (prev->key > e->key ||
+			     (prev->key == e->key && prev->seq > e->seq))) {
+			fprintf(stderr, "%s: list is not sorted\n", name);
+			exit(EXIT_FAILURE);
+		}
+		prev = e;
+	}
+	free(vec);
+}
+
+static unsigned int key_random(unsigned long UNUSED(i))
+{
+	return rand() % 1000;
+}
+
+static unsigned int key_sorted(unsigned long i)
+{
+	return i;
+}
+
+static unsigned int key_reverse(unsigned long i)
+{
+	return ~i;
+}
+
+/*
+ * Format records in wide and csv format, the output is discarded
+ */
+static void bench_rec(unsigned long count)
+{
+	static const char * const fmt_vec[] = {"util_rec wide", "util_rec csv"};
+	struct util_rec *rec;
+	int fd, saved_fd, f;
+	unsigned long i;
+
+	fflush(stdout);
+	saved_fd = dup(STDOUT_FILENO);
+	fd = open("/dev/null", O_WRONLY);
+	if (saved_fd < 0 || fd < 0) {
+		perror("Could not redirect output");
+		exit(EXIT_FAILURE);
+	}
+	for (f = 0; f < 2; f++) {
+		rec = f ? util_rec_new_csv(",") : util_rec_new_wide("-");
+		util_rec_def(rec, "number", UTIL_REC_ALIGN_RIGHT, 10, "Number");
+		util_rec_def(rec, "name", UTIL_REC_ALIGN_LEFT, 16, "Name");
+		util_rec_def(rec, "size", UTIL_REC_ALIGN_RIGHT, 12, "Size");
+		util_rec_def(rec, "state", UTIL_REC_ALIGN_LEFT, 8, "State");
+		dup2(fd, STDOUT_FILENO);
+		timer_start();
+		util_rec_print_hdr(rec);
+		for (i = 0; i < count; i++) {
+			util_rec_set(rec, "number", "%lu", i);
+			util_rec_set(rec, "name", "entry%lu", i);
+			util_rec_set(rec, "size", "%lu", i * 4096);
+			util_rec_set(rec, "state", i % 2 ? "online" : "offline");
+			util_rec_print(rec);
+		}
+		fflush(stdout);
+		dup2(saved_fd, STDOUT_FILENO);
+		timer_report(fmt_vec[f], count);
+		util_rec_free(rec);
+	}
+	close(fd);
+	close(saved_fd);
+}
+
+/*
+ * Scan a temporary directory with files "file<hex number>"
+ */
+static void bench_scandir(unsigned long count)
+{
+	char dir[] = "/tmp/util_bench.XXXXXX";
+	struct dirent **de_vec;
+	char path[PATH_MAX];
+	unsigned long i;
+	int fd, n;
+
+	if (!mkdtemp(dir)) {
+		perror("Could not create directory");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "%s/file%lx", dir, i);
+		fd = open(path, O_CREAT | O_WRONLY, 0600);
+		if (fd < 0) {
+			perror("Could not create file");
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+	}
+	timer_start();
+	n = util_scandir(&de_vec, util_scandir_hexsort, dir,
+			 "file[0-9a-f]+");
+	timer_report("util_scandir hexsort", count);
+	if (n != (int) count) {
+		fprintf(stderr, "util_scandir found %d of %lu files\n",
+			n, count);
+		exit(EXIT_FAILURE);
+	}
+	util_scandir_free(de_vec, n);
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "%s/file%lx", dir, i);
+		unlink(path);
+	}
+	rmdir(dir);
+}
+
+/*
+ * Verify the attributes of a fake sysfs device directory
+ */
+static void snap_check(struct util_snap *snap, unsigned long dev)
+{
+	unsigned long val;
+	char name[16];
+	int a;
+
+	if (!snap) {
+		fprintf(stderr, "Could not read device %lu\n", dev);
+		exit(EXIT_FAILURE);
+	}
+	for (a = 0; a < SNAP_ATTRS; a++) {
+		snprintf(name, sizeof(name), "attr%d", a);
+		if (util_snap_read_ul(snap, &val, 10, name) ||
+		    val != dev * SNAP_ATTRS + a) {
+			fprintf(stderr, "Wrong value for %s/%s\n",
+				util_snap_path(snap), name);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/*
+ * Read a fake sysfs tree with "count" device directories
+ */
+static void bench_snap(unsigned long count)
+{
+	char dir[] = "/tmp/util_bench.XXXXXX";
+	struct util_snap **snap_vec;
+	char path[PATH_MAX], **path_vec;
+	unsigned long i, val;
+	int a;
+
+	if (!mkdtemp(dir)) {
+		perror("Could not create directory");
+		exit(EXIT_FAILURE);
+	}
+	path_vec = util_malloc(count * sizeof(*path_vec));
+	snap_vec = util_malloc(count * sizeof(*snap_vec));
+	for (i = 0; i < count; i++) {
+		util_asprintf(&path_vec[i], "%s/0.0.%04lx", dir, i);
+		if (mkdir(path_vec[i], 0700)) {
+			perror("Could not create directory");
+			exit(EXIT_FAILURE);
+		}
+		for (a = 0; a < SNAP_ATTRS; a++) {
+			util_file_write_ul(i * SNAP_ATTRS + a, 10, "%s/attr%d",
+					   path_vec[i], a);
+		}
+		/* Symbolic links and subdirectories are skipped */
+		snprintf(path, sizeof(path), "%s/subsystem", path_vec[i]);
+		symlink(dir, path);
+		snprintf(path, sizeof(path), "%s/power", path_vec[i]);
+		mkdir(path, 0700);
+	}
+
+	timer_start();
+	for (i = 0; i < count; i++) {
+		for (a = 0; a < SNAP_ATTRS; a++) {
+			if (util_file_read_ul(&val, 10, "%s/attr%d",
+					      path_vec[i], a) ||
+			    val != i * SNAP_ATTRS + a) {
+				fprintf(stderr, "Wrong value for %s/attr%d\n",
+					path_vec[i], a);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	timer_report("util_file_read_ul", count * SNAP_ATTRS);
+
+	timer_start();
+	for (i = 0; i < count; i++) {
+		snap_vec[i] = util_snap_new("%s", path_vec[i]);
+		snap_check(snap_vec[i], i);
+		util_snap_free(snap_vec[i]);
+	}
+	timer_report("util_snap_new", count * SNAP_ATTRS);
+
+	timer_start();
+	util_snap_new_vec(snap_vec, path_vec, count, SNAP_THREADS);
+	for (i = 0; i < count; i++) {
+		snap_check(snap_vec[i], i);
+		util_snap_free(snap_vec[i]);
+	}
+	timer_report("util_snap_new_vec", count * SNAP_ATTRS);
+
+	for (i = 0; i < count; i++) {
+		for (a = 0; a < SNAP_ATTRS; a++) {
+			snprintf(path, sizeof(path), "%s/attr%d",
+				 path_vec[i], a);
+			unlink(path);
+		}
+		snprintf(path, sizeof(path), "%s/subsystem", path_vec[i]);
+		unlink(path);
+		snprintf(path, sizeof(path), "%s/power", path_vec[i]);
+		rmdir(path);
+		rmdir(path_vec[i]);
+		free(path_vec[i]);
+	}
+	rmdir(dir);
+	free(snap_vec);
+	free(path_vec);
+}
+
+/*
+ * Run all benchmarks with an optional number of entries
+ */
+int main(int argc, char *argv[])
+{
+	unsigned long count = DEFAULT_COUNT;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (!count) {
+		fprintf(stderr, "Usage: %s [COUNT]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	srand(1);
+	printf("%-28s %10s %12s\n", "Benchmark", "Count", "Time");
+	bench_list_sort("util_list_sort random", count, key_random);
+	bench_list_sort("util_list_sort sorted", count, key_sorted);
+	bench_list_sort("util_list_sort reverse", count, key_reverse);
+	bench_rec(count);
+	bench_scandir(count / 10 ? count / 10 : 1);
+	bench_snap(count / 100 ? count / 100 : 1);
+	return EXIT_SUCCESS;
+}
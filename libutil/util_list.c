@@ -213,41 +213,70 @@ unsigned long util_list_len(struct util_list *list)
 }
 
 /*
- * Sort table (bubble sort)
+ * Merge two sorted chains of nodes that are linked by their next pointers
+ *
+ * A node of chain "b" is only placed before a node of chain "a" if
+ * cmp_fn() returns a value greater than zero. Because "a" holds the
+ * earlier nodes, this keeps the sort stable.
+ */
+static struct util_list_node *list_merge(struct util_list *list,
+					 struct util_list_node *a,
+					 struct util_list_node *b,
+					 util_list_cmp_fn cmp_fn, void *data)
+{
+	struct util_list_node head, *tail = &head;
+
+	while (a && b) {
+		if (cmp_fn(n2e(list, a), n2e(list, b), data) > 0) {
+			tail->next = b;
+			b = b->next;
+		} else {
+			tail->next = a;
+			a = a->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = a ? a : b;
+	return head.next;
+}
+
+/*
+ * Sort list (stable bottom-up merge sort)
+ *
+ * part[i] holds a sorted chain of 2^i nodes or is empty. Each new node is
+ * merged with the chains from part[0] upwards like a carry in a binary
+ * counter, so that only chains of equal length are merged.
  */
 void util_list_sort(struct util_list *list, util_list_cmp_fn cmp_fn,
 		    void *data)
 {
-	struct util_list_node *node1, *node2;
-	unsigned long list_cnt, i, j;
-	void *entry1, *entry2;
+	struct util_list_node *part[64] = {};
+	struct util_list_node *node, *next, *chain, *prev;
+	unsigned int i;
 
-	list_cnt = util_list_len(list);
-
-	for (i = 1; i < list_cnt; i++) {
-		node1 = list->start;
-		for (j = 0; j < list_cnt - i; j++) {
-			node2 = node1->next;
-			entry1 = n2e(list, node1);
-			entry2 = n2e(list, node2);
-			if (cmp_fn(entry1, entry2, data) > 0) {
-				node1->next = node2->next;
-				if (node1->next)
-					node1->next->prev = node1;
-				else
-					list->end = node1;
-				node2->next = node1;
-				node2->prev = node1->prev;
-				if (node2->prev)
-					node2->prev->next = node2;
-				else
-					list->start = node2;
-				node1->prev = node2;
-			} else {
-				node1 = node2;
-			}
+	for (node = list->start; node; node = next) {
+		next = node->next;
+		node->next = NULL;
+		chain = node;
+		for (i = 0; part[i]; i++) {
+			chain = list_merge(list, part[i], chain, cmp_fn, data);
+			part[i] = NULL;
 		}
+		part[i] = chain;
+	}
+	chain = NULL;
+	for (i = 0; i < 64; i++) {
+		if (part[i])
+			chain = list_merge(list, part[i], chain, cmp_fn, data);
+	}
+	/* Restore prev pointers, start and end of the list */
+	list->start = chain;
+	prev = NULL;
+	for (node = chain; node; node = node->next) {
+		node->prev = prev;
+		prev = node;
 	}
+	list->end = prev;
 }
 
 /*
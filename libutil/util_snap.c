@@ -0,0 +1,476 @@
+/*
+ * util - Utility function library
+ *
+ * Read all attribute files of a directory in one pass
+ *
+ * Tools that query devices through sysfs typically read dozens of small
+ * attribute files per device. Instead of formatting a path name and doing
+ * fopen()/fgets()/fclose() for each of them, a snapshot opens the directory
+ * once, reads every regular file with openat() and pread() into a reusable
+ * buffer and keeps the contents for later lookups by name.
+ *
+ * Programs that use this interface have to be linked with -lpthread.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lib/util_base.h"
+#include "lib/util_libc.h"
+#include "lib/util_panic.h"
+#include "lib/util_snap.h"
+
+/* Initial buffer size, sysfs attributes do not exceed one page */
+#define SNAP_BUF_SIZE	4096
+
+/// @cond
+struct util_snap_attr {
+	char *name;
+	char *value;
+};
+
+struct util_snap {
+	char *path;
+	struct util_snap_attr *attr_vec;
+	int count;
+};
+
+struct snap_buf {
+	char *data;
+	size_t size;
+};
+
+struct snap_queue {
+	pthread_mutex_t mutex;
+	struct util_snap **snap_vec;
+	char * const *path_vec;
+	int count;
+	int next;
+	int failed;
+};
+/// @endcond
+
+/*
+ * Read the complete file into the buffer and terminate it with a null byte
+ */
+static ssize_t snap_read_fd(int fd, struct snap_buf *buf)
+{
+	size_t len = 0;
+	ssize_t rc;
+
+	while (1) {
+		if (len + 1 >= buf->size) {
+			buf->size *= 2;
+			buf->data = util_realloc(buf->data, buf->size);
+		}
+		rc = pread(fd, buf->data + len, buf->size - len - 1, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (rc == 0)
+			break;
+		len += rc;
+	}
+	buf->data[len] = 0;
+	return len;
+}
+
+/*
+ * Read one directory entry and add it to the snapshot
+ *
+ * Entries that are not regular files or that cannot be read, for example
+ * write-only attributes, are skipped.
+ */
+static void snap_add_entry(struct util_snap *snap, int *size, int dfd,
+			   struct dirent *de, struct snap_buf *buf)
+{
+	struct util_snap_attr *attr;
+	struct stat sb;
+	ssize_t len;
+	int fd;
+
+	if (de->d_type != DT_REG && de->d_type != DT_UNKNOWN)
+		return;
+	fd = openat(dfd, de->d_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	if (de->d_type == DT_UNKNOWN &&
+	    (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)))
+		goto out_close;
+	len = snap_read_fd(fd, buf);
+	if (len < 0)
+		goto out_close;
+	/* Remove the trailing newline */
+	if (len > 0 && buf->data[len - 1] == '\n')
+		buf->data[len - 1] = 0;
+	if (snap->count == *size) {
+		*size = *size ? *size * 2 : 32;
+		snap->attr_vec = util_realloc(snap->attr_vec,
+					      *size * sizeof(*attr));
+	}
+	attr = &snap->attr_vec[snap->count++];
+	attr->name = util_strdup(de->d_name);
+	attr->value = util_strdup(buf->data);
+out_close:
+	close(fd);
+}
+
+static int snap_attr_cmp(const void *a, const void *b)
+{
+	const struct util_snap_attr *attr1 = a, *attr2 = b;
+
+	return strcmp(attr1->name, attr2->name);
+}
+
+/*
+ * Create a snapshot of directory "path" using the read buffer "buf"
+ */
+static struct util_snap *snap_new(const char *path, struct snap_buf *buf)
+{
+	struct util_snap *snap;
+	struct dirent *de;
+	int dfd, size = 0;
+	DIR *dirp;
+
+	dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0)
+		return NULL;
+	dirp = fdopendir(dfd);
+	if (!dirp) {
+		close(dfd);
+		return NULL;
+	}
+	snap = util_zalloc(sizeof(*snap));
+	snap->path = util_strdup(path);
+	while ((de = readdir(dirp)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 ||
+		    strcmp(de->d_name, "..") == 0)
+			continue;
+		snap_add_entry(snap, &size, dfd, de, buf);
+	}
+	closedir(dirp);
+	qsort(snap->attr_vec, snap->count, sizeof(*snap->attr_vec),
+	      snap_attr_cmp);
+	return snap;
+}
+
+/**
+ * Create a snapshot of all attribute files in a directory
+ *
+ * Every readable regular file in the directory is read completely. Files
+ * that cannot be read as well as subdirectories and symbolic links are
+ * not part of the snapshot.
+ *
+ * @param[in] fmt   Format string for generation of the directory path
+ * @param[in] ...   Parameters for format string
+ *
+ * @returns   Pointer to snapshot or NULL with errno set, if the directory
+ *            could not be opened
+ */
+struct util_snap *util_snap_new(const char *fmt, ...)
+{
+	struct util_snap *snap;
+	char path[PATH_MAX];
+	struct snap_buf buf;
+	va_list ap;
+
+	UTIL_VSPRINTF(path, fmt, ap);
+	buf.size = SNAP_BUF_SIZE;
+	buf.data = util_malloc(buf.size);
+	snap = snap_new(path, &buf);
+	free(buf.data);
+	return snap;
+}
+
+/*
+ * Create snapshots for directories from the queue until it is empty
+ */
+static void *snap_thread(void *data)
+{
+	struct snap_queue *queue = data;
+	struct snap_buf buf;
+	int i;
+
+	buf.size = SNAP_BUF_SIZE;
+	buf.data = util_malloc(buf.size);
+	while (1) {
+		pthread_mutex_lock(&queue->mutex);
+		i = queue->next++;
+		pthread_mutex_unlock(&queue->mutex);
+		if (i >= queue->count)
+			break;
+		queue->snap_vec[i] = snap_new(queue->path_vec[i], &buf);
+		if (!queue->snap_vec[i]) {
+			pthread_mutex_lock(&queue->mutex);
+			queue->failed = 1;
+			pthread_mutex_unlock(&queue->mutex);
+		}
+	}
+	free(buf.data);
+	return NULL;
+}
+
+/**
+ * Create snapshots for multiple directories
+ *
+ * The directories are read by up to "threads" threads in parallel. If a
+ * directory cannot be opened, the corresponding entry of "snap_vec" is
+ * set to NULL.
+ *
+ * @param[out] snap_vec   Array for "count" snapshot pointers
+ * @param[in]  path_vec   Array with "count" directory paths
+ * @param[in]  count      Number of directories
+ * @param[in]  threads    Maximum number of threads, 0 or 1 for no threads
+ *
+ * @retval     0          All snapshots were created
+ * @retval    -1          At least one directory could not be opened
+ */
+int util_snap_new_vec(struct util_snap **snap_vec, char * const *path_vec,
+		      int count, int threads)
+{
+	struct snap_queue queue;
+	pthread_t *tid_vec;
+	int i, started;
+
+	memset(&queue, 0, sizeof(queue));
+	pthread_mutex_init(&queue.mutex, NULL);
+	queue.snap_vec = snap_vec;
+	queue.path_vec = path_vec;
+	queue.count = count;
+
+	if (threads > count)
+		threads = count;
+	tid_vec = util_zalloc(sizeof(*tid_vec) * (threads > 1 ? threads : 1));
+	/* The calling thread is one of the "threads" workers */
+	for (started = 0; started < threads - 1; started++) {
+		if (pthread_create(&tid_vec[started], NULL, snap_thread,
+				   &queue))
+			break;
+	}
+	snap_thread(&queue);
+	for (i = 0; i < started; i++)
+		pthread_join(tid_vec[i], NULL);
+	free(tid_vec);
+	pthread_mutex_destroy(&queue.mutex);
+	return queue.failed ? -1 : 0;
+}
+
+/**
+ * Free a snapshot
+ *
+ * @param[in] snap  Snapshot to be freed, may be NULL
+ */
+void util_snap_free(struct util_snap *snap)
+{
+	int i;
+
+	if (!snap)
+		return;
+	for (i = 0; i < snap->count; i++) {
+		free(snap->attr_vec[i].name);
+		free(snap->attr_vec[i].value);
+	}
+	free(snap->attr_vec);
+	free(snap->path);
+	free(snap);
+}
+
+/**
+ * Return the directory path of a snapshot
+ *
+ * @param[in] snap  Snapshot
+ *
+ * @returns   Path of the directory
+ */
+const char *util_snap_path(struct util_snap *snap)
+{
+	return snap->path;
+}
+
+/**
+ * Return the number of attributes in a snapshot
+ *
+ * @param[in] snap  Snapshot
+ *
+ * @returns   Number of attributes
+ */
+int util_snap_count(struct util_snap *snap)
+{
+	return snap->count;
+}
+
+/**
+ * Return the contents of an attribute file without the trailing newline
+ *
+ * @param[in] snap  Snapshot
+ * @param[in] name  Name of the attribute file
+ *
+ * @returns   Pointer to attribute contents or NULL, if the attribute is
+ *            not part of the snapshot
+ */
+const char *util_snap_get(struct util_snap *snap, const char *name)
+{
+	struct util_snap_attr key, *attr;
+
+	key.name = (char *) name;
+	attr = bsearch(&key, snap->attr_vec, snap->count,
+		       sizeof(*snap->attr_vec), snap_attr_cmp);
+	return attr ? attr->value : NULL;
+}
+
+/**
+ * Read the first line of an attribute
+ *
+ * This is the snapshot counterpart of util_file_read_line(). If the
+ * attribute is not found or empty, an empty string is returned for 'str'.
+ *
+ * @param[in]  snap   Snapshot
+ * @param[out] str    Result buffer
+ * @param[in]  size   Size of the result buffer
+ * @param[in]  name   Name of the attribute file
+ *
+ * @retval     0      Attribute was read
+ * @retval    -1      Attribute not found or empty
+ */
+int util_snap_read_line(struct util_snap *snap, char *str, size_t size,
+			const char *name)
+{
+	const char *value;
+	size_t len;
+
+	str[0] = 0;
+	value = util_snap_get(snap, name);
+	if (!value)
+		return -1;
+	len = strcspn(value, "\n");
+	if (len >= size)
+		len = size - 1;
+	memcpy(str, value, len);
+	str[len] = 0;
+	return len ? 0 : -1;
+}
+
+/**
+ * Convert an attribute to signed int according to given base
+ *
+ * @param[in]  snap     Snapshot
+ * @param[out] val      Buffer for value
+ * @param[in]  base     Base for conversion, either 8, 10, or 16
+ * @param[in]  name     Name of the attribute file
+ *
+ * @retval     0        Integer has been read correctly
+ * @retval    -1        Attribute not found or invalid
+ */
+int util_snap_read_i(struct util_snap *snap, int *val, int base,
+		     const char *name)
+{
+	const char *value;
+	int count;
+
+	value = util_snap_get(snap, name);
+	if (!value)
+		return -1;
+	switch (base) {
+	case 8:
+		count = sscanf(value, "%o", (unsigned int *) val);
+		break;
+	case 10:
+		count = sscanf(value, "%d", val);
+		break;
+	case 16:
+		count = sscanf(value, "%x", (unsigned int *) val);
+		break;
+	default:
+		util_panic("Invalid base: %d\n", base);
+	}
+	return (count == 1) ? 0 : -1;
+}
+
+/**
+ * Convert an attribute to unsigned long according to given base
+ *
+ * @param[in]  snap     Snapshot
+ * @param[out] val      Buffer for value
+ * @param[in]  base     Base for conversion, either 8, 10, or 16
+ * @param[in]  name     Name of the attribute file
+ *
+ * @retval     0        Long integer has been read correctly
+ * @retval    -1        Attribute not found or invalid
+ */
+int util_snap_read_ul(struct util_snap *snap, unsigned long *val, int base,
+		      const char *name)
+{
+	const char *value;
+	int count;
+
+	value = util_snap_get(snap, name);
+	if (!value)
+		return -1;
+	switch (base) {
+	case 8:
+		count = sscanf(value, "%lo", val);
+		break;
+	case 10:
+		count = sscanf(value, "%lu", val);
+		break;
+	case 16:
+		count = sscanf(value, "%lx", val);
+		break;
+	default:
+		util_panic("Invalid base: %d\n", base);
+	}
+	return (count == 1) ? 0 : -1;
+}
+
+/**
+ * Convert an attribute to unsigned long long according to given base
+ *
+ * @param[in]  snap     Snapshot
+ * @param[out] val      Buffer for value
+ * @param[in]  base     Base for conversion, either 8, 10, or 16
+ * @param[in]  name     Name of the attribute file
+ *
+ * @retval     0        Long integer has been read correctly
+ * @retval    -1        Attribute not found or invalid
+ */
+int util_snap_read_ull(struct util_snap *snap, unsigned long long *val,
+		       int base, const char *name)
+{
+	const char *value;
+	int count;
+
+	value = util_snap_get(snap, name);
+	if (!value)
+		return -1;
+	switch (base) {
+	case 8:
+		count = sscanf(value, "%llo", val);
+		break;
+	case 10:
+		count = sscanf(value, "%llu", val);
+		break;
+	case 16:
+		count = sscanf(value, "%llx", val);
+		break;
+	default:
+		util_panic("Invalid base: %d\n", base);
+	}
+	return (count == 1) ? 0 : -1;
+}
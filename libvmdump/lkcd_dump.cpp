@@ -64,18 +64,166 @@ int LKCDDump::compressGZIP(const char *old, uint32_t old_size, char *n,
 	return rc;
 }
 
+/*
+ * Batch of pages that is compressed by one worker thread
+ */
+struct LKCDDump::_page_batch {
+	uint64_t	addr;		/* Address of first page */
+	unsigned int	pages;		/* Number of pages in batch */
+	char		*in;		/* Uncompressed page data */
+	char		*out;		/* Page records ready for writing */
+	size_t		out_size;	/* Size of page records */
+	bool		done;		/* Compression is complete */
+};
+
+/*
+ * Shared state of writer and compression threads
+ */
+struct LKCDDump::_compress_ctx {
+	LKCDDump		*dump;
+	struct _page_batch	batch[BATCH_CNT_MAX];
+	unsigned int		batch_cnt;	/* Number of used batches */
+	uint64_t		filled;		/* Batches filled by writer */
+	uint64_t		next;		/* Next batch to compress */
+	bool			stop;		/* Terminate threads */
+	bool			failed;		/* Compression failed */
+	DumpException		error;		/* Compression error */
+	char			zero_page[DUMP_PAGE_SIZE];
+	char			zero_data[DUMP_PAGE_SIZE];
+	uint32_t		zero_size;	/* Size of compressed zero page */
+	uint32_t		zero_flags;	/* Flags of compressed zero page */
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond_work;	/* Batch filled or stop */
+	pthread_cond_t		cond_done;	/* Batch compressed */
+};
+
+/*
+ * Compress all pages of a batch into page records
+ *
+ * Zero pages are not compressed again but use the record data that has
+ * been computed once for the first zero page.
+ */
+void LKCDDump::compressBatch(struct _compress_ctx *ctx,
+			     struct _page_batch *batch)
+{
+	struct _dump_page dp;
+	char *page, *out;
+	unsigned int i;
+	int size;
+
+	out = batch->out;
+	for (i = 0; i < batch->pages; i++) {
+		page = batch->in + i * DUMP_PAGE_SIZE;
+		dp.address = batch->addr + i * DUMP_PAGE_SIZE;
+		if (memcmp(page, ctx->zero_page, DUMP_PAGE_SIZE) == 0) {
+			dp.size  = ctx->zero_size;
+			dp.flags = ctx->zero_flags;
+			memcpy(out + sizeof(dp), ctx->zero_data, dp.size);
+		} else {
+			size = compressGZIP(page, DUMP_PAGE_SIZE,
+					    out + sizeof(dp), DUMP_PAGE_SIZE);
+			/*
+			 * If compression failed or compressed was ineffective,
+			 * we write an uncompressed page
+			 */
+			if (size == GZIP_NOT_COMPRESSED) {
+				dp.flags = DUMP_DH_RAW;
+				dp.size  = DUMP_PAGE_SIZE;
+				memcpy(out + sizeof(dp), page, DUMP_PAGE_SIZE);
+			} else {
+				dp.flags = DUMP_DH_COMPRESSED;
+				dp.size  = size;
+			}
+		}
+		memcpy(out, &dp, sizeof(dp));
+		out += sizeof(dp) + dp.size;
+	}
+	batch->out_size = out - batch->out;
+}
+
+/*
+ * Compression thread: Compress filled batches in order of their creation
+ */
+void *LKCDDump::compressThread(void *data)
+{
+	struct _compress_ctx *ctx = (struct _compress_ctx *) data;
+	struct _page_batch *batch;
+
+	pthread_mutex_lock(&ctx->lock);
+	while (1) {
+		while (!ctx->stop && ctx->next == ctx->filled)
+			pthread_cond_wait(&ctx->cond_work, &ctx->lock);
+		if (ctx->stop)
+			break;
+		batch = &ctx->batch[ctx->next % ctx->batch_cnt];
+		ctx->next++;
+		pthread_mutex_unlock(&ctx->lock);
+
+		try {
+			ctx->dump->compressBatch(ctx, batch);
+		} catch (DumpException &ex) {
+			pthread_mutex_lock(&ctx->lock);
+			if (!ctx->failed)
+				ctx->error = ex;
+			ctx->failed = true;
+			pthread_cond_broadcast(&ctx->cond_done);
+			break;
+		}
+
+		pthread_mutex_lock(&ctx->lock);
+		batch->done = true;
+		pthread_cond_broadcast(&ctx->cond_done);
+	}
+	pthread_mutex_unlock(&ctx->lock);
+	return NULL;
+}
+
+/*
+ * Stop all compression threads and release the compression context
+ */
+void LKCDDump::finishThreads(struct _compress_ctx *ctx, pthread_t *threads,
+			     int cnt)
+{
+	unsigned int i;
+	int j;
+
+	pthread_mutex_lock(&ctx->lock);
+	ctx->stop = true;
+	pthread_cond_broadcast(&ctx->cond_work);
+	pthread_mutex_unlock(&ctx->lock);
+	for (j = 0; j < cnt; j++)
+		pthread_join(threads[j], NULL);
+
+	pthread_cond_destroy(&ctx->cond_done);
+	pthread_cond_destroy(&ctx->cond_work);
+	pthread_mutex_destroy(&ctx->lock);
+	for (i = 0; i < ctx->batch_cnt; i++) {
+		delete[] ctx->batch[i].in;
+		delete[] ctx->batch[i].out;
+	}
+	delete ctx;
+}
+
+/*
+ * Write dump in LKCD format
+ *
+ * The writer (this thread) reads the memory in batches of pages and passes
+ * them to compression threads. Compressed batches are written in order with
+ * one write() system call per batch.
+ */
 void LKCDDump::writeDump(const char* fileName)
 {
 	char dump_header_buf[DUMP_HEADER_SIZE] = {};
-	char dump_page_buf[DUMP_BUFFER_SIZE];
-	char dpcpage[DUMP_PAGE_SIZE];
-	uint32_t dp_size,dp_flags;
+	struct _compress_ctx *ctx;
+	struct _page_batch *batch;
+	pthread_t threads[THREADS_MAX];
 	ProgressBar progressBar;
-	char buf[DUMP_PAGE_SIZE];
+	uint64_t batch_total, written, mem_loc = 0;
 	struct _dump_page dp;
-	uint64_t mem_loc = 0;
-	ssize_t buf_loc = 0;
-	int size, fd;
+	unsigned int i;
+	int thread_cnt = 0;
+	long cpus;
+	int fd;
 
 	if (fileName == NULL) {
 		fd = STDOUT_FILENO;
@@ -99,59 +247,94 @@ void LKCDDump::writeDump(const char* fileName)
 		throw(DumpErrnoException("write failed"));
 	}
 
+	/* set up compression threads */
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1)
+		cpus = 1;
+	if (cpus > THREADS_MAX)
+		cpus = THREADS_MAX;
+
+	ctx = new struct _compress_ctx();
+	ctx->dump = this;
+	ctx->batch_cnt = MIN((unsigned int) cpus * 2, BATCH_CNT_MAX);
+	for (i = 0; i < ctx->batch_cnt; i++) {
+		ctx->batch[i].in = new char[BATCH_PAGES * DUMP_PAGE_SIZE];
+		ctx->batch[i].out = new char[BATCH_PAGES *
+				(sizeof(struct _dump_page) + DUMP_PAGE_SIZE)];
+	}
+	ctx->zero_size = compressGZIP(ctx->zero_page, DUMP_PAGE_SIZE,
+				      ctx->zero_data, DUMP_PAGE_SIZE);
+	if (ctx->zero_size == (uint32_t) GZIP_NOT_COMPRESSED) {
+		ctx->zero_flags = DUMP_DH_RAW;
+		ctx->zero_size = DUMP_PAGE_SIZE;
+	} else {
+		ctx->zero_flags = DUMP_DH_COMPRESSED;
+	}
+	pthread_mutex_init(&ctx->lock, NULL);
+	pthread_cond_init(&ctx->cond_work, NULL);
+	pthread_cond_init(&ctx->cond_done, NULL);
+
 	/* write memory */
 
-	referenceDump->seekMem(0);
-
-	while (mem_loc < dumpHeader.memory_size) {
-		referenceDump->readMem(buf, DUMP_PAGE_SIZE);
-		copyRegsToPage(mem_loc,buf);
-
-		memset(dpcpage, 0, DUMP_PAGE_SIZE);
-		/*
-		 * Get the new compressed page size
-		 */
-		size = compressGZIP((char *)buf, DUMP_PAGE_SIZE,
-				    (char *)dpcpage, DUMP_PAGE_SIZE);
-
-		/*
-		 * If compression failed or compressed was ineffective,
-		 * we write an uncompressed page
-		 */
-		if (size == GZIP_NOT_COMPRESSED) {
-			dp_flags = DUMP_DH_RAW;
-			dp_size  = DUMP_PAGE_SIZE;
-		} else {
-			dp_flags = DUMP_DH_COMPRESSED;
-			dp_size  = size;
-		}
-		dp.address = mem_loc;
-		dp.size    = dp_size;
-		dp.flags   = dp_flags;
-		memcpy((void *)(dump_page_buf + buf_loc),
-				(const void *)&dp, sizeof(dp));
-		buf_loc += sizeof(dp);
-		/*
-		 * Copy the page of memory
-		 */
-		if (dp_flags & DUMP_DH_COMPRESSED) {
-			/* Copy the compressed page */
-			memcpy((void *)(dump_page_buf + buf_loc),
-					(const void *)dpcpage, dp_size);
-		} else {
-			/* Copy directly from memory */
-			memcpy((void *)(dump_page_buf + buf_loc),
-					(const void *)buf, dp_size);
+	batch_total = (dumpHeader.memory_size + BATCH_SIZE - 1) / BATCH_SIZE;
+	try {
+		for (thread_cnt = 0; thread_cnt < cpus; thread_cnt++) {
+			if (pthread_create(&threads[thread_cnt], NULL,
+					   compressThread, ctx))
+				break;
 		}
-		buf_loc += dp_size;
-		if(write(fd, dump_page_buf, buf_loc) != buf_loc){
-			throw(DumpErrnoException("write failed"));
+		if (thread_cnt == 0)
+			throw(DumpException("Could not create threads"));
+
+		referenceDump->seekMem(0);
+
+		for (written = 0; written < batch_total; written++) {
+			/* Fill all free batches */
+			while (ctx->filled < batch_total &&
+			       ctx->filled - written < ctx->batch_cnt) {
+				batch = &ctx->batch[ctx->filled %
+						    ctx->batch_cnt];
+				batch->addr = mem_loc;
+				batch->pages = (MIN(dumpHeader.memory_size -
+						    mem_loc, BATCH_SIZE) +
+						DUMP_PAGE_SIZE - 1) /
+					       DUMP_PAGE_SIZE;
+				batch->done = false;
+				referenceDump->readMem(batch->in, batch->pages *
+						       DUMP_PAGE_SIZE);
+				for (i = 0; i < batch->pages; i++) {
+					copyRegsToPage(mem_loc, batch->in +
+						       i * DUMP_PAGE_SIZE);
+					mem_loc += DUMP_PAGE_SIZE;
+				}
+				pthread_mutex_lock(&ctx->lock);
+				ctx->filled++;
+				pthread_cond_signal(&ctx->cond_work);
+				pthread_mutex_unlock(&ctx->lock);
+			}
+
+			/* Write next batch in order */
+			batch = &ctx->batch[written % ctx->batch_cnt];
+			pthread_mutex_lock(&ctx->lock);
+			while (!batch->done && !ctx->failed)
+				pthread_cond_wait(&ctx->cond_done, &ctx->lock);
+			pthread_mutex_unlock(&ctx->lock);
+			if (ctx->failed)
+				throw(ctx->error);
+			if (write(fd, batch->out, batch->out_size) !=
+			    (ssize_t) batch->out_size)
+				throw(DumpErrnoException("write failed"));
+			progressBar.displayProgress(
+				(batch->addr + batch->pages * DUMP_PAGE_SIZE) /
+				(1024 * 1024),
+				dumpHeader.memory_size / (1024 * 1024));
 		}
-		buf_loc = 0;
-		mem_loc += DUMP_PAGE_SIZE;
-		progressBar.displayProgress(mem_loc/(1024*1024),
-				dumpHeader.memory_size/(1024*1024));
+	} catch (...) {
+		finishThreads(ctx, threads, thread_cnt);
+		throw;
 	}
+	finishThreads(ctx, threads, thread_cnt);
 
 	/*
 	 * Write end marker
@@ -12,13 +12,14 @@
 #ifndef LKCD_DUMP_H
 #define LKCD_DUMP_H
 
+#include <pthread.h>
+
 #include "lib/zt_common.h"
 
 #include "dump.h"
 #include "register_content.h"
 
 #define UTS_LEN 65
-#define DUMP_BUFFER_SIZE     0x2000  /* Size of dump buffer */
 
 /* Standard header definitions */
 #define DUMP_HEADER_SIZE    0x10000
@@ -44,6 +45,12 @@
 
 #define GZIP_NOT_COMPRESSED -1
 
+/* Parallel compression */
+#define BATCH_PAGES         512U     /* Pages per compression batch */
+#define BATCH_SIZE          (BATCH_PAGES * DUMP_PAGE_SIZE)
+#define BATCH_CNT_MAX       64U      /* Maximum number of batches */
+#define THREADS_MAX         32       /* Maximum compression threads */
+
 class LKCDDump : public Dump
 {
 public:
@@ -123,8 +130,16 @@ protected:
 	struct _lkcd_dump_header_asm dumpHeaderAsm;
 
 private:
+	struct _page_batch;
+	struct _compress_ctx;
+
 	int compressGZIP(const char *old, uint32_t old_size, char *n,
 			uint32_t new_size);
+	void compressBatch(struct _compress_ctx *ctx,
+			   struct _page_batch *batch);
+	static void *compressThread(void *data);
+	static void finishThreads(struct _compress_ctx *ctx,
+				  pthread_t *threads, int cnt);
 	Dump *referenceDump;
 };
 
@@ -90,6 +90,11 @@ VMDump::VMDump(const char *fileName) : Dump(fileName, "rb")
 {
 	uint8_t fmbk_id[8] = {0xc8, 0xc3, 0xd7, 0xc4, 0xc6, 0xd4, 0xc2, 0xd2};
 
+	bitmap = NULL;
+	pageOffset = 0;
+	rankTable = NULL;
+	memPosValid = false;
+
 	ebcdicAsciiConv = iconv_open("ISO-8859-1", "EBCDIC-US");
 
 	/* Record 1: adsrRecord */
@@ -190,39 +195,121 @@ void VMDump::printInfo(void)
 	fprintf(stderr, "  date........: %s",ctime(&time.tv_sec));
 }
 
+/*
+ * Return the number of dumped pages before page
+ *
+ * Dumped pages are stored consecutively in the dump file, so the rank of a
+ * page determines its file offset. The rank table is built on first use and
+ * stores the rank of the first page of each block of RANK_BLOCK_PAGES pages.
+ */
+uint64_t VMDump::pageRank(uint64_t page)
+{
+	uint64_t i, blk, blk_cnt, rank;
+
+	if (!rankTable) {
+		blk_cnt = (getMemSize() / 0x1000 + RANK_BLOCK_PAGES - 1) /
+			RANK_BLOCK_PAGES;
+		rankTable = new uint64_t[blk_cnt + 1];
+		rank = 0;
+		for (blk = 0; blk < blk_cnt; blk++) {
+			rankTable[blk] = rank;
+			for (i = blk * RANK_BLOCK_PAGES / 8;
+			     i < (blk + 1) * RANK_BLOCK_PAGES / 8 &&
+			     i < getMemSize() / (0x1000 * 8); i++)
+				rank += __builtin_popcount(
+					(unsigned char) bitmap[i]);
+		}
+		rankTable[blk_cnt] = rank;
+	}
+	blk = page / RANK_BLOCK_PAGES;
+	rank = rankTable[blk];
+	for (i = blk * RANK_BLOCK_PAGES; i < page; i++) {
+		if (i % 8 == 0 && i + 8 <= page) {
+			rank += __builtin_popcount(
+				(unsigned char) bitmap[i / 8]);
+			i += 7;
+		} else if (testPage(i)) {
+			rank++;
+		}
+	}
+	return rank;
+}
+
+/*
+ * Return the number of consecutive pages starting at page (at most count)
+ * that are all dumped (present != 0) or all not dumped (present == 0)
+ */
+uint64_t VMDump::pageRun(uint64_t page, uint64_t count, int present) const
+{
+	unsigned char all = present ? 0xff : 0x00;
+	uint64_t i = page;
+
+	while (i < page + count) {
+		/* Skip full bitmap bytes at once */
+		if (i % 8 == 0 && i + 8 <= page + count &&
+		    (unsigned char) bitmap[i / 8] == all) {
+			i += 8;
+			continue;
+		}
+		if (!testPage(i) != !present)
+			break;
+		i++;
+	}
+	return i - page;
+}
+
+/*
+ * Set memory read position to a page aligned offset
+ */
 int VMDump::seekMem(uint64_t offset)
 {
-	if (offset != 0) {
+	if (offset % 0x1000 != 0 || offset > getMemSize())
 		return -1;
-	}
-	pageOffset = 0;
+	pageOffset = offset / 0x1000;
+	memPosValid = false;
 	return 0;
 }
 
+/*
+ * Read memory at the current read position
+ *
+ * Runs of dumped pages are read with one read request, runs of pages that
+ * are not contained in the dump are filled with zeros.
+ */
 void VMDump::readMem(char* buf, int size)
 {
-	int i;
-
-	if (pageOffset == 0)
-		dump_seek(fh, memoryStartRecord, SEEK_SET);
+	uint64_t i, run, pages;
 
 	if (size % 0x1000 != 0) {
 		throw(DumpException("internal error: VMDump::readMem() " \
 		"can only handle sizes which are multiples of page size"));
 	}
+	pages = size / 0x1000;
+	if (pageOffset + pages > getMemSize() / 0x1000)
+		throw(DumpException("internal error: VMDump::readMem() " \
+		"read beyond end of memory"));
+
+	if (!memPosValid) {
+		dump_seek(fh, memoryStartRecord + pageRank(pageOffset) * 0x1000,
+			  SEEK_SET);
+		memPosValid = true;
+	}
 
-	for(i = 0; i < size; i += 0x1000) {
-		if(testPage(pageOffset)) {
-			dump_read(buf + i, 0x1000, 1, fh);
+	for (i = 0; i < pages; i += run) {
+		if (testPage(pageOffset + i)) {
+			run = pageRun(pageOffset + i, pages - i, 1);
+			dump_read(buf + i * 0x1000, run * 0x1000, 1, fh);
 		} else {
-			memset(buf + i, 0, 0x1000);
+			run = pageRun(pageOffset + i, pages - i, 0);
+			memset(buf + i * 0x1000, 0, run * 0x1000);
 		}
-		pageOffset += 1;
 	}
+	pageOffset += pages;
 }
 
 VMDump::~VMDump(void)
 {
+	delete[] rankTable;
 }
 
 /*****************************************************************************/
@@ -84,6 +84,9 @@ public:
 		bitmap[bit/8] |= (1 << (7-(bit % 8)));
 	}
 protected:
+	/* Pages per entry of the page rank table */
+	static const uint64_t RANK_BLOCK_PAGES = 0x1000;
+
 	/* Types */
 	struct _adsr {
 		/* Section 1*/
@@ -140,6 +143,9 @@ protected:
 	} __packed;
 
 	/* Methods */
+	uint64_t pageRank(uint64_t page);
+	uint64_t pageRun(uint64_t page, uint64_t count, int present) const;
+
 	inline void ebcAsc(char *in, char *out, size_t size) const
 	{
 		size_t size_out = size;
@@ -158,6 +164,8 @@ protected:
 	uint64_t memoryStartRecord;
 	char   *bitmap;
 	uint64_t pageOffset;
+	uint64_t *rankTable;	/* Dumped pages before each rank block */
+	bool memPosValid;	/* File position matches pageOffset */
 private:
 	iconv_t ebcdicAsciiConv;
 };
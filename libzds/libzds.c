@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <linux/types.h>
 #include <malloc.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -219,6 +220,136 @@ struct seekelement {
  */
 #define TRACK_BUFFER_DEFAULT 128
 
+/**
+ * @brief Location of one track frame within the data set
+ */
+struct trackframe {
+	/** @brief Index number of the data set part */
+	int dsp_no;
+	/** @brief Sequence number of the extent in the data set part */
+	int ext_seq_no;
+	/** @brief First and last track of the extent */
+	unsigned int extstarttrk;
+	unsigned int extendtrk;
+	/** @brief First and last track of the frame */
+	unsigned int bufstarttrk;
+	unsigned int bufendtrk;
+};
+
+/** @brief No read-ahead request is pending */
+#define RA_IDLE   0
+/** @brief The helper thread has a request to read a track frame */
+#define RA_QUEUED 1
+/** @brief The requested track frame has been read */
+#define RA_DONE   2
+
+/**
+ * @brief Internal structure for reading the next track frame in a helper
+ * thread while the current one is interpreted.
+ */
+struct readahead {
+	/** @brief The helper thread */
+	pthread_t thread;
+	/** @brief Protects state and stop, signaled on every change */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/** @brief Target buffer, swapped with the rawbuffer of the dshandle */
+	char *buffer;
+	/** @brief Track cache of the dshandle, may be NULL */
+	struct trackcache *cache;
+	/** @brief The dasdhandle and tracks of the requested frame */
+	struct dasdhandle *dasdh;
+	int dsp_no;
+	unsigned int starttrk;
+	unsigned int endtrk;
+	/** @brief Return code of the last read */
+	int rc;
+	/** @brief One of RA_IDLE, RA_QUEUED and RA_DONE */
+	int state;
+	/** @brief Set to terminate the helper thread */
+	int stop;
+};
+
+/**
+ * @brief Maximum number of PDS directory tracks that are read at once
+ */
+#define PDS_DIR_BATCH_MAX 16
+
+/**
+ * @brief Default number of threads that scan devices in parallel
+ */
+#define SCAN_THREADS_DEFAULT 16
+
+/**
+ * @brief Internal structure with the data sets found on one dasd by
+ * a parallel device scan, before they are merged into the zdsroot.
+ */
+struct dasdscan {
+	/** @brief The dasd that is scanned */
+	struct dasd *dasd;
+	/** @brief Array of data sets in the order of the VTOC */
+	struct dataset *ds;
+	unsigned int dscount;
+	unsigned int dssize;
+	/** @brief Return code of the scan */
+	int rc;
+};
+
+/**
+ * @brief Internal structure that hands out dasds to the scan threads
+ */
+struct scanqueue {
+	pthread_mutex_t mutex;
+	struct dasdscan *scan;
+	unsigned int count;
+	/** @brief Index of the next dasd that is to be scanned */
+	unsigned int next;
+};
+
+/**
+ * @brief One raw track in a struct trackcache
+ */
+struct trackcache_entry {
+	/** @brief List head for the LRU list of the cache */
+	struct util_list_node lru;
+	/** @brief Next entry in the same hash bucket */
+	struct trackcache_entry *next;
+	/** @brief The key: track number on a dasd */
+	struct dasd *dasd;
+	unsigned int track;
+	/** @brief RAWTRACKSIZE bytes of track data */
+	char *data;
+};
+
+/**
+ * @brief A data set with open dshandles that use a struct trackcache
+ */
+struct trackcache_user {
+	struct dataset *ds;
+	/** @brief Number of open dshandles of the data set */
+	unsigned int count;
+};
+
+struct trackcache {
+	/** @brief Protects all other members */
+	pthread_mutex_t mutex;
+	/** @brief Hash table of entries, keyed by dasd and track */
+	struct trackcache_entry **hash;
+	unsigned int hashsize;
+	/** @brief All entries, most recently used first */
+	struct util_list *lru;
+	/** @brief Current and maximum number of entries */
+	unsigned long long count;
+	unsigned long long max;
+	/** @brief Statistics: number of tracks found and not found */
+	unsigned long long hits;
+	unsigned long long misses;
+	/** @brief Data sets that are currently open */
+	struct trackcache_user *users;
+	unsigned int nusers;
+	unsigned int usersize;
+};
+
 struct dshandle {
 	/** @brief Data set this context relates to */
 	struct dataset *ds;
@@ -238,6 +369,12 @@ struct dshandle {
 	/** @brief Flag: While interpreting the data, keep the record
 	 *  descriptor words in the data stream */
 	int keepRDW;
+	/** @brief Flag: Read the next track frame in advance */
+	int readahead;
+	/** @brief Read-ahead context, only present while the handle is open */
+	struct readahead *ra;
+	/** @brief Shared track cache, may be NULL */
+	struct trackcache *cache;
 	/** @brief Flag that is set between open and close */
 	int is_open;
 	/** @brief This flag is set when during interpretation of the track
@@ -318,6 +455,7 @@ struct dshandle {
 
 static void dasd_free(struct dasd *dasd);
 static void dataset_free_memberlist(struct dataset *ds);
+static void dshandle_readahead_free(struct dshandle *dsh);
 static void errorlog_free(struct errorlog *log);
 static void errorlog_clear(struct errorlog *log);
 static int errorlog_add_message(struct errorlog **log,
@@ -2124,7 +2262,8 @@ static int extract_members_from_track(char *trackdata, struct dataset *ds,
 static int dataset_member_analysis(struct dataset *ds)
 {
 	char *trackdata;
-	unsigned int extstarttrk, extendtrk, currenttrack;
+	unsigned int extstarttrk, extendtrk, currenttrack, endtrack;
+	unsigned int batch, i;
 	int j;
 	int dirend;
 	struct datasetpart *dsp;
@@ -2151,7 +2290,7 @@ static int dataset_member_analysis(struct dataset *ds)
 	ds->memberlist = util_list_new(struct pdsmember, list);
 
 	/* track buffer must be page aligned for O_DIRECT */
-	trackdata = memalign(4096, RAWTRACKSIZE);
+	trackdata = memalign(4096, PDS_DIR_BATCH_MAX * RAWTRACKSIZE);
 	if (!trackdata)
 		return ENOMEM;
 
@@ -2166,6 +2305,10 @@ static int dataset_member_analysis(struct dataset *ds)
 		goto out2;
 	}
 	dirend = 0;
+	/* Most directories fit on a single track, so we start with reading
+	 * one track and double the number of tracks per read for larger ones.
+	 */
+	batch = 1;
 	/* loop over all extents in dataset*/
 	for (j = 0; j < MAXEXTENTS; ++j) {
 		if (!extent_contains_userdata(&dsp->ext[j]))
@@ -2175,26 +2318,34 @@ static int dataset_member_analysis(struct dataset *ds)
 		currenttrack = extstarttrk;
 		/* loop over tracks in extent */
 		while (currenttrack <= extendtrk) {
+			endtrack = MIN(extendtrk, currenttrack + batch - 1);
 			rc = lzds_dasdhandle_read_tracks_to_buffer(
-				dasdh, currenttrack, currenttrack, trackdata);
+				dasdh, currenttrack, endtrack, trackdata);
 			if (rc) {
 				errorlog_add_message(
 					&ds->log, dasdh->log, rc,
 					"member analysis: read error\n");
 				goto out4;
 			}
-			rc = extract_members_from_track(trackdata, ds, &dirend);
-			if (rc) {
-				errorlog_add_message(
-					&ds->log, ds->log, rc,
-					"member analysis: error "
-					"extracting members from track %u\n",
-					currenttrack);
-				goto out4;
+			for (i = 0; currenttrack <= endtrack; ++i) {
+				rc = extract_members_from_track(
+					trackdata + i * RAWTRACKSIZE, ds,
+					&dirend);
+				if (rc) {
+					errorlog_add_message(
+						&ds->log, ds->log, rc,
+						"member analysis: error "
+						"extracting members from "
+						"track %u\n", currenttrack);
+					goto out4;
+				}
+				currenttrack++;
+				if (dirend)
+					break;
 			}
-			currenttrack++;
 			if (dirend)
 				break;
+			batch = MIN(2 * batch, (unsigned int)PDS_DIR_BATCH_MAX);
 		}
 		if (dirend)
 			break;
@@ -2222,6 +2373,22 @@ out1:
 	return rc;
 }
 
+/**
+ * @brief Helper function that frees everything a struct dataset owns,
+ *        for a data set that has not been merged into a zdsroot.
+ *
+ * @param[in] ds  The dataset whose content is to be freed.
+ */
+static void dataset_free_parts(struct dataset *ds)
+{
+	int i;
+
+	dataset_free_memberlist(ds);
+	for (i = 0; i < MAXVOLUMESPERDS; ++i)
+		free(ds->dsp[i]);
+	errorlog_free(ds->log);
+}
+
 /**
  * @brief Subroutine of zdsroot_merge_dataset
  *
@@ -2376,7 +2543,6 @@ int lzds_zdsroot_extract_datasets_from_dasd(struct zdsroot *root,
 	struct dscbiterator *it;
 	int rc;
 	struct dataset tmpds;
-	int i;
 
 	errorlog_clear(root->log);
 	memset(&tmpds, 0, sizeof(tmpds));
@@ -2415,16 +2581,201 @@ int lzds_zdsroot_extract_datasets_from_dasd(struct zdsroot *root,
 			}
 		}
 	}
-	if (rc) {
-		dataset_free_memberlist(&tmpds);
-		for (i = 0; i < MAXVOLUMESPERDS; ++i)
-			free(tmpds.dsp[i]);
-		errorlog_free(tmpds.log);
+	if (rc)
+		dataset_free_parts(&tmpds);
+	lzds_dscbiterator_free(it);
+	return rc;
+}
+
+/**
+ * @brief Subroutine of lzds_zdsroot_extract_datasets_from_dasds
+ *
+ * Reads the VTOC of one dasd and creates a struct dataset, including
+ * the PDS member list, for every format 1 and format 8 DSCB. This
+ * function does not touch the zdsroot, so it can run concurrently
+ * for different dasds.
+ *
+ * @param[in]  scan  The dasd to be scanned. The found data sets are
+ *                   stored in scan->ds.
+ * @return     0 on success, otherwise one of the following error codes:
+ *   - ENOMEM  Could not allocate structure due to lack of memory.
+ *   - EPROTO  Invalid data in the VTOC of the dasd.
+ *   - EIO     An error happened while reading data from disk.
+ */
+static int dasdscan_read_datasets(struct dasdscan *scan)
+{
+	struct dasd *dasd = scan->dasd;
+	struct dataset *tmpds;
+	struct dscbiterator *it;
+	format1_label_t *f1;
+	struct dscb *dscb;
+	unsigned int size;
+	int rc;
+
+	rc = lzds_dasd_alloc_rawvtoc(dasd);
+	if (rc)
+		return rc;
+	rc = lzds_raw_vtoc_alloc_dscbiterator(dasd->rawvtoc, &it);
+	if (rc)
+		return ENOMEM;
+	while (!lzds_dscbiterator_get_next_dscb(it, &dscb)) {
+		if ((unsigned char)dscb->fmtid != 0xf1 &&
+		    (unsigned char)dscb->fmtid != 0xf8)
+			continue;
+		if (scan->dscount == scan->dssize) {
+			size = scan->dssize ? 2 * scan->dssize : 64;
+			tmpds = realloc(scan->ds, size * sizeof(*tmpds));
+			if (!tmpds) {
+				rc = ENOMEM;
+				break;
+			}
+			scan->ds = tmpds;
+			scan->dssize = size;
+		}
+		tmpds = &scan->ds[scan->dscount];
+		f1 = (format1_label_t *)dscb;
+		rc = create_dataset_from_dscb(dasd, f1, tmpds);
+		if (rc)
+			break;
+		rc = dataset_member_analysis(tmpds);
+		if (rc) {
+			errorlog_add_message(
+				&dasd->log, tmpds->log, rc,
+				"scan dasd: member analysis failed for %s\n",
+				tmpds->name);
+			dataset_free_parts(tmpds);
+			break;
+		}
+		scan->dscount++;
 	}
 	lzds_dscbiterator_free(it);
 	return rc;
 }
 
+/**
+ * @brief Thread function of lzds_zdsroot_extract_datasets_from_dasds
+ *
+ * Takes dasds from the scan queue until all of them are scanned.
+ *
+ * @param[in]  arg  The struct scanqueue shared by all scan threads.
+ * @return     Always NULL, the results are stored in the queue.
+ */
+static void *dasdscan_thread(void *arg)
+{
+	struct scanqueue *queue = arg;
+	struct dasdscan *scan;
+
+	while (1) {
+		pthread_mutex_lock(&queue->mutex);
+		if (queue->next == queue->count) {
+			pthread_mutex_unlock(&queue->mutex);
+			break;
+		}
+		scan = &queue->scan[queue->next++];
+		pthread_mutex_unlock(&queue->mutex);
+		scan->rc = dasdscan_read_datasets(scan);
+	}
+	return NULL;
+}
+
+/**
+ * This function has the same effect as calling
+ * lzds_dasd_alloc_rawvtoc and lzds_zdsroot_extract_datasets_from_dasd
+ * for each dasd in the zdsroot, in the order in which the dasds were added.
+ * The I/O intensive part, reading the VTOC and the PDS directories, is
+ * done for several dasds in parallel. The found data sets are merged
+ * into the zdsroot afterwards, one dasd after the other, so the result
+ * does not depend on the order in which the threads finish.
+ *
+ * @pre The volume label of each dasd must have been read, e.g. with
+ *      lzds_dasd_read_vlabel.
+ *
+ * @param[in]  root     The zdsroot that the data sets will be merged into.
+ * @param[in]  threads  Maximum number of dasds that are scanned in parallel.
+ *                      If this is 0, a default value is used.
+ * @return     0 on success, otherwise one of the following error codes:
+ *   - ENOMEM  Could not allocate structure due to lack of memory.
+ *   - EPROTO  The data is not mergable because of conflicting entries,
+ *             or invalid data in the VTOC of a dasd.
+ *   - EINVAL  The volume label of a dasd has not been read or is not valid.
+ *   - EIO     An error happened while reading data from disk.
+ */
+int lzds_zdsroot_extract_datasets_from_dasds(struct zdsroot *root,
+					     unsigned int threads)
+{
+	struct scanqueue queue;
+	struct dasdscan *scan;
+	pthread_t *tids;
+	struct dasd *dasd;
+	unsigned int i, j, started;
+	int rc;
+
+	errorlog_clear(root->log);
+	memset(&queue, 0, sizeof(queue));
+	util_list_iterate(root->dasdlist, dasd)
+		queue.count++;
+	if (!queue.count)
+		return 0;
+	if (!threads)
+		threads = SCAN_THREADS_DEFAULT;
+	threads = MIN(threads, queue.count);
+
+	queue.scan = calloc(queue.count, sizeof(*queue.scan));
+	tids = calloc(threads, sizeof(*tids));
+	if (!queue.scan || !tids) {
+		free(queue.scan);
+		free(tids);
+		return ENOMEM;
+	}
+	i = 0;
+	util_list_iterate(root->dasdlist, dasd)
+		queue.scan[i++].dasd = dasd;
+	pthread_mutex_init(&queue.mutex, NULL);
+
+	/* If not all threads can be created, the ones we have do the work.
+	 * With no thread at all, this thread scans the dasds itself.
+	 */
+	for (started = 0; started < threads; ++started)
+		if (pthread_create(&tids[started], NULL, dasdscan_thread,
+				   &queue))
+			break;
+	if (!started)
+		dasdscan_thread(&queue);
+	for (i = 0; i < started; ++i)
+		pthread_join(tids[i], NULL);
+	pthread_mutex_destroy(&queue.mutex);
+	free(tids);
+
+	/* merge in dasd order, stop at the first error */
+	rc = 0;
+	for (i = 0; i < queue.count; ++i) {
+		scan = &queue.scan[i];
+		for (j = 0; j < scan->dscount; ++j) {
+			if (rc) {
+				dataset_free_parts(&scan->ds[j]);
+				continue;
+			}
+			rc = zdsroot_merge_dataset(root, &scan->ds[j]);
+			if (rc) {
+				errorlog_add_message(
+					&root->log, root->log, rc,
+					"extract data sets: "
+					"merge dataset failed for %s\n",
+					scan->ds[j].name);
+				dataset_free_parts(&scan->ds[j]);
+			}
+		}
+		free(scan->ds);
+		if (!rc && scan->rc)
+			rc = errorlog_add_message(
+				&root->log, scan->dasd->log, scan->rc,
+				"extract data sets: scanning dasd %s failed\n",
+				scan->dasd->device);
+	}
+	free(queue.scan);
+	return rc;
+}
+
 /**
  * @brief Subroutine of lzds_dataset_get_size_in_tracks
  *
@@ -2606,6 +2957,7 @@ void lzds_dshandle_free(struct dshandle *dsh)
 
 	if (!dsh)
 		return;
+	dshandle_readahead_free(dsh);
 	for (i = 0; i < MAXVOLUMESPERDS; ++i)
 		if (dsh->dasdhandle[i])
 			lzds_dasdhandle_free(dsh->dasdhandle[i]);
@@ -2822,6 +3174,527 @@ void lzds_dshandle_get_keepRDW(struct dshandle *dsh, int *keepRDW)
 	*keepRDW = dsh->keepRDW;
 }
 
+/**
+ * With read-ahead enabled, a helper thread reads the next track frame
+ * into a second buffer while the current frame is interpreted. This
+ * speeds up sequential reads, but may read one track frame that is never
+ * used when the data is accessed randomly.
+ *
+ * @pre The dsh must not be open when this function is called.
+ *
+ * @param[in] dsh        The dshandle we want to modify.
+ * @param[in] readahead  Set this to 1 to enable read-ahead or
+ *                       0 to disable it.
+ * @return     0 on success, otherwise one of the following error codes:
+ *   - EBUSY   The handle is already open.
+ */
+int lzds_dshandle_set_readahead(struct dshandle *dsh, int readahead)
+{
+	errorlog_clear(dsh->log);
+	if (dsh->is_open)
+		return errorlog_add_message(
+			&dsh->log, NULL, EBUSY,
+			"dshandle: cannot set read-ahead while handle is open\n");
+	dsh->readahead = readahead;
+	return 0;
+}
+
+/**
+ * @param[in]  dsh       The dshandle that we want to know the setting of.
+ * @param[out] readahead Reference to a variable in which the previously
+ *                       set readahead value is returned.
+ */
+void lzds_dshandle_get_readahead(struct dshandle *dsh, int *readahead)
+{
+	*readahead = dsh->readahead;
+}
+
+/**
+ * Tracks that are read through a dshandle are kept in the cache, so that
+ * other dshandles, or the same one after a seek, do not need to read them
+ * from the device again.
+ * When the dsh is opened and no other dshandle of the same data set is
+ * open, the cached tracks of the data set are discarded, as the data set
+ * may have been modified in the meantime.
+ *
+ * @pre The dsh must not be open when this function is called.
+ *
+ * @param[in] dsh    The dshandle we want to modify.
+ * @param[in] cache  The track cache to be used, or NULL for no caching.
+ *                   The cache must not be freed before the dshandle.
+ * @return     0 on success, otherwise one of the following error codes:
+ *   - EBUSY   The handle is already open.
+ */
+int lzds_dshandle_set_trackcache(struct dshandle *dsh,
+				 struct trackcache *cache)
+{
+	errorlog_clear(dsh->log);
+	if (dsh->is_open)
+		return errorlog_add_message(
+			&dsh->log, NULL, EBUSY,
+			"dshandle: cannot set track cache while handle is open\n");
+	dsh->cache = cache;
+	return 0;
+}
+
+/**
+ * The cache holds size / RAWTRACKSIZE tracks. The track buffers are
+ * allocated when they are first used.
+ *
+ * @param[in]  size   Maximum number of bytes of track data in the cache.
+ * @param[out] cache  Reference to a pointer variable in which the newly
+ *                    allocated structure will be returned.
+ * @return     0 on success, otherwise one of the following error codes:
+ *   - ENOMEM  Could not allocate structure due to lack of memory.
+ *   - EINVAL  The size is smaller than one track.
+ */
+int lzds_trackcache_alloc(unsigned long long size, struct trackcache **cache)
+{
+	struct trackcache *tmp;
+
+	*cache = NULL;
+	if (size < RAWTRACKSIZE)
+		return EINVAL;
+	tmp = malloc(sizeof(*tmp));
+	if (!tmp)
+		return ENOMEM;
+	memset(tmp, 0, sizeof(*tmp));
+	tmp->max = size / RAWTRACKSIZE;
+	/* about two entries per bucket when the cache is full */
+	tmp->hashsize = MIN(tmp->max / 2 + 1, 1ULL << 20);
+	tmp->hash = calloc(tmp->hashsize, sizeof(*tmp->hash));
+	if (!tmp->hash) {
+		free(tmp);
+		return ENOMEM;
+	}
+	tmp->lru = util_list_new(struct trackcache_entry, lru);
+	pthread_mutex_init(&tmp->mutex, NULL);
+	*cache = tmp;
+	return 0;
+}
+
+/**
+ * @param[in]  cache  The track cache to be flushed.
+ */
+void lzds_trackcache_flush(struct trackcache *cache)
+{
+	struct trackcache_entry *entry, *next;
+
+	if (!cache)
+		return;
+	pthread_mutex_lock(&cache->mutex);
+	util_list_iterate_safe(cache->lru, entry, next) {
+		util_list_remove(cache->lru, entry);
+		free(entry->data);
+		free(entry);
+	}
+	memset(cache->hash, 0, cache->hashsize * sizeof(*cache->hash));
+	cache->count = 0;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/**
+ * @param[in]  cache  The track cache to be freed. This may be NULL.
+ */
+void lzds_trackcache_free(struct trackcache *cache)
+{
+	if (!cache)
+		return;
+	lzds_trackcache_flush(cache);
+	util_list_free(cache->lru);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache->users);
+	free(cache->hash);
+	free(cache);
+}
+
+/**
+ * @param[in]  cache   The track cache.
+ * @param[out] hits    Number of tracks that were read from the cache.
+ * @param[out] misses  Number of tracks that had to be read from a device.
+ */
+void lzds_trackcache_get_stats(struct trackcache *cache,
+			       unsigned long long *hits,
+			       unsigned long long *misses)
+{
+	pthread_mutex_lock(&cache->mutex);
+	*hits = cache->hits;
+	*misses = cache->misses;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/**
+ * @brief Find a track in the track cache, the cache must be locked.
+ *
+ * @param[in]  cache  The track cache.
+ * @param[in]  dasd   The device of the track.
+ * @param[in]  track  The track number on the device.
+ * @param[out] bucket Reference to a variable in which the hash bucket
+ *                    of the track is returned.
+ * @return     The cache entry or NULL if the track is not cached.
+ */
+static struct trackcache_entry *trackcache_find(struct trackcache *cache,
+						struct dasd *dasd,
+						unsigned int track,
+						unsigned int *bucket)
+{
+	struct trackcache_entry *entry;
+	unsigned long long key;
+
+	key = ((unsigned long)dasd >> 4) * 0x9e3779b97f4a7c15ULL + track;
+	*bucket = (key ^ (key >> 29)) % cache->hashsize;
+	for (entry = cache->hash[*bucket]; entry; entry = entry->next)
+		if (entry->dasd == dasd && entry->track == track)
+			return entry;
+	return NULL;
+}
+
+/**
+ * @brief Copy a track from the cache into a buffer
+ *
+ * @return     1 if the track was found, 0 otherwise.
+ */
+static int trackcache_get(struct trackcache *cache, struct dasd *dasd,
+			  unsigned int track, char *buffer)
+{
+	struct trackcache_entry *entry;
+	unsigned int bucket;
+
+	pthread_mutex_lock(&cache->mutex);
+	entry = trackcache_find(cache, dasd, track, &bucket);
+	if (entry) {
+		memcpy(buffer, entry->data, RAWTRACKSIZE);
+		util_list_remove(cache->lru, entry);
+		util_list_add_head(cache->lru, entry);
+		cache->hits++;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	return entry != NULL;
+}
+
+/**
+ * @brief Check if a track is in the cache, without updating the statistics.
+ */
+static int trackcache_contains(struct trackcache *cache, struct dasd *dasd,
+			       unsigned int track)
+{
+	unsigned int bucket;
+	int found;
+
+	pthread_mutex_lock(&cache->mutex);
+	found = trackcache_find(cache, dasd, track, &bucket) != NULL;
+	pthread_mutex_unlock(&cache->mutex);
+	return found;
+}
+
+/**
+ * @brief Remove an entry from its hash bucket, the cache must be locked.
+ */
+static void trackcache_unhash(struct trackcache *cache,
+			      struct trackcache_entry *entry)
+{
+	struct trackcache_entry **pprev;
+	unsigned int bucket;
+
+	trackcache_find(cache, entry->dasd, entry->track, &bucket);
+	for (pprev = &cache->hash[bucket]; *pprev != entry;
+	     pprev = &(*pprev)->next)
+		;
+	*pprev = entry->next;
+}
+
+/**
+ * @brief Remove all tracks of a data set from the cache, the cache must
+ * be locked.
+ */
+static void trackcache_drop_dataset(struct trackcache *cache,
+				    struct dataset *ds)
+{
+	struct trackcache_entry *entry, *next;
+	unsigned int start, end;
+	struct datasetpart *dsp;
+	int i, j, drop;
+
+	util_list_iterate_safe(cache->lru, entry, next) {
+		drop = 0;
+		for (i = 0; i < MAXVOLUMESPERDS && !drop; ++i) {
+			dsp = ds->dsp[i];
+			if (!dsp || dsp->dasdi != entry->dasd)
+				continue;
+			for (j = 0; j < MAXEXTENTS && !drop; ++j) {
+				if (!extent_contains_userdata(&dsp->ext[j]))
+					continue;
+				lzds_dasd_cchh2trk(dsp->dasdi,
+						   &dsp->ext[j].llimit, &start);
+				lzds_dasd_cchh2trk(dsp->dasdi,
+						   &dsp->ext[j].ulimit, &end);
+				drop = entry->track >= start &&
+					entry->track <= end;
+			}
+		}
+		if (!drop)
+			continue;
+		util_list_remove(cache->lru, entry);
+		trackcache_unhash(cache, entry);
+		free(entry->data);
+		free(entry);
+		cache->count--;
+	}
+}
+
+/**
+ * @brief Register an open dshandle of a data set with the cache
+ *
+ * When the first handle of a data set is opened, all cached tracks of
+ * the data set are dropped, because the data set may have been modified
+ * while it was not open. If the data set cannot be registered due to
+ * lack of memory, its tracks are dropped on every open.
+ */
+static void trackcache_attach(struct trackcache *cache, struct dataset *ds)
+{
+	struct trackcache_user *tmp;
+	unsigned int i;
+
+	pthread_mutex_lock(&cache->mutex);
+	for (i = 0; i < cache->nusers; ++i) {
+		if (cache->users[i].ds == ds) {
+			cache->users[i].count++;
+			goto out;
+		}
+	}
+	trackcache_drop_dataset(cache, ds);
+	if (cache->nusers == cache->usersize) {
+		tmp = realloc(cache->users, (cache->usersize + 16) *
+			      sizeof(*cache->users));
+		if (!tmp)
+			goto out;
+		cache->users = tmp;
+		cache->usersize += 16;
+	}
+	cache->users[cache->nusers].ds = ds;
+	cache->users[cache->nusers].count = 1;
+	cache->nusers++;
+out:
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/**
+ * @brief Unregister an open dshandle of a data set from the cache
+ */
+static void trackcache_detach(struct trackcache *cache, struct dataset *ds)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&cache->mutex);
+	for (i = 0; i < cache->nusers; ++i) {
+		if (cache->users[i].ds != ds)
+			continue;
+		if (!--cache->users[i].count)
+			cache->users[i] = cache->users[--cache->nusers];
+		break;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/**
+ * @brief Store a copy of a track in the cache
+ *
+ * If the cache is full, the least recently used track is replaced.
+ * If no memory is available, the track is just not cached.
+ */
+static void trackcache_put(struct trackcache *cache, struct dasd *dasd,
+			   unsigned int track, char *buffer)
+{
+	struct trackcache_entry *entry;
+	unsigned int bucket;
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->misses++;
+	if (trackcache_find(cache, dasd, track, &bucket))
+		goto out;
+	if (cache->count < cache->max) {
+		entry = malloc(sizeof(*entry));
+		if (!entry)
+			goto out;
+		entry->data = malloc(RAWTRACKSIZE);
+		if (!entry->data) {
+			free(entry);
+			goto out;
+		}
+		cache->count++;
+	} else {
+		/* reuse the least recently used entry */
+		entry = util_list_end(cache->lru);
+		util_list_remove(cache->lru, entry);
+		trackcache_unhash(cache, entry);
+		trackcache_find(cache, dasd, track, &bucket);
+	}
+	entry->dasd = dasd;
+	entry->track = track;
+	memcpy(entry->data, buffer, RAWTRACKSIZE);
+	entry->next = cache->hash[bucket];
+	cache->hash[bucket] = entry;
+	util_list_add_head(cache->lru, entry);
+out:
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/**
+ * @brief Read tracks through a track cache
+ *
+ * Tracks that are found in the cache are copied, all others are read
+ * from the device, where consecutive missing tracks are read at once.
+ *
+ * @param[in]  cache     The track cache, if NULL all tracks are read from
+ *                       the device.
+ * @param[in]  dasdh     The dasdhandle of the device.
+ * @param[in]  starttrck First track to read.
+ * @param[in]  endtrck   Last track to read.
+ * @param[out] trackdata Page aligned buffer for the track data.
+ * @return     0 on success, otherwise the error code of
+ *             lzds_dasdhandle_read_tracks_to_buffer.
+ */
+static int trackcache_read_tracks(struct trackcache *cache,
+				  struct dasdhandle *dasdh,
+				  unsigned int starttrck,
+				  unsigned int endtrck,
+				  char *trackdata)
+{
+	struct dasd *dasd = dasdh->dasd;
+	unsigned int trk, first;
+	char *buffer;
+	int rc;
+
+	if (!cache)
+		return lzds_dasdhandle_read_tracks_to_buffer(
+			dasdh, starttrck, endtrck, trackdata);
+	trk = starttrck;
+	while (trk <= endtrck) {
+		buffer = trackdata + (size_t)(trk - starttrck) * RAWTRACKSIZE;
+		if (trackcache_get(cache, dasd, trk, buffer)) {
+			trk++;
+			continue;
+		}
+		first = trk;
+		while (trk < endtrck && !trackcache_contains(cache, dasd,
+							    trk + 1))
+			trk++;
+		rc = lzds_dasdhandle_read_tracks_to_buffer(dasdh, first, trk,
+							   buffer);
+		if (rc)
+			return rc;
+		for (; first <= trk; first++) {
+			trackcache_put(cache, dasd, first, buffer);
+			buffer += RAWTRACKSIZE;
+		}
+		trk++;
+	}
+	return 0;
+}
+
+/**
+ * @brief Helper thread that reads requested track frames
+ *
+ * @param[in]  data  The struct readahead of the dshandle.
+ */
+static void *readahead_thread(void *data)
+{
+	struct readahead *ra = data;
+	int rc;
+
+	pthread_mutex_lock(&ra->mutex);
+	while (1) {
+		while (ra->state != RA_QUEUED && !ra->stop)
+			pthread_cond_wait(&ra->cond, &ra->mutex);
+		if (ra->stop)
+			break;
+		pthread_mutex_unlock(&ra->mutex);
+		rc = trackcache_read_tracks(ra->cache, ra->dasdh,
+					    ra->starttrk, ra->endtrk,
+					    ra->buffer);
+		pthread_mutex_lock(&ra->mutex);
+		ra->rc = rc;
+		ra->state = RA_DONE;
+		pthread_cond_broadcast(&ra->cond);
+	}
+	pthread_mutex_unlock(&ra->mutex);
+	return NULL;
+}
+
+/**
+ * @brief Wait until the helper thread has finished a pending request
+ *
+ * The dasdhandles must not be used while a request is pending.
+ *
+ * @param[in]  ra  The read-ahead context.
+ */
+static void readahead_wait(struct readahead *ra)
+{
+	pthread_mutex_lock(&ra->mutex);
+	while (ra->state == RA_QUEUED)
+		pthread_cond_wait(&ra->cond, &ra->mutex);
+	pthread_mutex_unlock(&ra->mutex);
+}
+
+/**
+ * @brief Start the read-ahead helper thread for an open dshandle
+ *
+ * Read-ahead is an optimization only. If the thread or buffer cannot be
+ * created, the dshandle just reads synchronously.
+ *
+ * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ */
+static void dshandle_readahead_alloc(struct dshandle *dsh)
+{
+	struct readahead *ra;
+
+	ra = malloc(sizeof(*ra));
+	if (!ra)
+		return;
+	memset(ra, 0, sizeof(*ra));
+	ra->cache = dsh->cache;
+	/* track buffer must be page aligned for O_DIRECT */
+	ra->buffer = memalign(4096, dsh->rawbufmax);
+	if (!ra->buffer)
+		goto out_free;
+	pthread_mutex_init(&ra->mutex, NULL);
+	pthread_cond_init(&ra->cond, NULL);
+	if (pthread_create(&ra->thread, NULL, readahead_thread, ra))
+		goto out_destroy;
+	dsh->ra = ra;
+	return;
+
+out_destroy:
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->mutex);
+	free(ra->buffer);
+out_free:
+	free(ra);
+}
+
+/**
+ * @brief Stop the read-ahead helper thread and free its resources
+ *
+ * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ */
+static void dshandle_readahead_free(struct dshandle *dsh)
+{
+	struct readahead *ra = dsh->ra;
+
+	if (!ra)
+		return;
+	pthread_mutex_lock(&ra->mutex);
+	ra->stop = 1;
+	pthread_cond_broadcast(&ra->cond);
+	pthread_mutex_unlock(&ra->mutex);
+	pthread_join(ra->thread, NULL);
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->mutex);
+	free(ra->buffer);
+	free(ra);
+	dsh->ra = NULL;
+}
+
 /**
  * @brief Helper function that initializes the given handle so that it
  *        points to the beginning of the dataset or member.
@@ -2943,6 +3816,10 @@ static int initialize_buffer_positions_for_first_read(struct dshandle *dsh)
 void lzds_dshandle_close(struct dshandle *dsh)
 {
 	int i;
+
+	dshandle_readahead_free(dsh);
+	if (dsh->is_open && dsh->cache)
+		trackcache_detach(dsh->cache, dsh->ds);
 	for (i = 0; i < MAXVOLUMESPERDS; ++i)
 		if (dsh->dasdhandle[i])
 			lzds_dasdhandle_close(dsh->dasdhandle[i]);
@@ -3280,6 +4157,10 @@ int lzds_dshandle_open(struct dshandle *dsh)
 			return rc;
 		}
 	}
+	if (dsh->cache)
+		trackcache_attach(dsh->cache, dsh->ds);
+	if (dsh->readahead)
+		dshandle_readahead_alloc(dsh);
 	dsh->is_open = 1;
 	return 0;
 }
@@ -3495,38 +4376,33 @@ static int dshandle_extract_data_from_trackbuffer(struct dshandle *dsh)
 /**
  * @brief subroutine of lzds_dshandle_read
  *
- * Find the next range of extents and prepare dsh for the next read.
- * The return value indicates whether there is more data to read or not.
- *
- * @pre: For the first call to this function, dsh should be set to the
- *       last track before the first track to read.
- *       If the first track to read is the first track in the dataset
- *       then set dsh->ext_seq_no to -1.
+ * Find the track frame that follows the current position of dsh.
+ * The dsh itself is not modified.
  *
  * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ * @param[out] tf   The location of the next track frame.
  *
  * @return
  *   0 when there is no further raw data available,
- *   1 when there is more data available and dsh is prepared
+ *   1 when there is more data available and tf is set
  */
-static int dshandle_prepare_for_next_read_tracks(struct dshandle *dsh)
+static int dshandle_get_next_trackframe(struct dshandle *dsh,
+					struct trackframe *tf)
 {
 	int found, dsp_no, ext_seq_no;
 
 	/* If there are still unread tracks in the current extent, we just need
-	 * to point dsh to the next range of tracks
+	 * to point to the next range of tracks
 	 */
 	if (dsh->bufendtrk < dsh->extendtrk) {
-		dsh->bufstarttrk = dsh->bufendtrk + 1;
-		dsh->bufendtrk = dsh->bufstarttrk +
+		tf->dsp_no = dsh->dsp_no;
+		tf->ext_seq_no = dsh->ext_seq_no;
+		tf->extstarttrk = dsh->extstarttrk;
+		tf->extendtrk = dsh->extendtrk;
+		tf->bufstarttrk = dsh->bufendtrk + 1;
+		tf->bufendtrk = tf->bufstarttrk +
 			(dsh->rawbufmax / RAWTRACKSIZE) - 1;
-		dsh->bufendtrk = MIN(dsh->bufendtrk, dsh->extendtrk);
-		dsh->rawbufsize = (dsh->bufendtrk - dsh->bufstarttrk + 1)
-			* RAWTRACKSIZE;
-		dsh->databufoffset = dsh->databufoffset + dsh->databufsize;
-		dsh->databufsize = 0;
-		dsh->bufpos = 0;
-		dsh->frameno++;
+		tf->bufendtrk = MIN(tf->bufendtrk, tf->extendtrk);
 		return 1;
 	}
 	/* There are no more tracks left in the current extent.
@@ -3551,18 +4427,50 @@ static int dshandle_prepare_for_next_read_tracks(struct dshandle *dsh)
 	if (!found)
 		return 0;
 	/* We have found the next valid extent. Get lower and upper track
-	 * limits and set dsh to the first range of tracks */
-	dsh->ext_seq_no = ext_seq_no;
-	dsh->dsp_no = dsp_no;
+	 * limits and point to the first range of tracks */
+	tf->ext_seq_no = ext_seq_no;
+	tf->dsp_no = dsp_no;
 	lzds_dasd_cchh2trk(dsh->ds->dsp[dsp_no]->dasdi,
 			&dsh->ds->dsp[dsp_no]->ext[ext_seq_no].llimit,
-			&dsh->extstarttrk);
+			&tf->extstarttrk);
 	lzds_dasd_cchh2trk(dsh->ds->dsp[dsp_no]->dasdi,
 			&dsh->ds->dsp[dsp_no]->ext[ext_seq_no].ulimit,
-			&dsh->extendtrk);
-	dsh->bufstarttrk = dsh->extstarttrk;
-	dsh->bufendtrk = dsh->bufstarttrk + (dsh->rawbufmax / RAWTRACKSIZE) - 1;
-	dsh->bufendtrk = MIN(dsh->bufendtrk, dsh->extendtrk);
+			&tf->extendtrk);
+	tf->bufstarttrk = tf->extstarttrk;
+	tf->bufendtrk = tf->bufstarttrk + (dsh->rawbufmax / RAWTRACKSIZE) - 1;
+	tf->bufendtrk = MIN(tf->bufendtrk, tf->extendtrk);
+	return 1;
+}
+
+/**
+ * @brief subroutine of lzds_dshandle_read
+ *
+ * Find the next range of extents and prepare dsh for the next read.
+ * The return value indicates whether there is more data to read or not.
+ *
+ * @pre: For the first call to this function, dsh should be set to the
+ *       last track before the first track to read.
+ *       If the first track to read is the first track in the dataset
+ *       then set dsh->ext_seq_no to -1.
+ *
+ * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ *
+ * @return
+ *   0 when there is no further raw data available,
+ *   1 when there is more data available and dsh is prepared
+ */
+static int dshandle_prepare_for_next_read_tracks(struct dshandle *dsh)
+{
+	struct trackframe tf;
+
+	if (!dshandle_get_next_trackframe(dsh, &tf))
+		return 0;
+	dsh->dsp_no = tf.dsp_no;
+	dsh->ext_seq_no = tf.ext_seq_no;
+	dsh->extstarttrk = tf.extstarttrk;
+	dsh->extendtrk = tf.extendtrk;
+	dsh->bufstarttrk = tf.bufstarttrk;
+	dsh->bufendtrk = tf.bufendtrk;
 	dsh->rawbufsize = (dsh->bufendtrk - dsh->bufstarttrk + 1)
 			   * RAWTRACKSIZE;
 	dsh->databufoffset = dsh->databufoffset + dsh->databufsize;
@@ -3572,6 +4480,74 @@ static int dshandle_prepare_for_next_read_tracks(struct dshandle *dsh)
 	return 1;
 }
 
+/**
+ * @brief subroutine of lzds_dshandle_read
+ *
+ * Queue a read request for the track frame that follows the current one.
+ *
+ * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ */
+static void dshandle_readahead_next(struct dshandle *dsh)
+{
+	struct readahead *ra = dsh->ra;
+	struct trackframe tf;
+
+	if (!dshandle_get_next_trackframe(dsh, &tf))
+		return;
+	pthread_mutex_lock(&ra->mutex);
+	ra->dasdh = dsh->dasdhandle[tf.dsp_no];
+	ra->dsp_no = tf.dsp_no;
+	ra->starttrk = tf.bufstarttrk;
+	ra->endtrk = tf.bufendtrk;
+	ra->state = RA_QUEUED;
+	pthread_cond_broadcast(&ra->cond);
+	pthread_mutex_unlock(&ra->mutex);
+}
+
+/**
+ * @brief subroutine of lzds_dshandle_read
+ *
+ * Read the current track frame into the rawbuffer. If read-ahead is
+ * enabled and the frame has already been read by the helper thread, the
+ * buffers are just swapped. Afterwards the next frame is requested.
+ *
+ * @param[in]  dsh  The dshandle that keeps track of the I/O operations.
+ *
+ * @return     0 on success, otherwise the error code of
+ *             lzds_dasdhandle_read_tracks_to_buffer.
+ */
+static int dshandle_read_trackframe(struct dshandle *dsh)
+{
+	struct readahead *ra = dsh->ra;
+	char *tmp;
+	int rc;
+
+	if (ra) {
+		readahead_wait(ra);
+		if (ra->state == RA_DONE && !ra->rc &&
+		    ra->dsp_no == dsh->dsp_no &&
+		    ra->starttrk == dsh->bufstarttrk &&
+		    ra->endtrk == dsh->bufendtrk) {
+			tmp = dsh->rawbuffer;
+			dsh->rawbuffer = ra->buffer;
+			ra->buffer = tmp;
+			ra->state = RA_IDLE;
+			dshandle_readahead_next(dsh);
+			return 0;
+		}
+		/* no match, e.g. after a seek or a failed read */
+		ra->state = RA_IDLE;
+	}
+	rc = trackcache_read_tracks(dsh->cache, dsh->dasdhandle[dsh->dsp_no],
+				    dsh->bufstarttrk, dsh->bufendtrk,
+				    dsh->rawbuffer);
+	if (rc)
+		return rc;
+	if (ra)
+		dshandle_readahead_next(dsh);
+	return 0;
+}
+
 /**
  * @brief subroutine of lzds_dshandle_read
  *
@@ -3668,9 +4644,7 @@ int lzds_dshandle_read(struct dshandle *dsh, char *buf,
 				break; /* end of data in data set reached */
 			if (!dshandle_prepare_for_next_read_tracks(dsh))
 				break; /* end of data set extents reached */
-			rc = lzds_dasdhandle_read_tracks_to_buffer(
-				dsh->dasdhandle[dsh->dsp_no], dsh->bufstarttrk,
-				dsh->bufendtrk, dsh->rawbuffer);
+			rc = dshandle_read_trackframe(dsh);
 			if (rc)
 				return errorlog_add_message(
 					&dsh->log,
@@ -0,0 +1,265 @@
+/*
+ * libzds - Benchmark for parallel data set readers
+ *
+ * Create one track image file per reader, each with a sequential data set,
+ * and read the data sets with N threads in the way zdsfs_read() does. The
+ * readers either share one lock, as with a single-threaded FUSE loop, or
+ * lock only their own data set handle.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <limits.h>
+#include <time.h>
+
+/* Include the library code to get access to the internal structures */
+#include "libzds.c"
+
+#define DEFAULT_READERS	8
+#define HEADS		15
+#define CYLS		100
+#define RECS		40
+#define RECLEN		1024
+#define READ_SIZE	(128 * 1024)
+#define TRACKS_PER_FRAME 128
+
+struct reader {
+	pthread_t thread;
+	char path[PATH_MAX];
+	struct dasd dasd;
+	format1_label_t f1;
+	struct datasetpart dsp;
+	struct dataset ds;
+	struct dshandle *dsh;
+	pthread_mutex_t mutex;
+	pthread_mutex_t *lock;
+	char *buf;
+	unsigned long long bytes;
+};
+
+static struct timespec start_ts;
+
+static void timer_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+}
+
+static void timer_report(const char *name, unsigned long count,
+			 unsigned long long bytes)
+{
+	struct timespec ts;
+	double sec;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sec = (ts.tv_sec - start_ts.tv_sec) +
+		(ts.tv_nsec - start_ts.tv_nsec) / 1e9;
+	printf("%-28s %10lu %10.3f s %8.1f MiB/s\n", name, count, sec,
+	       bytes / sec / (1024 * 1024));
+	fflush(stdout);
+}
+
+/*
+ * Write one raw track with record zero and RECS data records. The last
+ * track of the data set gets an end of file record.
+ */
+static void track_fill(char *buf, unsigned int trk, int eof)
+{
+	struct eckd_count *ec;
+	char *p = buf;
+	int r;
+
+	memset(buf, 0, RAWTRACKSIZE);
+	for (r = 0; r <= RECS; r++) {
+		ec = (struct eckd_count *)p;
+		ec->recid.cc = trk / HEADS;
+		ec->recid.hh = trk % HEADS;
+		ec->recid.b = r;
+		ec->dl = r ? RECLEN : 8;
+		p += sizeof(*ec);
+		memset(p, trk + r, ec->dl);
+		p += ec->dl;
+	}
+	if (eof) {
+		ec = (struct eckd_count *)p;
+		ec->recid.b = r;
+		p += sizeof(*ec);
+	}
+	*(unsigned long long *)p = ENDTOKEN;
+}
+
+/*
+ * Create the track image of one reader with a data set in one extent
+ * from track one to the end of the device
+ */
+static void reader_init(struct reader *rd, const char *dir, int nr)
+{
+	static char trk[RAWTRACKSIZE];
+	unsigned int t, last = HEADS * CYLS - 1;
+	extent_t *ext;
+	int fd;
+
+	snprintf(rd->path, sizeof(rd->path), "%s/dasd%d", dir, nr);
+	fd = open(rd->path, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) {
+		perror(rd->path);
+		exit(EXIT_FAILURE);
+	}
+	for (t = 0; t <= last; t++) {
+		track_fill(trk, t, t == last);
+		if (write(fd, trk, sizeof(trk)) != sizeof(trk)) {
+			perror(rd->path);
+			exit(EXIT_FAILURE);
+		}
+	}
+	close(fd);
+
+	rd->dasd.device = rd->path;
+	rd->dasd.cylinders = CYLS;
+	rd->dasd.heads = HEADS;
+	rd->f1.DS1RECFM = 0x80;
+	rd->f1.DS1DSRG1 = 0x40;
+	rd->dsp.dasdi = &rd->dasd;
+	rd->dsp.f1 = &rd->f1;
+	ext = &rd->dsp.ext[0];
+	ext->typeind = 0x01;
+	ext->llimit.cc = 0;
+	ext->llimit.hh = 1;
+	ext->ulimit.cc = last / HEADS;
+	ext->ulimit.hh = last % HEADS;
+	rd->ds.dsp[0] = &rd->dsp;
+	rd->ds.dspcount = 1;
+	rd->ds.iscomplete = 1;
+	rd->buf = malloc(READ_SIZE);
+	if (!rd->buf) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&rd->mutex, NULL);
+}
+
+static void reader_open(struct reader *rd)
+{
+	if (lzds_dataset_alloc_dshandle(&rd->ds, TRACKS_PER_FRAME, &rd->dsh) ||
+	    lzds_dshandle_open(rd->dsh)) {
+		fprintf(stderr, "Could not open data set on %s\n", rd->path);
+		exit(EXIT_FAILURE);
+	}
+	rd->bytes = 0;
+}
+
+static void reader_close(struct reader *rd)
+{
+	lzds_dshandle_close(rd->dsh);
+	lzds_dshandle_free(rd->dsh);
+}
+
+/*
+ * Read the whole data set in FUSE sized requests like zdsfs_read()
+ */
+static void *reader_run(void *arg)
+{
+	struct reader *rd = arg;
+	long long offset;
+	ssize_t count;
+	int rc;
+
+	do {
+		pthread_mutex_lock(rd->lock);
+		rc = 0;
+		lzds_dshandle_get_offset(rd->dsh, &offset);
+		if (offset != (long long)rd->bytes)
+			rc = lzds_dshandle_lseek(rd->dsh, rd->bytes, &offset);
+		if (!rc)
+			rc = lzds_dshandle_read(rd->dsh, rd->buf, READ_SIZE,
+						&count);
+		pthread_mutex_unlock(rd->lock);
+		if (rc) {
+			fprintf(stderr, "Read from %s failed\n", rd->path);
+			exit(EXIT_FAILURE);
+		}
+		rd->bytes += count;
+	} while (count);
+	return NULL;
+}
+
+/*
+ * Read with "count" parallel readers, either with one shared lock or with
+ * one lock per data set handle
+ */
+static void bench_readers(struct reader *rd, int count, int shared)
+{
+	static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+	unsigned long long bytes = 0;
+	char name[32];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		reader_open(&rd[i]);
+		rd[i].lock = shared ? &shared_mutex : &rd[i].mutex;
+	}
+	timer_start();
+	for (i = 0; i < count; i++)
+		pthread_create(&rd[i].thread, NULL, reader_run, &rd[i]);
+	for (i = 0; i < count; i++) {
+		pthread_join(rd[i].thread, NULL);
+		bytes += rd[i].bytes;
+	}
+	snprintf(name, sizeof(name), "%s lock", shared ? "shared" : "handle");
+	timer_report(name, count, bytes);
+	for (i = 0; i < count; i++) {
+		if (rd[i].bytes != rd[0].bytes) {
+			fprintf(stderr, "Reader %d read %llu bytes\n", i,
+				rd[i].bytes);
+			exit(EXIT_FAILURE);
+		}
+		reader_close(&rd[i]);
+	}
+}
+
+/*
+ * Run the benchmark with 1 up to an optional maximum number of readers.
+ * The track images are created in the current directory, because /tmp
+ * might not support O_DIRECT.
+ */
+int main(int argc, char *argv[])
+{
+	char dir[] = "zds_bench.XXXXXX";
+	int max = DEFAULT_READERS, i;
+	struct reader *rd;
+
+	if (argc > 1)
+		max = atoi(argv[1]);
+	if (max <= 0) {
+		fprintf(stderr, "Usage: %s [READERS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	rd = calloc(max, sizeof(*rd));
+	if (!rd) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < max; i++)
+		reader_init(&rd[i], dir, i);
+
+	printf("%-28s %10s %12s %14s\n", "Benchmark", "Readers", "Time",
+	       "Throughput");
+	for (i = 1; i <= max; i *= 2) {
+		bench_readers(rd, i, 1);
+		bench_readers(rd, i, 0);
+	}
+
+	for (i = 0; i < max; i++) {
+		unlink(rd[i].path);
+		free(rd[i].buf);
+	}
+	rmdir(dir);
+	free(rd);
+	return EXIT_SUCCESS;
+}
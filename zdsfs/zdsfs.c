@@ -23,7 +23,7 @@
 #include <string.h>
 #include <curl/curl.h>
 #include <time.h>
-#include <signal.h>
+#include <unistd.h>
 
 #ifdef HAVE_SETXATTR
 #include <linux/xattr.h>
@@ -46,10 +46,15 @@ struct zdsfs_info {
 	int devcount;
 	int allow_inclomplete_multi_volume;
 	int keepRDW;
+	int readahead;
 	int host_count;
 	unsigned int tracks_per_frame;
 	unsigned long long seek_buffer_size;
+	unsigned long long trackcache_size;
+	struct trackcache *trackcache; /* shared by all open data sets */
 	struct zdsroot *zdsroot;
+	/* protects the data set list of zdsroot and the meta data buffer */
+	pthread_rwlock_t lock;
 
 	char *metadata;  /* buffer that contains the content of metadata.txt */
 	size_t metasize; /* total size of meta data buffer */
@@ -66,82 +71,121 @@ struct zdsfs_info {
 static struct zdsfs_info zdsfsinfo;
 static int zdsfs_create_meta_data_buffer(struct zdsfs_info *);
 static int zdsfs_verify_datasets(void);
-static struct util_list *open_dsh;
-static int timer_running;
+static struct dsh_table *open_dsh;
 
-struct dsh_node {
-	struct util_list_node node;
-	struct dshandle *dsh;
+/*
+ * Table of all open data set handles
+ *
+ * Each handle occupies one slot. The slot number is kept in the
+ * zdsfs_file_info, so that adding and removing a handle does not
+ * need to search the table.
+ * A slot is busy while the keepalive thread uses its handle outside
+ * of the table lock. Removing the handle waits until it is not busy.
+ */
+struct dsh_table {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* signaled when a slot is no longer busy */
+	struct dshandle **slot;
+	unsigned int *busy;	/* per slot usage count of keepalive thread */
+	unsigned int size;	/* number of slots */
+	unsigned int used;	/* number of occupied slots */
+	unsigned int *free;	/* stack of unoccupied slot numbers */
+	unsigned int nfree;
 };
 
 struct zdsfs_file_info {
 	struct dshandle *dsh;
 	pthread_mutex_t mutex;
+	int slot; /* slot in open_dsh or -1 */
 
 	int is_metadata_file;
 	size_t metaread; /* how many bytes have already been read */
 };
 
-/* Allocate and initialize a new list of struct dsh_node. */
-static struct util_list *dshlist_alloc(void)
+/* Allocate and initialize a new, empty handle table. */
+static struct dsh_table *dshtable_alloc(void)
 {
-	struct util_list *list;
+	struct dsh_table *table;
 
-	list = util_malloc(sizeof(struct util_list));
-	util_list_init(list, struct dsh_node, node);
+	table = util_zalloc(sizeof(struct dsh_table));
+	pthread_mutex_init(&table->mutex, NULL);
+	pthread_cond_init(&table->cond, NULL);
 
-	return list;
+	return table;
 }
 
-/* free list of struct dsh_node. */
-static void dshlist_free(struct util_list *list)
+/* Free a handle table. The handles themselves are not freed. */
+static void dshtable_free(struct dsh_table *table)
 {
-	struct dsh_node *s, *n;
-
-	if (!list)
+	if (!table)
 		return;
 
-	util_list_iterate_safe(list, s, n) {
-		util_list_remove(list, s);
-		free(s);
-	}
-
-	free(list);
+	pthread_mutex_destroy(&table->mutex);
+	pthread_cond_destroy(&table->cond);
+	free(table->slot);
+	free(table->busy);
+	free(table->free);
+	free(table);
 }
 
-/* add dsh to list */
-static void dshlist_add(struct util_list *list, struct dshandle *dsh)
+/* Add dsh to the table and return its slot number. */
+static int dshtable_add(struct dsh_table *table, struct dshandle *dsh)
 {
-	struct dsh_node *s;
+	unsigned int i, size;
+
+	pthread_mutex_lock(&table->mutex);
+	if (!table->nfree) {
+		size = table->size ? 2 * table->size : 64;
+		table->slot = util_realloc(table->slot,
+					   size * sizeof(*table->slot));
+		table->free = util_realloc(table->free,
+					   size * sizeof(*table->free));
+		table->busy = util_realloc(table->busy,
+					   size * sizeof(*table->busy));
+		memset(&table->busy[table->size], 0,
+		       (size - table->size) * sizeof(*table->busy));
+		/* push in reverse order, so that low slots are used first */
+		for (i = size; i > table->size; i--)
+			table->free[table->nfree++] = i - 1;
+		table->size = size;
+	}
+	i = table->free[--table->nfree];
+	table->slot[i] = dsh;
+	table->used++;
+	pthread_mutex_unlock(&table->mutex);
 
-	s = util_malloc(sizeof(struct dsh_node));
-	s->dsh = dsh;
-	util_list_add_tail(list, s);
+	return i;
 }
 
-/* Find a dsh_node. */
-static struct dsh_node *dshlist_find(struct util_list *list, struct dshandle *dsh)
+/*
+ * Remove the handle in the given slot from the table. When this
+ * function returns, the handle is no longer used by the keepalive
+ * thread and may be freed.
+ */
+static void dshtable_remove(struct dsh_table *table, int slot)
 {
-	struct dsh_node *s;
-
-	util_list_iterate(list, s) {
-		if (s->dsh == dsh)
-			return s;
-	}
+	if (slot < 0)
+		return;
 
-	return NULL;
+	pthread_mutex_lock(&table->mutex);
+	while (table->busy[slot])
+		pthread_cond_wait(&table->cond, &table->mutex);
+	table->slot[slot] = NULL;
+	table->free[table->nfree++] = slot;
+	table->used--;
+	pthread_mutex_unlock(&table->mutex);
 }
 
-/* Remove a dsh_node from the list. */
-void dshlist_remove(struct util_list *list, struct dshandle *dsh)
+/* Return the number of open handles. */
+static unsigned int dshtable_count(struct dsh_table *table)
 {
-	struct dsh_node *p;
+	unsigned int used;
 
-	p = dshlist_find(list, dsh);
-	if (p) {
-		util_list_remove(list, p);
-		free(p);
-	}
+	pthread_mutex_lock(&table->mutex);
+	used = table->used;
+	pthread_mutex_unlock(&table->mutex);
+
+	return used;
 }
 
 
@@ -176,49 +220,75 @@ static void path_to_member_name(const char *path, char *normds, size_t size)
 	}
 }
 
-static void setup_timer(long sec)
+/*
+ * Periodically ping the REST server for all open handles, so that
+ * the server keeps the ENQs of the data sets. The handles are marked
+ * busy and pinged without holding the table lock, so that open and
+ * release are not blocked by a slow server.
+ */
+static void *keepalive_thread(void *UNUSED(arg))
 {
-	static struct itimerval timer;
+	struct dshandle **dsh = NULL;
+	unsigned int *slot = NULL;
+	unsigned int i, count;
+
+	while (1) {
+		sleep(zdsfsinfo.keepalive);
+		pthread_mutex_lock(&open_dsh->mutex);
+		dsh = util_realloc(dsh, open_dsh->size * sizeof(*dsh));
+		slot = util_realloc(slot, open_dsh->size * sizeof(*slot));
+		count = 0;
+		for (i = 0; i < open_dsh->size; i++) {
+			if (!open_dsh->slot[i])
+				continue;
+			open_dsh->busy[i]++;
+			dsh[count] = open_dsh->slot[i];
+			slot[count++] = i;
+		}
+		pthread_mutex_unlock(&open_dsh->mutex);
 
-	memset(&timer, 0, sizeof(struct itimerval));
-	timer.it_value.tv_sec = sec;
-	setitimer(ITIMER_REAL, &timer, NULL);
+		for (i = 0; i < count; i++)
+			lzds_rest_ping(dsh[i],
+				       zdsfsinfo.server[zdsfsinfo.active_server]);
+
+		pthread_mutex_lock(&open_dsh->mutex);
+		for (i = 0; i < count; i++)
+			open_dsh->busy[slot[i]]--;
+		pthread_cond_broadcast(&open_dsh->cond);
+		pthread_mutex_unlock(&open_dsh->mutex);
+	}
+	return NULL;
 }
 
-static void keep_alive(int UNUSED(signal))
+static void keepalive_init(void)
 {
-	struct dsh_node *s;
+	pthread_t thread;
+	int rc;
 
-	if (!open_dsh) {
-		timer_running = 0;
-		setup_timer(0);
+	/* keepalive = 0 disables the pings */
+	if (zdsfsinfo.keepalive <= 0)
+		return;
+	rc = pthread_create(&thread, NULL, keepalive_thread, NULL);
+	if (rc) {
+		fprintf(stderr, "Error: could not start keepalive thread,"
+			" rc=%d\n", rc);
 		return;
 	}
-
-	util_list_iterate(open_dsh, s) {
-		lzds_rest_ping(s->dsh,
-			       zdsfsinfo.server[zdsfsinfo.active_server]);
-	}
-	timer_running = 1;
-	setup_timer(zdsfsinfo.keepalive);
+	pthread_detach(thread);
 }
 
-void keepalive_start(void)
+/*
+ * The thread is started with the first open and not in main, because
+ * fuse_main may fork to run in the background.
+ */
+static void keepalive_start(void)
 {
-	struct sigaction act;
-
-	if (!open_dsh || timer_running)
-		return;
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
 
-	timer_running = 1;
-	/* Setup timer for periodic ping. */
-	memset(&act, 0, sizeof(struct sigaction));
-	act.sa_handler = &keep_alive;
-	sigaction(SIGALRM, &act, NULL);
-	setup_timer(zdsfsinfo.keepalive);
+	pthread_once(&once, keepalive_init);
 }
 
-static int zdsfs_getattr(const char *path, struct stat *stbuf)
+static int __zdsfs_getattr(const char *path, struct stat *stbuf)
 {
 	char normds[MAXDSNAMELENGTH];
 	size_t dssize;
@@ -314,49 +384,68 @@ static int zdsfs_getattr(const char *path, struct stat *stbuf)
 	return 0;
 }
 
-static void zdsfs_read_device(struct dasd *newdasd, const char *device)
+static void zdsfs_reserve_devices(int reserve)
 {
+	struct dasditerator *dasdit;
 	struct errorlog *log;
+	struct dasd *dasd;
 	int rc;
 
-	rc = dasd_disk_reserve(device);
+	rc = lzds_zdsroot_alloc_dasditerator(zdsfsinfo.zdsroot, &dasdit);
 	if (rc) {
-		fprintf(stderr, "error when reserving device %s: %s\n",
-			device, strerror(rc));
-		lzds_dasd_get_errorlog(newdasd, &log);
-		lzds_errorlog_fprint(log, stderr);
+		fprintf(stderr, "could not allocate dasd iterator\n");
 		exit(1);
 	}
-	rc = lzds_dasd_alloc_rawvtoc(newdasd);
-	if (rc) {
-		fprintf(stderr, "error when reading VTOC from device %s: %s\n",
-			device, strerror(rc));
-		lzds_dasd_get_errorlog(newdasd, &log);
-		lzds_errorlog_fprint(log, stderr);
-		exit(1);
+	while (!lzds_dasditerator_get_next_dasd(dasdit, &dasd)) {
+		if (reserve)
+			rc = dasd_disk_reserve(dasd->device);
+		else
+			rc = dasd_disk_release(dasd->device);
+		if (rc) {
+			fprintf(stderr, "error when %s device %s: %s\n",
+				reserve ? "reserving" : "releasing",
+				dasd->device, strerror(rc));
+			lzds_dasd_get_errorlog(dasd, &log);
+			lzds_errorlog_fprint(log, stderr);
+			exit(1);
+		}
 	}
-	rc = lzds_zdsroot_extract_datasets_from_dasd(zdsfsinfo.zdsroot,
-						     newdasd);
+	lzds_dasditerator_free(dasdit);
+}
+
+/*
+ * Read the VTOCs of all devices and extract the data sets. The devices
+ * are scanned in parallel by libzds, so all of them are reserved for the
+ * duration of the scan.
+ */
+static void zdsfs_read_devices(void)
+{
+	struct errorlog *log;
+	int rc;
+
+	zdsfs_reserve_devices(1);
+	rc = lzds_zdsroot_extract_datasets_from_dasds(zdsfsinfo.zdsroot, 0);
 	if (rc) {
-		fprintf(stderr,
-			"error when extracting data sets from dasd %s: %s\n",
-			device, strerror(rc));
+		fprintf(stderr, "error when extracting data sets: %s\n",
+			strerror(rc));
 		lzds_zdsroot_get_errorlog(zdsfsinfo.zdsroot, &log);
 		lzds_errorlog_fprint(log, stderr);
 		exit(1);
 	}
-	rc = dasd_disk_release(device);
-	if (rc) {
-		fprintf(stderr, "error when releasing device %s: %s\n",
-			device, strerror(rc));
-		lzds_dasd_get_errorlog(newdasd, &log);
-		lzds_errorlog_fprint(log, stderr);
-		exit(1);
-	}
+	zdsfs_reserve_devices(0);
 }
 
+static int zdsfs_getattr(const char *path, struct stat *stbuf)
+{
+	int rc;
+
+	pthread_rwlock_rdlock(&zdsfsinfo.lock);
+	rc = __zdsfs_getattr(path, stbuf);
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
+}
 
-static int zdsfs_statfs(const char *UNUSED(path), struct statvfs *statvfs)
+static int __zdsfs_statfs(struct statvfs *statvfs)
 {
 	struct dasditerator *dasdit;
 	unsigned int cyls, heads;
@@ -402,35 +491,45 @@ static int zdsfs_statfs(const char *UNUSED(path), struct statvfs *statvfs)
 	return 0;
 }
 
-
-static int zdsfs_update_vtoc(void)
+static int zdsfs_statfs(const char *UNUSED(path), struct statvfs *statvfs)
 {
-	struct dasditerator *dasdit;
-	struct dasd *dasd;
 	int rc;
 
-	lzds_dslist_free(zdsfsinfo.zdsroot);
-	rc = lzds_zdsroot_alloc_dasditerator(zdsfsinfo.zdsroot, &dasdit);
-	if (rc)
-		return -ENOMEM;
+	pthread_rwlock_rdlock(&zdsfsinfo.lock);
+	rc = __zdsfs_statfs(statvfs);
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
+}
+
+/*
+ * Re-read the VTOCs of all devices. Open data set handles refer to the
+ * current data set structures, so the VTOCs are only re-read while no
+ * data set is open.
+ */
+static int zdsfs_update_vtoc(void)
+{
+	int rc = 0;
 
-	while (!lzds_dasditerator_get_next_dasd(dasdit, &dasd))
-		zdsfs_read_device(dasd, dasd->device);
+	pthread_rwlock_wrlock(&zdsfsinfo.lock);
+	if (dshtable_count(open_dsh))
+		goto out;
 
-	lzds_dasditerator_free(dasdit);
+	/* the data on the devices may have changed as well */
+	lzds_trackcache_flush(zdsfsinfo.trackcache);
+	lzds_dslist_free(zdsfsinfo.zdsroot);
+	zdsfs_read_devices();
 	rc = zdsfs_verify_datasets();
 	if (rc)
-		return rc;
+		goto out;
 
 	rc = zdsfs_create_meta_data_buffer(&zdsfsinfo);
-	if (rc)
-		return rc;
-
-	return 0;
+out:
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
 }
 
-static int zdsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-			 off_t UNUSED(offset), struct fuse_file_info *UNUSED(fi))
+static int __zdsfs_readdir(const char *path, void *buf,
+			   fuse_fill_dir_t filler)
 {
 	char normds[MAXDSNAMELENGTH];
 	char *mbrname;
@@ -442,10 +541,6 @@ static int zdsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	int rc;
 	int ispds, issupported;
 
-	rc = zdsfs_update_vtoc();
-	if (rc)
-		return rc;
-
 	/* we have two type of directories
 	 * type one: the root directory contains all data sets
 	 */
@@ -494,6 +589,21 @@ static int zdsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	return 0;
 }
 
+static int zdsfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+			 off_t UNUSED(offset), struct fuse_file_info *UNUSED(fi))
+{
+	int rc;
+
+	rc = zdsfs_update_vtoc();
+	if (rc)
+		return rc;
+
+	pthread_rwlock_rdlock(&zdsfsinfo.lock);
+	rc = __zdsfs_readdir(path, buf, filler);
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
+}
+
 /*
  * walk through the serverlist and check if the URLs start with http or https
  * if not attach a https:// prefix
@@ -532,7 +642,7 @@ static int zdsfs_test_restserver(void)
 }
 
 
-static int zdsfs_open(const char *path, struct fuse_file_info *fi)
+static int __zdsfs_open(const char *path, struct fuse_file_info *fi)
 {
 	char normds[45];
 	struct dshandle *dsh;
@@ -557,11 +667,9 @@ static int zdsfs_open(const char *path, struct fuse_file_info *fi)
 	rc = pthread_mutex_init(&zfi->mutex, NULL);
 	if (rc)
 		goto error1;
+	zfi->slot = -1;
 
 	if (strcmp(path, "/"METADATAFILE) == 0) {
-		rc = zdsfs_update_vtoc();
-		if (rc)
-			return rc;
 		zfi->dsh = NULL;
 		zfi->is_metadata_file = 1;
 		zfi->metaread = 0;
@@ -620,6 +728,22 @@ static int zdsfs_open(const char *path, struct fuse_file_info *fi)
 		rc = -rc;
 		goto error2;
 	}
+	rc = lzds_dshandle_set_readahead(dsh, zdsfsinfo.readahead);
+	if (rc) {
+		fprintf(stderr,	"Error when preparing read-ahead setting:\n");
+		lzds_dshandle_get_errorlog(dsh, &log);
+		lzds_errorlog_fprint(log, stderr);
+		rc = -rc;
+		goto error2;
+	}
+	rc = lzds_dshandle_set_trackcache(dsh, zdsfsinfo.trackcache);
+	if (rc) {
+		fprintf(stderr,	"Error when preparing track cache:\n");
+		lzds_dshandle_get_errorlog(dsh, &log);
+		lzds_errorlog_fprint(log, stderr);
+		rc = -rc;
+		goto error2;
+	}
 
 retry:
 	if (zdsfsinfo.restapi && zdsfsinfo.active_server >= 0) {
@@ -634,11 +758,11 @@ retry:
 			rc = -rc;
 			goto error2;
 		} else {
-			dshlist_add(open_dsh, dsh);
-			/* add to open dsh list */
 			keepalive_start();
 		}
 	}
+	/* add to open dsh table */
+	zfi->slot = dshtable_add(open_dsh, dsh);
 	rc = lzds_dshandle_open(dsh);
 	if (rc) {
 		fprintf(stderr,	"Error when opening data set:\n");
@@ -654,7 +778,7 @@ retry:
 	return 0;
 
 error3:
-	dshlist_remove(open_dsh, dsh);
+	dshtable_remove(open_dsh, zfi->slot);
 error2:
 	lzds_dshandle_free(dsh);
 error1:
@@ -663,6 +787,21 @@ error1:
 
 }
 
+static int zdsfs_open(const char *path, struct fuse_file_info *fi)
+{
+	int rc;
+
+	if (strcmp(path, "/"METADATAFILE) == 0) {
+		rc = zdsfs_update_vtoc();
+		if (rc)
+			return rc;
+	}
+	pthread_rwlock_rdlock(&zdsfsinfo.lock);
+	rc = __zdsfs_open(path, fi);
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
+}
+
 static int zdsfs_release(const char *UNUSED(path), struct fuse_file_info *fi)
 {
 	struct zdsfs_file_info *zfi;
@@ -672,11 +811,18 @@ static int zdsfs_release(const char *UNUSED(path), struct fuse_file_info *fi)
 		return -EINVAL;
 	zfi = (struct zdsfs_file_info *)(unsigned long)fi->fh;
 	if (zfi->dsh) {
+		/*
+		 * The handle refers to the data set structures, so keep
+		 * zdsfs_update_vtoc() from freeing them until it is freed.
+		 */
+		pthread_rwlock_rdlock(&zdsfsinfo.lock);
+		/* stop keepalive pings before the session is released */
+		dshtable_remove(open_dsh, zfi->slot);
 		lzds_rest_release_enq(zfi->dsh,
 				      zdsfsinfo.server[zdsfsinfo.active_server]);
 		lzds_dshandle_close(zfi->dsh);
-		dshlist_remove(open_dsh, zfi->dsh);
 		lzds_dshandle_free(zfi->dsh);
+		pthread_rwlock_unlock(&zdsfsinfo.lock);
 	}
 	rc = pthread_mutex_destroy(&zfi->mutex);
 	if (rc)
@@ -705,7 +851,9 @@ static int zdsfs_read(const char *UNUSED(path), char *buf, size_t size,
 	}
 	rc = 0;
 	if (zfi->is_metadata_file) {
+		pthread_rwlock_rdlock(&zdsfsinfo.lock);
 		if (zfi->metaread >= zdsfsinfo.metaused) {
+			pthread_rwlock_unlock(&zdsfsinfo.lock);
 			pthread_mutex_unlock(&zfi->mutex);
 			return 0;
 		}
@@ -714,6 +862,7 @@ static int zdsfs_read(const char *UNUSED(path), char *buf, size_t size,
 			count = size;
 		memcpy(buf, &zdsfsinfo.metadata[zfi->metaread], count);
 		zfi->metaread += count;
+		pthread_rwlock_unlock(&zdsfsinfo.lock);
 	} else {
 		lzds_dshandle_get_offset(zfi->dsh, &rcoffset);
 		if (rcoffset != offset)
@@ -739,14 +888,54 @@ static int zdsfs_read(const char *UNUSED(path), char *buf, size_t size,
 #define RECFMXATTR "user.recfm"
 #define LRECLXATTR "user.lrecl"
 #define DSORGXATTR "user.dsorg"
+#define CACHEXATTR "user.trackcache"
+
+/* the root directory has statistics of the track cache, if there is one */
+static int zdsfs_listxattr_root(char *list, size_t size)
+{
+	size_t list_len;
+
+	if (!zdsfsinfo.trackcache)
+		return 0;
+	list_len = strlen(CACHEXATTR) + 1;
+	if (!size)
+		return list_len;
+	if (size < list_len)
+		return -ERANGE;
+	strcpy(list, CACHEXATTR);
+	return list_len;
+}
+
+static int zdsfs_getxattr_root(const char *name, char *value, size_t size)
+{
+	unsigned long long hits, misses, rate;
+	char buffer[80];
+	size_t length;
+
+	if (!zdsfsinfo.trackcache || strcmp(name, CACHEXATTR))
+		return -ENODATA;
+	lzds_trackcache_get_stats(zdsfsinfo.trackcache, &hits, &misses);
+	rate = (hits + misses) ? (100 * hits) / (hits + misses) : 0;
+	snprintf(buffer, sizeof(buffer), "hits=%llu,misses=%llu,hitrate=%llu%%",
+		 hits, misses, rate);
+	length = strlen(buffer);
+	if (size == 0)
+		return length;
+	if (size < length)
+		return -ERANGE;
+	memcpy(value, buffer, length);
+	return length;
+}
 
 static int zdsfs_listxattr(const char *path, char *list, size_t size)
 {
 	int pos = 0;
 	size_t list_len;
 
-	/* root directory and the metadata have no extended attributes */
-	if (!strcmp(path, "/") || !strcmp(path, "/"METADATAFILE))
+	if (!strcmp(path, "/"))
+		return zdsfs_listxattr_root(list, size);
+	/* the metadata file has no extended attributes */
+	if (!strcmp(path, "/"METADATAFILE))
 		return 0;
 
 	list_len = strlen(RECFMXATTR) + 1 +
@@ -766,8 +955,8 @@ static int zdsfs_listxattr(const char *path, char *list, size_t size)
 	return pos;
 }
 
-static int zdsfs_getxattr(const char *path, const char *name, char *value,
-			  size_t size)
+static int __zdsfs_getxattr(const char *path, const char *name, char *value,
+			    size_t size)
 {
 	char normds[45];
 	struct dataset *ds;
@@ -777,8 +966,10 @@ static int zdsfs_getxattr(const char *path, const char *name, char *value,
 	size_t length;
 	int ispds;
 
-	/* nothing for root directory but clear error code needed */
-	if (!strcmp(path, "/") || !strcmp(path, "/"METADATAFILE))
+	if (!strcmp(path, "/"))
+		return zdsfs_getxattr_root(name, value, size);
+	/* nothing for meta data file but clear error code needed */
+	if (!strcmp(path, "/"METADATAFILE))
 		return -ENODATA;
 
 	path_to_ds_name(path, normds, sizeof(normds));
@@ -821,6 +1012,17 @@ static int zdsfs_getxattr(const char *path, const char *name, char *value,
 
 }
 
+static int zdsfs_getxattr(const char *path, const char *name, char *value,
+			  size_t size)
+{
+	int rc;
+
+	pthread_rwlock_rdlock(&zdsfsinfo.lock);
+	rc = __zdsfs_getxattr(path, name, value, size);
+	pthread_rwlock_unlock(&zdsfsinfo.lock);
+	return rc;
+}
+
 #endif /* HAVE_SETXATTR */
 
 
@@ -1011,6 +1213,7 @@ enum {
 	KEY_DEVFILE,
 	KEY_TRACKS,
 	KEY_SEEKBUFFER,
+	KEY_TRACKCACHE,
 	KEY_CONFIG,
 	KEY_SERVER,
 };
@@ -1025,9 +1228,11 @@ static const struct fuse_opt zdsfs_opts[] = {
 	FUSE_OPT_KEY("-l %s",		KEY_DEVFILE),
 	FUSE_OPT_KEY("tracks=",         KEY_TRACKS),
 	FUSE_OPT_KEY("seekbuffer=",     KEY_SEEKBUFFER),
+	FUSE_OPT_KEY("trackcache=",     KEY_TRACKCACHE),
 	FUSE_OPT_KEY("-c %s",           KEY_CONFIG),
 	FUSE_OPT_KEY("restserver=",     KEY_SERVER),
 	ZDSFS_OPT("rdw",                keepRDW, 1),
+	ZDSFS_OPT("readahead",          readahead, 1),
 	ZDSFS_OPT("ignore_incomplete",  allow_inclomplete_multi_volume, 1),
 	ZDSFS_OPT("check_host_count",   host_count, 1),
 	ZDSFS_OPT("restapi",            restapi, 1),
@@ -1057,8 +1262,11 @@ static void usage(const char *progname)
 " volume\n"
 "                           data set are missing\n"
 "    -o tracks=N            Size of the track buffer in tracks (default 128)\n"
+"    -o readahead           Read the next track buffer in advance\n"
 "    -o seekbuffer=S        Upper limit in bytes for the seek history buffer\n"
 "                           size (default 1048576)\n"
+"    -o trackcache=S        Size in bytes of the track cache that is shared\n"
+"                           by all open files (default 0, no cache)\n"
 "    -o check_host_count    Stop processing if the device is used by another\n"
 "                           operating system instance\n"
 "    -o restapi             Enable using z/OSMF REST services for coordinated\n"
@@ -1091,7 +1299,6 @@ static void zdsfs_process_device(const char *device)
 		lzds_errorlog_fprint(log, stderr);
 		exit(1);
 	}
-	zdsfs_read_device(newdasd, device);
 }
 
 static void zdsfs_process_device_file(const char *devfile)
@@ -1230,7 +1437,7 @@ static int zdsfs_process_args(void *UNUSED(data), const char *arg, int key,
 {
 	struct stat sb;
 	unsigned long tracks_per_frame;
-	unsigned long long seek_buffer_size;
+	unsigned long long seek_buffer_size, trackcache_size;
 	const char *value;
 	char *endptr;
 
@@ -1288,6 +1495,22 @@ static int zdsfs_process_args(void *UNUSED(data), const char *arg, int key,
 		}
 		zdsfsinfo.seek_buffer_size = seek_buffer_size;
 		return 0;
+	case KEY_TRACKCACHE:
+		value = arg + strlen("trackcache=");
+		/* strtoull does not complain about negative values  */
+		if (*value == '-') {
+			errno = EINVAL;
+		} else {
+			errno = 0;
+			trackcache_size = strtoull(value, &endptr, 10);
+		}
+		if (errno || (endptr && (*endptr != '\0'))) {
+			fprintf(stderr,	"Invalid value '%s' for option "
+				"'trackcache'\n", value);
+			exit(1);
+		}
+		zdsfsinfo.trackcache_size = trackcache_size;
+		return 0;
 	case KEY_HELP:
 		usage(outargs->argv[0]);
 
@@ -1333,7 +1556,6 @@ int main(int argc, char *argv[])
 	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
 	int rc;
 
-	timer_running = 0;
 	bzero(&zdsfsinfo, sizeof(zdsfsinfo));
 	zdsfsinfo.keepRDW = 0;
 	zdsfsinfo.allow_inclomplete_multi_volume = 0;
@@ -1344,7 +1566,8 @@ int main(int argc, char *argv[])
 	zdsfsinfo.active_server = -1;
 
 	rc = lzds_zdsroot_alloc(&zdsfsinfo.zdsroot);
-	open_dsh = dshlist_alloc();
+	open_dsh = dshtable_alloc();
+	pthread_rwlock_init(&zdsfsinfo.lock, NULL);
 	if (rc) {
 		fprintf(stderr, "Could not allocate internal structures\n");
 		exit(1);
@@ -1362,6 +1585,17 @@ int main(int argc, char *argv[])
 			argv[0]);
 		exit(1);
 	}
+	zdsfs_read_devices();
+
+	if (zdsfsinfo.trackcache_size) {
+		rc = lzds_trackcache_alloc(zdsfsinfo.trackcache_size,
+					   &zdsfsinfo.trackcache);
+		if (rc) {
+			fprintf(stderr, "Could not allocate track cache: %s\n",
+				strerror(rc));
+			exit(1);
+		}
+	}
 
 	if (zdsfsinfo.host_count) {
 		/* check, print error and exit if multiple online */
@@ -1395,7 +1629,9 @@ int main(int argc, char *argv[])
 
 cleanup:
 	curl_global_cleanup();
-	dshlist_free(open_dsh);
+	dshtable_free(open_dsh);
+	lzds_trackcache_free(zdsfsinfo.trackcache);
+	pthread_rwlock_destroy(&zdsfsinfo.lock);
 	lzds_zdsroot_free(zdsfsinfo.zdsroot);
 
 	fuse_opt_free_args(&args);
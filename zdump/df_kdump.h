@@ -0,0 +1,100 @@
+/*
+ * zgetdump - Tool for copying and converting System z dumps
+ *
+ * kdump (diskdump) dump format definitions
+ *
+ * Copyright IBM Corp. 2001, 2017
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef DF_KDUMP_H
+#define DF_KDUMP_H
+
+#include <linux/utsname.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "lib/zt_common.h"
+
+#define DF_KDUMP_SIGNATURE	"KDUMP   "
+#define DF_KDUMP_HDR_VERSION	6
+
+/*
+ * Page compression flags
+ */
+#define DF_KDUMP_DH_COMPRESSED_ZLIB	0x1
+#define DF_KDUMP_DH_COMPRESSED_LZO	0x2
+#define DF_KDUMP_DH_COMPRESSED_SNAPPY	0x4
+#define DF_KDUMP_DH_COMPRESSED_ZSTD	0x20
+
+/*
+ * kdump (diskdump) dump header
+ */
+struct df_kdump_hdr {
+	char			signature[8];
+	int			header_version;
+	struct new_utsname	utsname;
+	struct timeval		timestamp;
+	unsigned int		status;
+	int			block_size;
+	int			sub_hdr_size;
+	unsigned int		bitmap_blocks;
+	unsigned int		max_mapnr;
+	unsigned int		total_ram_blocks;
+	unsigned int		device_blocks;
+	unsigned int		written_blocks;
+	unsigned int		current_cpu;
+	int			nr_cpus;
+	void			*tasks[0];
+};
+
+/*
+ * kdump sub header
+ */
+struct df_kdump_sub_hdr {
+	unsigned long	phys_base;
+	int		dump_level;
+	int		split;
+	unsigned long	start_pfn;
+	unsigned long	end_pfn;
+	off_t		offset_vmcoreinfo;
+	unsigned long	size_vmcoreinfo;
+	/* header_version 4 and later */
+	off_t		offset_note;
+	unsigned long	size_note;
+	/* header_version 5 and later */
+	off_t		offset_eraseinfo;
+	unsigned long	size_eraseinfo;
+	/* header_version 6 and later */
+	u64		start_pfn_64;
+	u64		end_pfn_64;
+	u64		max_mapnr_64;
+};
+
+/*
+ * kdump page descriptor
+ */
+struct df_kdump_page_desc {
+	off_t		offset;		/* Offset of page data */
+	unsigned int	size;		/* Size of page data */
+	unsigned int	flags;		/* Compression flags */
+	u64		page_flags;	/* Page flags */
+};
+
+/*
+ * kdump_flat (makedumpfile flattened format) headers
+ */
+struct df_kdump_flat_hdr {
+	char	signature[16];
+	u64	type;
+	u64	version;
+};
+
+struct df_kdump_flat_data_hdr {
+	s64	offs;
+	s64	size;
+};
+
+#endif /* DF_KDUMP_H */
@@ -47,6 +47,15 @@ struct cpus {
 	unsigned int		cnt;
 };
 
+/*
+ * Memory chunk index entry
+ */
+struct mem_index {
+	struct dfi_mem_chunk	*chunk;		/* Memory chunk */
+	u64			end_max;	/* Highest end address up to here */
+	unsigned int		pos;		/* Position in chunk list */
+};
+
 /*
  * Memory information
  */
@@ -56,6 +65,9 @@ struct mem {
 	u64			end_addr;
 	unsigned int		chunk_cnt;
 	struct util_list	chunk_list;
+	struct mem_index	*chunk_vec;
+	unsigned int		chunk_vec_cnt;
+	int			chunk_vec_valid;
 };
 
 /*
@@ -130,6 +142,57 @@ static int mem_chunk_cmp_fn(void *a, void *b, void *UNUSED(data))
 	return mem_chunk1->start < mem_chunk2->start ? -1 : 1;
 }
 
+/*
+ * Memory chunk compare function for index sorting
+ */
+static int mem_chunk_vec_cmp_fn(const void *a, const void *b)
+{
+	const struct mem_index *index1 = a;
+	const struct mem_index *index2 = b;
+
+	if (index1->chunk->start != index2->chunk->start)
+		return index1->chunk->start < index2->chunk->start ? -1 : 1;
+	/* qsort() is not stable: Keep list order for equal start addresses */
+	return index1->pos < index2->pos ? -1 : 1;
+}
+
+/*
+ * Build index of memory chunks sorted by start address
+ *
+ * The index points into the chunk list so that the list order (which is
+ * visible via dfi_mem_chunk_iterate()) is not changed. For each index
+ * position we also remember the highest end address of all chunks up to
+ * that position. This allows to handle overlapping chunks.
+ */
+static void mem_index_build(struct mem *mem)
+{
+	struct dfi_mem_chunk *mem_chunk;
+	unsigned int i = 0;
+	u64 end_max;
+
+	zg_free(mem->chunk_vec);
+	mem->chunk_vec = NULL;
+	mem->chunk_vec_cnt = 0;
+	if (mem->chunk_cnt) {
+		mem->chunk_vec = zg_alloc(mem->chunk_cnt *
+					  sizeof(mem->chunk_vec[0]));
+		util_list_iterate(&mem->chunk_list, mem_chunk) {
+			mem->chunk_vec[i].chunk = mem_chunk;
+			mem->chunk_vec[i].pos = i;
+			i++;
+		}
+		qsort(mem->chunk_vec, i, sizeof(mem->chunk_vec[0]),
+		      mem_chunk_vec_cmp_fn);
+		mem->chunk_vec_cnt = i;
+		end_max = 0;
+		for (i = 0; i < mem->chunk_vec_cnt; i++) {
+			end_max = MAX(end_max, mem->chunk_vec[i].chunk->end);
+			mem->chunk_vec[i].end_max = end_max;
+		}
+	}
+	mem->chunk_vec_valid = 1;
+}
+
 /*
  * Update DFI memory chunks
  */
@@ -144,6 +207,7 @@ static void mem_update(struct mem *mem)
 		mem->start_addr = MIN(mem->start_addr, mem_chunk->start);
 		mem->end_addr = MAX(mem->end_addr, mem_chunk->end);
 	}
+	mem_index_build(mem);
 }
 
 /*
@@ -296,6 +360,7 @@ static void mem_chunk_create(struct mem *mem, u64 start, u64 size, void *data,
 	mem->end_addr = MAX(mem->end_addr, mem_chunk->end);
 	mem->chunk_cache = mem_chunk;
 	mem->chunk_cnt++;
+	mem->chunk_vec_valid = 0;
 }
 
 /*
@@ -308,20 +373,41 @@ static int mem_chunk_has_addr(struct dfi_mem_chunk *mem_chunk, u64 addr)
 
 /*
  * Find memory chunk that contains address
+ *
+ * Use binary search on the sorted chunk index: Find the last chunk that
+ * starts at or below the address and check if it contains the address.
+ * Only if chunks overlap, we have to look at preceding chunks. Then, like
+ * a walk through the chunk list, return the first chunk in list order.
  */
 static struct dfi_mem_chunk *mem_chunk_find(struct mem *mem, u64 addr)
 {
-	struct dfi_mem_chunk *mem_chunk;
+	struct mem_index *index, *found = NULL;
+	unsigned int lo, hi, mid;
 
-	if (mem_chunk_has_addr(mem->chunk_cache, addr))
+	if (mem->chunk_cache && mem_chunk_has_addr(mem->chunk_cache, addr))
 		return mem->chunk_cache;
-	util_list_iterate(&mem->chunk_list, mem_chunk) {
-		if (mem_chunk_has_addr(mem_chunk, addr)) {
-			mem->chunk_cache = mem_chunk;
-			return mem_chunk;
-		}
+	if (!mem->chunk_vec_valid)
+		mem_index_build(mem);
+	lo = 0;
+	hi = mem->chunk_vec_cnt;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (mem->chunk_vec[mid].chunk->start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	return NULL;
+	while (lo > 0 && mem->chunk_vec[lo - 1].end_max >= addr) {
+		index = &mem->chunk_vec[--lo];
+		if (!mem_chunk_has_addr(index->chunk, addr))
+			continue;
+		if (!found || index->pos < found->pos)
+			found = index;
+	}
+	if (!found)
+		return NULL;
+	mem->chunk_cache = found->chunk;
+	return found->chunk;
 }
 
 /*
@@ -1046,6 +1132,9 @@ static void mem_unmap(u64 start, u64 size)
 free:
 		util_list_remove(&l.mem_virt.chunk_list, mem_chunk);
 		l.mem_virt.chunk_cnt--;
+		l.mem_virt.chunk_vec_valid = 0;
+		if (l.mem_virt.chunk_cache == mem_chunk)
+			l.mem_virt.chunk_cache = NULL;
 		if (mem_chunk->data && mem_chunk->free_fn)
 			mem_chunk->free_fn(mem_chunk->data);
 		zg_free(mem_chunk);
@@ -0,0 +1,170 @@
+/*
+ * zgetdump - Tool for copying and converting System z dumps
+ *
+ * Benchmark for the DFI memory chunk lookup
+ *
+ * Build a memory map with many chunks and replay a random address trace
+ * against mem_chunk_find() and against the previous walk through the
+ * chunk list. Both lookups must return the same chunks.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <time.h>
+
+/* Include the DFI code to get access to the static lookup functions */
+#include "dfi.c"
+
+#define DEFAULT_COUNT	100000
+#define TRACE_LEN	1000000
+#define LIST_TRACE_LEN	1000
+#define CHUNK_SIZE	0x100000ULL
+
+struct zgetdump_globals g;
+
+static struct timespec start_ts;
+
+static void timer_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+}
+
+static void timer_report(const char *name, unsigned long count)
+{
+	struct timespec ts;
+	double sec;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sec = (ts.tv_sec - start_ts.tv_sec) +
+		(ts.tv_nsec - start_ts.tv_nsec) / 1e9;
+	printf("%-28s %10lu %10.3f s %8.0f ns/op\n", name, count, sec,
+	       sec * 1e9 / count);
+	fflush(stdout);
+}
+
+/*
+ * Return first chunk in the chunk list that contains address
+ */
+static struct dfi_mem_chunk *mem_chunk_walk(struct mem *mem, u64 addr)
+{
+	struct dfi_mem_chunk *mem_chunk;
+
+	util_list_iterate(&mem->chunk_list, mem_chunk) {
+		if (mem_chunk_has_addr(mem_chunk, addr))
+			return mem_chunk;
+	}
+	return NULL;
+}
+
+/*
+ * Find memory chunk by walking the chunk list (the previous algorithm)
+ */
+static struct dfi_mem_chunk *mem_chunk_find_list(struct mem *mem, u64 addr)
+{
+	static struct dfi_mem_chunk *chunk_cache;
+	struct dfi_mem_chunk *mem_chunk;
+
+	if (chunk_cache && mem_chunk_has_addr(chunk_cache, addr))
+		return chunk_cache;
+	mem_chunk = mem_chunk_walk(mem, addr);
+	if (mem_chunk)
+		chunk_cache = mem_chunk;
+	return mem_chunk;
+}
+
+/*
+ * Add "count" chunks in random order with holes between them. Every
+ * 100th chunk is duplicated and every 1000th chunk overlaps its successor.
+ * Some chunks are added after mem_update() and are therefore not in
+ * address order in the chunk list.
+ */
+static void mem_build(struct mem *mem, unsigned long count)
+{
+	unsigned long i, j, tmp, *order;
+	u64 start, size;
+
+	order = zg_alloc(count * sizeof(*order));
+	for (i = 0; i < count; i++)
+		order[i] = i;
+	for (i = count - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	for (i = 0; i < count; i++) {
+		start = order[i] * 2 * CHUNK_SIZE;
+		size = CHUNK_SIZE;
+		if (order[i] % 1000 == 0)
+			size = 3 * CHUNK_SIZE;
+		mem_chunk_create(mem, start, size, NULL,
+				 dfi_mem_chunk_read_zero, NULL);
+		if (order[i] % 100 == 0)
+			mem_chunk_create(mem, start, size / 2, NULL,
+					 dfi_mem_chunk_read_zero, NULL);
+	}
+	zg_free(order);
+	mem_update(mem);
+	for (i = 0; i < count; i += count / 10 + 1)
+		mem_chunk_create(mem, i * 2 * CHUNK_SIZE, 2 * CHUNK_SIZE, NULL,
+				 dfi_mem_chunk_read_zero, NULL);
+}
+
+/*
+ * Replay a random address trace against both lookups
+ */
+int main(int argc, char *argv[])
+{
+	unsigned long count = DEFAULT_COUNT, found, i;
+	u64 *trace, range;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (!count) {
+		fprintf(stderr, "Usage: %s [COUNT]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	srand(1);
+	mem_init(&l.mem_virt);
+	timer_start();
+	mem_build(&l.mem_virt, count);
+	timer_report("mem_chunk_create+index", l.mem_virt.chunk_cnt);
+
+	range = l.mem_virt.end_addr + CHUNK_SIZE;
+	trace = zg_alloc(TRACE_LEN * sizeof(*trace));
+	for (i = 0; i < TRACE_LEN; i++)
+		trace[i] = (((u64) rand() << 31) | rand()) % range;
+
+	found = 0;
+	timer_start();
+	for (i = 0; i < TRACE_LEN; i++) {
+		if (mem_chunk_find(&l.mem_virt, trace[i]))
+			found++;
+	}
+	timer_report("mem_chunk_find index", TRACE_LEN);
+
+	timer_start();
+	for (i = 0; i < LIST_TRACE_LEN; i++) {
+		if (mem_chunk_find_list(&l.mem_virt, trace[i]))
+			found++;
+	}
+	timer_report("mem_chunk_find list", LIST_TRACE_LEN);
+	printf("%lu of %d addresses found\n", found,
+	       TRACE_LEN + LIST_TRACE_LEN);
+
+	/* Without the caches both lookups must return the same chunk */
+	for (i = 0; i < LIST_TRACE_LEN; i++) {
+		l.mem_virt.chunk_cache = NULL;
+		if (mem_chunk_find(&l.mem_virt, trace[i]) !=
+		    mem_chunk_walk(&l.mem_virt, trace[i])) {
+			fprintf(stderr, "Lookup mismatch for address %llx\n",
+				trace[i]);
+			return EXIT_FAILURE;
+		}
+	}
+	zg_free(trace);
+	return EXIT_SUCCESS;
+}
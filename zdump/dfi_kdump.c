@@ -11,45 +11,6 @@
 
 #include "zgetdump.h"
 
-struct df_kdump_hdr {
-	char			signature[8];
-	int			header_version;
-	struct new_utsname	utsname;
-	struct timeval		timestamp;
-	unsigned int		status;
-	int			block_size;
-	int			sub_hdr_size;
-	unsigned int		bitmap_blocks;
-	unsigned int		max_mapnr;
-	unsigned int		total_ram_blocks;
-	unsigned int		device_blocks;
-	unsigned int		written_blocks;
-	unsigned int		current_cpu;
-	int			nr_cpus;
-	void			*tasks[0];
-};
-
-struct df_kdump_sub_hdr {
-	unsigned long	phys_base;
-	int		dump_level;
-	int		split;
-	unsigned long	start_pfn;
-	unsigned long	end_pfn;
-	off_t		offset_vmcoreinfo;
-	unsigned long	size_vmcoreinfo;
-};
-
-struct df_kdump_flat_hdr {
-	char	signature[16];
-	u64	type;
-	u64	version;
-};
-
-struct df_kdump_flat_data_hdr {
-	s64	offs;
-	s64	size;
-};
-
 /*
  * File local static data
  */
@@ -21,9 +21,19 @@
 static struct dfo *dfo_vec[] = {
 	&dfo_s390,
 	&dfo_elf,
+	&dfo_kdump,
 	NULL,
 };
 
+/*
+ * Dump segment: Part of the dump that is read from one DFO chunk
+ */
+struct dump_seg {
+	u64			start;	/* Start offset in dump */
+	u64			end;	/* Virtual end offset of chunk */
+	struct dfo_chunk	*chunk;	/* Visible chunk */
+};
+
 /*
  * Dump (output) information
  */
@@ -32,6 +42,9 @@ struct dump {
 	u64		size;		/* Size of dump in bytes */
 	unsigned int	chunk_cnt;	/* Number of dump chunks */
 	struct util_list	chunk_list;	/* DFO chunk list */
+	struct dump_seg	*seg_vec;	/* Sorted segment index */
+	unsigned int	seg_cnt;	/* Number of dump segments */
+	int		seg_valid;	/* Segment index is up to date */
 };
 
 /*
@@ -56,6 +69,7 @@ void dfo_chunk_add(u64 start, u64 size, void *data, dfo_chunk_read_fn read_fn)
 	dfo_chunk->read_fn = read_fn;
 	util_list_add_head(&l.dump.chunk_list, dfo_chunk);
 	l.dump.chunk_cnt++;
+	l.dump.seg_valid = 0;
 	l.dump.size = MAX(l.dump.size, dfo_chunk->end + 1);
 }
 
@@ -126,42 +140,217 @@ void dfo_init(void)
 }
 
 /*
- * Find dump chunk for offset "off"
- *
- * This function is a bit hacky. DFO chunks can overlap. If two DFO chunks
- * overlap, the last registered chunk wins. The dfo_chunk_find() function
- * reflects that by returning the first memory chunk that is found in
- * the dfo chunk list.
+ * Cleanup output dump format
+ */
+void dfo_exit(void)
+{
+	if (l.dfo && l.dfo->exit)
+		l.dfo->exit();
+}
+
+/*
+ * Compare function for sorting dump offsets
+ */
+static int off_cmp_fn(const void *a, const void *b)
+{
+	u64 off1 = *(const u64 *) a, off2 = *(const u64 *) b;
+
+	if (off1 < off2)
+		return -1;
+	return off1 > off2 ? 1 : 0;
+}
+
+/*
+ * DFO chunk with priority (index in chunk list, 0 is the newest chunk)
+ */
+struct chunk_ref {
+	struct dfo_chunk	*chunk;
+	unsigned int		prio;
+};
+
+/*
+ * Compare function for sorting DFO chunks by start offset
+ */
+static int chunk_ref_cmp_fn(const void *a, const void *b)
+{
+	const struct chunk_ref *ref1 = a, *ref2 = b;
+
+	if (ref1->chunk->start < ref2->chunk->start)
+		return -1;
+	return ref1->chunk->start > ref2->chunk->start ? 1 : 0;
+}
+
+/*
+ * Min-heap of chunk priorities
+ */
+struct prio_heap {
+	unsigned int	*vec;
+	unsigned int	cnt;
+};
+
+static void prio_heap_push(struct prio_heap *heap, unsigned int prio)
+{
+	unsigned int i = heap->cnt++, parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (heap->vec[parent] <= prio)
+			break;
+		heap->vec[i] = heap->vec[parent];
+		i = parent;
+	}
+	heap->vec[i] = prio;
+}
+
+static void prio_heap_pop(struct prio_heap *heap)
+{
+	unsigned int i = 0, child, last = heap->vec[--heap->cnt];
+
+	while ((child = 2 * i + 1) < heap->cnt) {
+		if (child + 1 < heap->cnt && heap->vec[child + 1] <
+		    heap->vec[child])
+			child++;
+		if (last <= heap->vec[child])
+			break;
+		heap->vec[i] = heap->vec[child];
+		i = child;
+	}
+	heap->vec[i] = last;
+}
+
+/*
+ * Add segment to segment index and merge it with the previous one if
+ * possible
+ */
+static void seg_add(u64 start, u64 end, struct dfo_chunk *chunk)
+{
+	struct dump_seg *seg;
+
+	if (l.dump.seg_cnt) {
+		seg = &l.dump.seg_vec[l.dump.seg_cnt - 1];
+		if (seg->chunk == chunk && seg->end + 1 == start) {
+			seg->end = end;
+			return;
+		}
+	}
+	seg = &l.dump.seg_vec[l.dump.seg_cnt++];
+	seg->start = start;
+	seg->end = end;
+	seg->chunk = chunk;
+}
+
+/*
+ * Build sorted segment index for DFO chunks
  *
- * In addition to that it calculates the "virtual end" of that chunk. An
- * overlapping chunk can limit the "virtual end" of an underlying chunk so
- * that the "virtual end" of that chunk is lower than the "real end".
+ * DFO chunks can overlap. If two DFO chunks overlap, the last registered
+ * chunk wins. An overlapping chunk can limit the "virtual end" of an
+ * underlying chunk so that the "virtual end" of that chunk is lower than
+ * the "real end".
  *
  * Example:
  *
  * chunk 1.:      |------|
  * chunk 2.: |---------------------|
- * off.....: ^
- * virt end:      ^
- * real end:                       ^
+ * segments: |2222|111111|222222222|
  *
- * In this case chunk 2 will be returned and "end" is set to the start of
- * chunk 1.
+ * To resolve this, all chunk boundaries are sorted and swept in ascending
+ * order while the chunks that cover the current offset are kept in a heap
+ * ordered by registration time. Each segment between two boundaries gets
+ * the newest covering chunk. Offsets that are not covered by any chunk do
+ * not get a segment.
  */
-static struct dfo_chunk *dfo_chunk_find(u64 off, u64 *end)
+static void seg_index_build(void)
 {
-	struct dfo_chunk *dfo_chunk;
+	unsigned int i, j, chunk_cnt = l.dump.chunk_cnt, off_cnt = 0;
+	struct dfo_chunk **prio_vec, *dfo_chunk;
+	struct chunk_ref *start_vec;
+	struct prio_heap heap;
+	u64 *off_vec, start;
 
-	*end = U64_MAX;
+	zg_free(l.dump.seg_vec);
+	l.dump.seg_vec = NULL;
+	l.dump.seg_cnt = 0;
+	l.dump.seg_valid = 1;
+	if (chunk_cnt == 0)
+		return;
+
+	prio_vec = zg_alloc(chunk_cnt * sizeof(prio_vec[0]));
+	start_vec = zg_alloc(chunk_cnt * sizeof(start_vec[0]));
+	off_vec = zg_alloc(2 * chunk_cnt * sizeof(off_vec[0]));
+	heap.vec = zg_alloc(chunk_cnt * sizeof(heap.vec[0]));
+	heap.cnt = 0;
+
+	i = 0;
 	dfo_chunk_iterate(dfo_chunk) {
-		if (dfo_chunk->start <= off && dfo_chunk->end >= off) {
-			*end = MIN(*end, dfo_chunk->end);
-			return dfo_chunk;
-		} else if (dfo_chunk->start > off) {
-			*end = MIN(*end, dfo_chunk->start - 1);
-		}
+		prio_vec[i] = dfo_chunk;
+		start_vec[i].chunk = dfo_chunk;
+		start_vec[i].prio = i;
+		off_vec[off_cnt++] = dfo_chunk->start;
+		if (dfo_chunk->end != U64_MAX)
+			off_vec[off_cnt++] = dfo_chunk->end + 1;
+		i++;
+	}
+	chunk_cnt = i;
+	qsort(start_vec, chunk_cnt, sizeof(start_vec[0]), chunk_ref_cmp_fn);
+	qsort(off_vec, off_cnt, sizeof(off_vec[0]), off_cmp_fn);
+	/* Remove duplicate boundaries */
+	for (i = 1, j = 1; i < off_cnt; i++) {
+		if (off_vec[i] != off_vec[j - 1])
+			off_vec[j++] = off_vec[i];
+	}
+	off_cnt = j;
+	l.dump.seg_vec = zg_alloc(off_cnt * sizeof(l.dump.seg_vec[0]));
+
+	j = 0;
+	for (i = 0; i < off_cnt; i++) {
+		start = off_vec[i];
+		/* Add all chunks that start at this boundary */
+		for (; j < chunk_cnt && start_vec[j].chunk->start == start; j++)
+			prio_heap_push(&heap, start_vec[j].prio);
+		/* Remove newest chunks that ended before this boundary */
+		while (heap.cnt && prio_vec[heap.vec[0]]->end < start)
+			prio_heap_pop(&heap);
+		if (!heap.cnt)
+			continue;
+		dfo_chunk = prio_vec[heap.vec[0]];
+		seg_add(start, i + 1 < off_cnt ? off_vec[i + 1] - 1 : U64_MAX,
+			dfo_chunk);
+	}
+	zg_free(heap.vec);
+	zg_free(off_vec);
+	zg_free(start_vec);
+	zg_free(prio_vec);
+}
+
+/*
+ * Find dump chunk for offset "off"
+ *
+ * Use binary search on the segment index to find the chunk that is visible
+ * at offset "off". In addition to that return the "virtual end" of that
+ * chunk which is the end of the segment.
+ */
+static struct dfo_chunk *dfo_chunk_find(u64 off, u64 *end)
+{
+	unsigned int lo = 0, hi, mid;
+	struct dump_seg *seg;
+
+	if (!l.dump.seg_valid)
+		seg_index_build();
+	hi = l.dump.seg_cnt;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (l.dump.seg_vec[mid].start <= off)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	return NULL;
+	if (lo == 0)
+		return NULL;
+	seg = &l.dump.seg_vec[lo - 1];
+	if (seg->end < off)
+		return NULL;
+	*end = seg->end;
+	return seg->chunk;
 }
 
 /*
@@ -42,14 +42,22 @@ extern void dfo_seek(u64 addr);
 extern u64 dfo_size(void);
 extern const char *dfo_name(void);
 extern void dfo_init(void);
+extern void dfo_exit(void);
 extern int dfo_set(const char *dfo_name);
 
+/*
+ * ELF notes (also used by other DFOs)
+ */
+extern u32 dfo_elf_notes_size_max(void);
+extern void *dfo_elf_notes_write(void *ptr);
+
 /*
  * DFO operations
  */
 struct dfo {
 	const char	*name;
 	void		(*init)(void);
+	void		(*exit)(void);
 };
 
 #endif /* DFO_H */
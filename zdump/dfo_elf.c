@@ -236,11 +236,18 @@ static void *nt_vmcoreinfo(void *ptr)
 }
 
 /*
- * Initialize notes
+ * Return maximum size of notes
  */
-static void *notes_init(Elf64_Phdr *phdr, void *ptr, u64 notes_offset)
+u32 dfo_elf_notes_size_max(void)
+{
+	return HDR_BASE_SIZE + dfi_cpu_cnt() * HDR_PER_CPU_SIZE;
+}
+
+/*
+ * Write notes for CPUs and vmcoreinfo to "ptr" and return end of notes
+ */
+void *dfo_elf_notes_write(void *ptr)
 {
-	void *ptr_start = ptr;
 	struct dfi_cpu *cpu;
 
 	ptr = nt_prpsinfo(ptr);
@@ -262,7 +269,17 @@ static void *notes_init(Elf64_Phdr *phdr, void *ptr, u64 notes_offset)
 		}
 	}
 out:
-	ptr = nt_vmcoreinfo(ptr);
+	return nt_vmcoreinfo(ptr);
+}
+
+/*
+ * Initialize notes
+ */
+static void *notes_init(Elf64_Phdr *phdr, void *ptr, u64 notes_offset)
+{
+	void *ptr_start = ptr;
+
+	ptr = dfo_elf_notes_write(ptr);
 	memset(phdr, 0, sizeof(*phdr));
 	phdr->p_type = PT_NOTE;
 	phdr->p_offset = notes_offset;
@@ -0,0 +1,762 @@
+/*
+ * zgetdump - Tool for copying and converting System z dumps
+ *
+ * kdump (diskdump) compressed output format
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "zgetdump.h"
+
+#define BLOCK_SIZE		PAGE_SIZE
+#define GROUP_PAGES		1024	/* Pages per group */
+#define THREADS_MAX		64	/* Maximum compression threads */
+#define CHUNK_PAGES		32	/* Pages per compression work item */
+
+#define DIV_UP(x, y)		(((x) + (y) - 1) / (y))
+
+/*
+ * Page size values for page size array
+ */
+#define PAGE_EXCLUDED		0x0000	/* Page is not in dump */
+#define PAGE_PRESENT		0xfffe	/* Page is in dump */
+#define PAGE_ZERO		0xffff	/* Page contains only zeros */
+
+/*
+ * Group of GROUP_PAGES consecutive pages
+ */
+struct group {
+	u64	desc_idx;	/* Index of first page descriptor */
+	u64	data_off;	/* Offset of first page data in group */
+	u16	*size;		/* Size of page data or PAGE_xxx */
+};
+
+/*
+ * Compressed data of one group
+ */
+struct cache {
+	u64	group_nr;		/* Cached group number */
+	int	valid;			/* Cache contains data */
+	char	*raw;			/* Uncompressed pages */
+	char	*data;			/* Compressed pages */
+	u16	size[GROUP_PAGES];	/* Size of compressed pages */
+	u64	off[GROUP_PAGES];	/* Data offsets within group */
+};
+
+/*
+ * Pool of compression threads
+ *
+ * The threads are started once and take CHUNK_PAGES pages at a time from
+ * the group that is currently loaded into the cache.
+ */
+struct pool {
+	pthread_t	thread_vec[THREADS_MAX];
+	int		started;	/* Threads are running */
+	int		exit;		/* Threads should terminate */
+	pthread_mutex_t	mutex;
+	pthread_cond_t	work_cond;	/* New work or exit */
+	pthread_cond_t	done_cond;	/* All work of group done */
+	struct cache	*cache;		/* Cache with group to compress */
+	unsigned int	page_cnt;	/* Number of pages in group */
+	unsigned int	next;		/* Next page to be compressed */
+	unsigned int	active;		/* Number of work items in progress */
+};
+
+/*
+ * Position of page descriptor reader
+ */
+struct desc_pos {
+	u64	desc_idx;
+	u64	pfn;
+	u64	data_off;
+};
+
+/*
+ * File local static data
+ */
+static struct {
+	void		*hdr;		/* Dump and sub header */
+	u64		hdr_size;
+	u64		max_mapnr;	/* Number of pages in dump */
+	struct group	*group_vec;
+	u64		group_cnt;
+	u64		desc_cnt;	/* Number of dumped pages */
+	u64		data_size;	/* Size of non-zero page data */
+	u64		bitmap_size;	/* Size of one bitmap */
+	u64		off_bitmap;
+	u64		off_desc;
+	u64		off_data;
+	struct cache	cache;
+	struct desc_pos	desc_pos;
+	unsigned int	thread_cnt;
+	struct pool	pool;
+	int		spill_fd;	/* Compressed page data or -1 */
+} l;
+
+/*
+ * Return size value for page frame number
+ */
+static inline u16 page_size_get(u64 pfn)
+{
+	struct group *group = &l.group_vec[pfn / GROUP_PAGES];
+
+	return group->size ? group->size[pfn % GROUP_PAGES] : PAGE_EXCLUDED;
+}
+
+/*
+ * Return number of pages in group
+ */
+static unsigned int group_page_cnt(u64 group_nr)
+{
+	return MIN((u64) GROUP_PAGES, l.max_mapnr - group_nr * GROUP_PAGES);
+}
+
+/*
+ * Check if page contains only zeros
+ */
+static int page_is_zero(const char *page)
+{
+	const u64 *ptr = (const u64 *) page;
+	unsigned int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(*ptr); i++) {
+		if (ptr[i])
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Compress pages "start" to "end - 1" of the cache
+ *
+ * Pages that do not become smaller are stored uncompressed.
+ */
+static void compress_pages(struct cache *cache, unsigned int start,
+			   unsigned int end)
+{
+	char *page, *slot;
+	unsigned int i;
+	uLongf size;
+
+	for (i = start; i < end; i++) {
+		if (cache->size[i] == PAGE_EXCLUDED)
+			continue;
+		page = cache->raw + i * PAGE_SIZE;
+		if (page_is_zero(page)) {
+			cache->size[i] = PAGE_ZERO;
+			continue;
+		}
+		slot = cache->data + i * PAGE_SIZE;
+		size = PAGE_SIZE - 1;
+		if (compress2((Bytef *) slot, &size, (Bytef *) page, PAGE_SIZE,
+			      Z_BEST_SPEED) == Z_OK) {
+			cache->size[i] = size;
+		} else {
+			memcpy(slot, page, PAGE_SIZE);
+			cache->size[i] = PAGE_SIZE;
+		}
+	}
+}
+
+/*
+ * Compress the next work item of the pool with the pool mutex held
+ *
+ * Return 0 if there is no work left.
+ */
+static int pool_work(struct pool *pool)
+{
+	unsigned int start, end;
+
+	if (pool->next >= pool->page_cnt)
+		return 0;
+	start = pool->next;
+	end = MIN(start + CHUNK_PAGES, pool->page_cnt);
+	pool->next = end;
+	pool->active++;
+	pthread_mutex_unlock(&pool->mutex);
+	compress_pages(pool->cache, start, end);
+	pthread_mutex_lock(&pool->mutex);
+	if (--pool->active == 0 && pool->next >= pool->page_cnt)
+		pthread_cond_signal(&pool->done_cond);
+	return 1;
+}
+
+/*
+ * Compression thread: Wait for work until the pool is stopped
+ */
+static void *compress_thread(void *arg)
+{
+	struct pool *pool = arg;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->exit) {
+		if (!pool_work(pool))
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+/*
+ * Start the compression threads, the calling thread is the first one
+ */
+static void pool_start(struct pool *pool)
+{
+	unsigned int i;
+	int rc;
+
+	pool->exit = 0;
+	for (i = 1; i < l.thread_cnt; i++) {
+		rc = pthread_create(&pool->thread_vec[i], NULL,
+				    compress_thread, pool);
+		if (rc) {
+			errno = rc;
+			ERR_EXIT_ERRNO("Could not create compression thread");
+		}
+	}
+	pool->started = 1;
+}
+
+/*
+ * Stop the compression threads
+ */
+static void pool_stop(struct pool *pool)
+{
+	unsigned int i;
+
+	if (!pool->started)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->exit = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (i = 1; i < l.thread_cnt; i++)
+		pthread_join(pool->thread_vec[i], NULL);
+	pool->started = 0;
+}
+
+/*
+ * Initialize the pool, the threads are started with the first group
+ */
+static void pool_init(struct pool *pool)
+{
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->started = 0;
+}
+
+/*
+ * Threads do not survive fork(), e.g. when fuse goes to the background
+ */
+static void pool_atfork_child(void)
+{
+	pool_init(&l.pool);
+}
+
+/*
+ * Compress all pages of a cache with the pool
+ */
+static void pool_compress(struct pool *pool, struct cache *cache,
+			  unsigned int page_cnt)
+{
+	if (!pool->started)
+		pool_start(pool);
+	pthread_mutex_lock(&pool->mutex);
+	pool->cache = cache;
+	pool->page_cnt = page_cnt;
+	pool->next = 0;
+	pthread_cond_broadcast(&pool->work_cond);
+	while (pool_work(pool))
+		;
+	while (pool->active)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/*
+ * Read and compress all pages of a group
+ *
+ * The pages are read sequentially because the DFI read functions are not
+ * thread safe. Then the pages are compressed in parallel by the pool.
+ */
+static void cache_load(u64 group_nr)
+{
+	unsigned int i, page_cnt = group_page_cnt(group_nr);
+	struct group *group = &l.group_vec[group_nr];
+	struct cache *cache = &l.cache;
+	u64 pfn, off = 0;
+
+	if (cache->valid && cache->group_nr == group_nr)
+		return;
+	cache->group_nr = group_nr;
+	cache->valid = 1;
+	if (!group->size) {
+		memset(cache->size, 0, sizeof(cache->size));
+		memset(cache->off, 0, sizeof(cache->off));
+		return;
+	}
+	for (i = 0; i < page_cnt; i++) {
+		cache->size[i] = group->size[i];
+		if (cache->size[i] == PAGE_EXCLUDED)
+			continue;
+		pfn = group_nr * GROUP_PAGES + i;
+		dfi_mem_read(pfn * PAGE_SIZE, cache->raw + i * PAGE_SIZE,
+			     PAGE_SIZE);
+	}
+	pool_compress(&l.pool, cache, page_cnt);
+	for (i = 0; i < page_cnt; i++) {
+		cache->off[i] = off;
+		if (cache->size[i] != PAGE_EXCLUDED &&
+		    cache->size[i] != PAGE_ZERO)
+			off += cache->size[i];
+	}
+}
+
+/*
+ * Open the spill file for the compressed page data
+ *
+ * When the dump is copied to stdout, all data is read exactly once in
+ * order. Therefore the data that is compressed by layout_scan() is kept in
+ * an unlinked temporary file and is not compressed a second time. For
+ * mount the data would have to stay in the temporary file until unmount,
+ * so there the groups are compressed again on demand.
+ */
+static void spill_open(void)
+{
+	const char *dir = getenv("TMPDIR");
+	char path[PATH_MAX];
+
+	l.spill_fd = -1;
+	if (g.opts.action != ZG_ACTION_STDOUT)
+		return;
+	snprintf(path, PATH_MAX, "%s/zgetdump.XXXXXX", dir ? dir : "/tmp");
+	l.spill_fd = mkstemp(path);
+	if (l.spill_fd == -1)
+		STDERR("Warning: Could not create \"%s\": %s\n", path,
+		       strerror(errno));
+	else
+		unlink(path);
+}
+
+/*
+ * Close the spill file and compress the pages again on demand
+ */
+static void spill_close(void)
+{
+	if (l.spill_fd == -1)
+		return;
+	close(l.spill_fd);
+	l.spill_fd = -1;
+}
+
+/*
+ * Append the compressed pages of the cached group to the spill file
+ */
+static void spill_write(u64 group_nr)
+{
+	struct cache *cache = &l.cache;
+	unsigned int i, copied;
+	ssize_t rc;
+
+	for (i = 0; i < group_page_cnt(group_nr) && l.spill_fd != -1; i++) {
+		if (cache->size[i] == PAGE_EXCLUDED ||
+		    cache->size[i] == PAGE_ZERO)
+			continue;
+		for (copied = 0; copied < cache->size[i]; copied += rc) {
+			rc = write(l.spill_fd, cache->data + i * PAGE_SIZE +
+				   copied, cache->size[i] - copied);
+			if (rc > 0)
+				continue;
+			STDERR("Warning: Could not write temporary file: %s\n",
+			       strerror(rc ? errno : ENOSPC));
+			spill_close();
+			break;
+		}
+	}
+}
+
+/*
+ * Read page data from the spill file
+ */
+static void spill_read(u64 off, void *buf, u64 cnt)
+{
+	ssize_t rc;
+
+	while (cnt) {
+		rc = pread(l.spill_fd, buf, cnt, off);
+		if (rc == -1)
+			ERR_EXIT_ERRNO("Could not read temporary file");
+		if (rc == 0)
+			ERR_EXIT("Unexpected end of temporary file");
+		off += rc;
+		buf += rc;
+		cnt -= rc;
+	}
+}
+
+/*
+ * Compress all pages once to get the layout of the dump
+ */
+static void layout_scan(void)
+{
+	u64 group_nr, desc_idx = 0, data_off = 0;
+	struct group *group;
+	unsigned int i;
+
+	zg_progress_init("Compressing dump", l.max_mapnr * PAGE_SIZE);
+	for (group_nr = 0; group_nr < l.group_cnt; group_nr++) {
+		group = &l.group_vec[group_nr];
+		group->desc_idx = desc_idx;
+		group->data_off = data_off;
+		if (group->size) {
+			cache_load(group_nr);
+			spill_write(group_nr);
+			for (i = 0; i < group_page_cnt(group_nr); i++) {
+				group->size[i] = l.cache.size[i];
+				if (group->size[i] == PAGE_EXCLUDED)
+					continue;
+				desc_idx++;
+				if (group->size[i] != PAGE_ZERO)
+					data_off += group->size[i];
+			}
+		}
+		zg_progress((group_nr * GROUP_PAGES +
+			     group_page_cnt(group_nr)) * PAGE_SIZE);
+	}
+	STDERR("\n");
+	l.desc_cnt = desc_idx;
+	l.data_size = data_off;
+}
+
+/*
+ * Mark all pages of memory chunks as present in dump
+ */
+static void pages_init(void)
+{
+	struct dfi_mem_chunk *mem_chunk;
+	struct group *group;
+	u64 pfn;
+
+	l.max_mapnr = 0;
+	dfi_mem_chunk_iterate(mem_chunk) {
+		if (mem_chunk->start % PAGE_SIZE ||
+		    mem_chunk->size % PAGE_SIZE)
+			ERR_EXIT("Error: The kdump dump format requires page "
+				 "aligned memory chunks");
+		l.max_mapnr = MAX(l.max_mapnr,
+				  (mem_chunk->end + 1) / PAGE_SIZE);
+	}
+	l.group_cnt = DIV_UP(l.max_mapnr, GROUP_PAGES);
+	l.group_vec = zg_alloc(MAX(l.group_cnt, 1ULL) * sizeof(l.group_vec[0]));
+	dfi_mem_chunk_iterate(mem_chunk) {
+		for (pfn = mem_chunk->start / PAGE_SIZE;
+		     pfn <= mem_chunk->end / PAGE_SIZE; pfn++) {
+			group = &l.group_vec[pfn / GROUP_PAGES];
+			if (!group->size)
+				group->size = zg_alloc(GROUP_PAGES *
+						       sizeof(group->size[0]));
+			group->size[pfn % GROUP_PAGES] = PAGE_PRESENT;
+		}
+	}
+}
+
+/*
+ * Dump chunk function: Copy bitmap
+ *
+ * Both bitmaps are identical: All pages of the input dump are dumped.
+ */
+static void dfo_kdump_bitmap_fn(struct dfo_chunk *UNUSED(dump_chunk),
+				u64 off, void *buf, u64 cnt)
+{
+	unsigned char *bits = buf;
+	u64 i, pfn, byte;
+	unsigned int j;
+
+	for (i = 0; i < cnt; i++) {
+		byte = (off + i) % l.bitmap_size;
+		bits[i] = 0;
+		for (j = 0; j < 8; j++) {
+			pfn = byte * 8 + j;
+			if (pfn >= l.max_mapnr)
+				break;
+			if (page_size_get(pfn) != PAGE_EXCLUDED)
+				bits[i] |= 1 << j;
+		}
+	}
+}
+
+/*
+ * Position page descriptor reader to descriptor "desc_idx"
+ */
+static void desc_pos_set(u64 desc_idx)
+{
+	struct desc_pos *pos = &l.desc_pos;
+	u64 lo = 0, hi = l.group_cnt, mid;
+
+	if (pos->desc_idx == desc_idx && desc_idx != 0)
+		return;
+	/* Find last group with desc_idx <= desc_idx */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (l.group_vec[mid].desc_idx <= desc_idx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	pos->desc_idx = l.group_vec[lo - 1].desc_idx;
+	pos->data_off = l.group_vec[lo - 1].data_off;
+	pos->pfn = (lo - 1) * GROUP_PAGES;
+	while (page_size_get(pos->pfn) == PAGE_EXCLUDED)
+		pos->pfn++;
+	while (pos->desc_idx != desc_idx) {
+		if (page_size_get(pos->pfn) != PAGE_ZERO)
+			pos->data_off += page_size_get(pos->pfn);
+		pos->pfn++;
+		while (page_size_get(pos->pfn) == PAGE_EXCLUDED)
+			pos->pfn++;
+		pos->desc_idx++;
+	}
+}
+
+/*
+ * Get page descriptor at current position and move to next descriptor
+ */
+static void desc_pos_next(struct df_kdump_page_desc *desc)
+{
+	struct desc_pos *pos = &l.desc_pos;
+	u16 size = page_size_get(pos->pfn);
+
+	memset(desc, 0, sizeof(*desc));
+	if (size == PAGE_ZERO) {
+		/* All zero pages share one page at the start of the data */
+		desc->offset = l.off_data;
+		desc->size = PAGE_SIZE;
+	} else {
+		desc->offset = l.off_data + PAGE_SIZE + pos->data_off;
+		desc->size = size;
+		if (size < PAGE_SIZE)
+			desc->flags = DF_KDUMP_DH_COMPRESSED_ZLIB;
+		pos->data_off += size;
+	}
+	pos->desc_idx++;
+	if (pos->desc_idx == l.desc_cnt)
+		return;
+	pos->pfn++;
+	while (page_size_get(pos->pfn) == PAGE_EXCLUDED) {
+		/* Skip groups without pages */
+		if (pos->pfn % GROUP_PAGES == 0 &&
+		    !l.group_vec[pos->pfn / GROUP_PAGES].size)
+			pos->pfn += GROUP_PAGES;
+		else
+			pos->pfn++;
+	}
+}
+
+/*
+ * Dump chunk function: Copy page descriptors
+ */
+static void dfo_kdump_desc_fn(struct dfo_chunk *UNUSED(dump_chunk),
+			      u64 off, void *buf, u64 cnt)
+{
+	struct df_kdump_page_desc desc;
+	u64 desc_off, size, copied = 0;
+
+	desc_pos_set(off / sizeof(desc));
+	desc_off = off % sizeof(desc);
+	while (copied < cnt) {
+		desc_pos_next(&desc);
+		size = MIN(sizeof(desc) - desc_off, cnt - copied);
+		memcpy(buf + copied, (char *) &desc + desc_off, size);
+		copied += size;
+		desc_off = 0;
+	}
+}
+
+/*
+ * Dump chunk function: Copy page data
+ *
+ * The data starts with one zero page that is shared by all zero pages.
+ */
+static void dfo_kdump_data_fn(struct dfo_chunk *UNUSED(dump_chunk),
+			      u64 off, void *buf, u64 cnt)
+{
+	u64 lo = 0, hi = l.group_cnt, mid, group_nr, size, page_off;
+	struct cache *cache = &l.cache;
+	unsigned int i;
+
+	if (off < PAGE_SIZE) {
+		size = MIN(cnt, PAGE_SIZE - off);
+		memset(buf, 0, size);
+		off += size;
+		buf += size;
+		cnt -= size;
+	}
+	if (cnt == 0)
+		return;
+	off -= PAGE_SIZE;
+	if (l.spill_fd != -1) {
+		spill_read(off, buf, cnt);
+		return;
+	}
+	/* Find last group with data_off <= off */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (l.group_vec[mid].data_off <= off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	group_nr = lo - 1;
+	while (cnt) {
+		cache_load(group_nr);
+		page_off = off - l.group_vec[group_nr].data_off;
+		for (i = 0; i < group_page_cnt(group_nr) && cnt; i++) {
+			if (cache->size[i] == PAGE_EXCLUDED ||
+			    cache->size[i] == PAGE_ZERO)
+				continue;
+			if (cache->size[i] != l.group_vec[group_nr].size[i])
+				ABORT("Compressed page size mismatch for "
+				      "pfn %llx", group_nr * GROUP_PAGES + i);
+			if (page_off >= cache->off[i] + cache->size[i])
+				continue;
+			size = MIN(cnt, cache->off[i] + cache->size[i] -
+				   page_off);
+			memcpy(buf, cache->data + i * PAGE_SIZE + page_off -
+			       cache->off[i], size);
+			buf += size;
+			cnt -= size;
+			off += size;
+			page_off += size;
+		}
+		group_nr++;
+	}
+}
+
+/*
+ * Initialize dump and sub header
+ */
+static void hdr_init(void)
+{
+	u64 sub_hdr_blocks, bitmap_blocks;
+	struct df_kdump_sub_hdr *sub_hdr;
+	struct df_kdump_hdr *hdr;
+	char *vmcoreinfo, *ptr;
+
+	vmcoreinfo = dfi_vmcoreinfo_get();
+	sub_hdr_blocks = DIV_UP(sizeof(*sub_hdr) + dfo_elf_notes_size_max() +
+				(vmcoreinfo ? strlen(vmcoreinfo) : 0),
+				BLOCK_SIZE);
+	l.hdr_size = (1 + sub_hdr_blocks) * BLOCK_SIZE;
+	l.hdr = zg_alloc(l.hdr_size);
+	hdr = l.hdr;
+	sub_hdr = l.hdr + BLOCK_SIZE;
+
+	/* Sub header with notes and vmcoreinfo */
+	ptr = (char *) (sub_hdr + 1);
+	sub_hdr->offset_note = PTR_DIFF(ptr, l.hdr);
+	ptr = dfo_elf_notes_write(ptr);
+	sub_hdr->size_note = PTR_DIFF(ptr, l.hdr) - sub_hdr->offset_note;
+	if (vmcoreinfo) {
+		sub_hdr->offset_vmcoreinfo = PTR_DIFF(ptr, l.hdr);
+		sub_hdr->size_vmcoreinfo = strlen(vmcoreinfo);
+		memcpy(ptr, vmcoreinfo, sub_hdr->size_vmcoreinfo);
+	}
+	sub_hdr->phys_base = 0;
+	sub_hdr->dump_level = 0;
+	sub_hdr->split = 0;
+	sub_hdr->start_pfn = 0;
+	sub_hdr->end_pfn = l.max_mapnr;
+	sub_hdr->start_pfn_64 = 0;
+	sub_hdr->end_pfn_64 = l.max_mapnr;
+	sub_hdr->max_mapnr_64 = l.max_mapnr;
+
+	/* Dump header */
+	l.bitmap_size = ROUNDUP(DIV_UP(l.max_mapnr, 8), BLOCK_SIZE);
+	bitmap_blocks = 2 * l.bitmap_size / BLOCK_SIZE;
+	memcpy(hdr->signature, DF_KDUMP_SIGNATURE, sizeof(hdr->signature));
+	hdr->header_version = DF_KDUMP_HDR_VERSION;
+	if (dfi_attr_utsname())
+		memcpy(&hdr->utsname, dfi_attr_utsname(), sizeof(hdr->utsname));
+	if (dfi_attr_time())
+		hdr->timestamp = *dfi_attr_time();
+	hdr->status = DF_KDUMP_DH_COMPRESSED_ZLIB;
+	hdr->block_size = BLOCK_SIZE;
+	hdr->sub_hdr_size = sub_hdr_blocks;
+	hdr->bitmap_blocks = bitmap_blocks;
+	hdr->max_mapnr = MIN(l.max_mapnr, 0xffffffffULL);
+	hdr->nr_cpus = dfi_cpu_cnt();
+
+	l.off_bitmap = l.hdr_size;
+	l.off_desc = l.off_bitmap + 2 * l.bitmap_size;
+}
+
+/*
+ * Setup dump chunks
+ */
+static void dump_chunks_init(void)
+{
+	dfo_chunk_add(0, l.hdr_size, l.hdr, dfo_chunk_buf_fn);
+	dfo_chunk_add(l.off_bitmap, 2 * l.bitmap_size, NULL,
+		      dfo_kdump_bitmap_fn);
+	if (l.desc_cnt)
+		dfo_chunk_add(l.off_desc,
+			      l.desc_cnt * sizeof(struct df_kdump_page_desc),
+			      NULL, dfo_kdump_desc_fn);
+	dfo_chunk_add(l.off_data, PAGE_SIZE + l.data_size, NULL,
+		      dfo_kdump_data_fn);
+}
+
+/*
+ * Initialize kdump output dump format
+ */
+static void dfo_kdump_init(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (dfi_arch() != DFI_ARCH_64)
+		ERR_EXIT("Error: The kdump dump format is only supported for "
+			 "s390x source dumps");
+	l.thread_cnt = MAX(1, MIN(cpus, THREADS_MAX));
+	l.cache.raw = zg_alloc(GROUP_PAGES * PAGE_SIZE);
+	l.cache.data = zg_alloc(GROUP_PAGES * PAGE_SIZE);
+	pool_init(&l.pool);
+	pthread_atfork(NULL, NULL, pool_atfork_child);
+	pages_init();
+	spill_open();
+	layout_scan();
+	hdr_init();
+	l.off_data = l.off_desc +
+		l.desc_cnt * sizeof(struct df_kdump_page_desc);
+	dump_chunks_init();
+}
+
+/*
+ * Exit kdump output dump format
+ */
+static void dfo_kdump_exit(void)
+{
+	pool_stop(&l.pool);
+	spill_close();
+}
+
+/*
+ * kdump DFO operations
+ */
+struct dfo dfo_kdump = {
+	.name		= "kdump",
+	.init		= dfo_kdump_init,
+	.exit		= dfo_kdump_exit,
+};
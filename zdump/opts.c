@@ -10,6 +10,7 @@
  */
 
 #include <getopt.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,8 +22,8 @@
  * Text for --help option
  */
 static char help_text[] =
-"Usage: zgetdump    DUMP [-s SYS] [-f FMT] > DUMP_FILE\n"
-"                -m DUMP [-s SYS] [-f FMT] DIR\n"
+"Usage: zgetdump    DUMP [-s SYS] [-f FMT] [-p] > DUMP_FILE\n"
+"                -m DUMP [-s SYS] [-f FMT] [-c SIZE] DIR\n"
 "                -i DUMP [-s SYS]\n"
 "                -d DUMPDEV\n"
 "                -u DIR\n"
@@ -42,8 +43,10 @@ static char help_text[] =
 "-m, --mount    Mount DUMP to mount point DIR\n"
 "-u, --umount   Unmount dump from mount point DIR\n"
 "-i, --info     Print DUMP information\n"
-"-f, --fmt      Specify target dump format FMT (\"elf\" or \"s390\")\n"
+"-f, --fmt      Specify target dump format FMT (\"elf\", \"s390\", \"kdump\")\n"
 "-s, --select   Select system data SYS (\"kdump\", \"prod\", or \"all\")\n"
+"-p, --pipeline Copy DUMP with separate threads for reading and writing\n"
+"-c, --cache    Use SIZE MiB for the mount read cache (default 64, 0 = off)\n"
 "-d, --device   Print DUMPDEV (dump device) information\n"
 "-v, --version  Print version information, then exit\n"
 "-V, --verbose  Show detailed layout of memory map on printing DUMP information\n"
@@ -65,6 +68,7 @@ static void init_defaults(void)
 {
 	g.prog_name = "zgetdump";
 	g.opts.action = ZG_ACTION_STDOUT;
+	g.opts.cache_size = OPTS_CACHE_SIZE_DEFAULT;
 #ifdef __s390x__
 	g.opts.fmt = "elf";
 #else
@@ -129,6 +133,22 @@ static void select_set(const char *select)
 	g.opts.select_specified = 1;
 }
 
+/*
+ * Set "--cache" option
+ */
+static void cache_size_set(const char *size_str)
+{
+	char *endptr;
+	unsigned long size;
+
+	errno = 0;
+	size = strtoul(size_str, &endptr, 10);
+	if (errno || *endptr || endptr == size_str || size > UINT_MAX / MIB)
+		ERR_EXIT("Invalid cache size \"%s\" specified", size_str);
+	g.opts.cache_size = size;
+	g.opts.cache_size_specified = 1;
+}
+
 /*
  * Set mount point
  */
@@ -185,6 +205,12 @@ static void verify_opts(void)
 			ERR_EXIT("The \"--select\" option can only be "
 				 "specified for info, mount, or copy");
 	}
+	if (g.opts.pipeline_specified && g.opts.action != ZG_ACTION_STDOUT)
+		ERR_EXIT("The \"--pipeline\" option can only be specified "
+			 "for copy");
+	if (g.opts.cache_size_specified && g.opts.action != ZG_ACTION_MOUNT)
+		ERR_EXIT("The \"--cache\" option can only be specified "
+			 "for mount");
 	if (!g.opts.fmt_specified)
 		return;
 
@@ -253,9 +279,11 @@ void opts_parse(int argc, char *argv[])
 		{"select",  required_argument, NULL, 's'},
 		{"debug",   no_argument,       NULL, 'X'},
 		{"verbose", no_argument,       NULL, 'V'},
+		{"pipeline", no_argument,      NULL, 'p'},
+		{"cache",   required_argument, NULL, 'c'},
 		{NULL,      0,                 NULL,  0 }
 	};
-	static const char optstr[] = "hvVidmus:f:X";
+	static const char optstr[] = "hvVidmups:f:c:X";
 
 	init_defaults();
 	while ((opt = getopt_long(argc, argv, optstr, long_opts, &idx)) != -1) {
@@ -285,6 +313,12 @@ void opts_parse(int argc, char *argv[])
 		case 's':
 			select_set(optarg);
 			break;
+		case 'p':
+			g.opts.pipeline_specified = 1;
+			break;
+		case 'c':
+			cache_size_set(optarg);
+			break;
 		case 'X':
 			g.opts.debug_specified = 1;
 			break;
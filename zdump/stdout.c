@@ -9,21 +9,202 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
 #include "zgetdump.h"
 
-int stdout_write_dump(void)
+#define PIPE_BUF_SIZE	(8UL * 1024 * 1024)	/* Size of one ring buffer */
+#define PIPE_BUF_CNT	4			/* Number of ring buffers */
+#define PIPE_BUF_ALIGN	4096			/* Alignment for O_DIRECT */
+
+/*
+ * Ring of buffers that is filled by the reader and drained by the writer
+ */
+struct pipe_ring {
+	char		*buf[PIPE_BUF_CNT];
+	u64		cnt[PIPE_BUF_CNT];	/* Valid bytes in buffer */
+	unsigned int	head;			/* Next buffer to fill */
+	unsigned int	tail;			/* Next buffer to write */
+	unsigned int	used;			/* Number of filled buffers */
+	int		eof;			/* Reader is done */
+	int		direct;			/* O_DIRECT is active */
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond_filled;
+	pthread_cond_t	cond_drained;
+};
+
+/*
+ * Enable O_DIRECT on stdout if it is an aligned regular file
+ */
+static int direct_enable(void)
+{
+	struct stat sb;
+	off_t off;
+	int flags;
+
+	if (fstat(STDOUT_FILENO, &sb) != 0 || !S_ISREG(sb.st_mode))
+		return 0;
+	off = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	if (off == -1 || off % PIPE_BUF_ALIGN)
+		return 0;
+	flags = fcntl(STDOUT_FILENO, F_GETFL);
+	if (flags == -1 || (flags & O_APPEND))
+		return 0;
+	if (fcntl(STDOUT_FILENO, F_SETFL, flags | O_DIRECT) == -1)
+		return 0;
+	return 1;
+}
+
+/*
+ * Disable O_DIRECT on stdout
+ */
+static void direct_disable(struct pipe_ring *ring)
+{
+	int flags;
+
+	if (!ring->direct)
+		return;
+	flags = fcntl(STDOUT_FILENO, F_GETFL);
+	if (flags != -1)
+		fcntl(STDOUT_FILENO, F_SETFL, flags & ~O_DIRECT);
+	ring->direct = 0;
+}
+
+/*
+ * Write one buffer to stdout
+ *
+ * O_DIRECT requires aligned sizes, therefore it is switched off for the
+ * last partial buffer or if the file system rejects direct I/O.
+ */
+static void pipe_buf_write(struct pipe_ring *ring, char *buf, u64 cnt)
+{
+	ssize_t rc;
+
+	if (cnt % PIPE_BUF_ALIGN)
+		direct_disable(ring);
+	while (cnt) {
+		rc = write(STDOUT_FILENO, buf, cnt);
+		if (rc == -1 && errno == EINVAL && ring->direct) {
+			direct_disable(ring);
+			continue;
+		}
+		if (rc == -1)
+			ERR_EXIT_ERRNO("Error: Write failed");
+		if (rc == 0)
+			ERR_EXIT("Error: Could not write full block");
+		buf += rc;
+		cnt -= rc;
+	}
+}
+
+/*
+ * Writer thread: Write filled buffers to stdout
+ */
+static void *pipe_writer(void *data)
+{
+	struct pipe_ring *ring = data;
+	u64 cnt, written = 0;
+	char *buf;
+
+	while (1) {
+		pthread_mutex_lock(&ring->mutex);
+		while (ring->used == 0 && !ring->eof)
+			pthread_cond_wait(&ring->cond_filled, &ring->mutex);
+		if (ring->used == 0) {
+			pthread_mutex_unlock(&ring->mutex);
+			break;
+		}
+		buf = ring->buf[ring->tail];
+		cnt = ring->cnt[ring->tail];
+		pthread_mutex_unlock(&ring->mutex);
+
+		pipe_buf_write(ring, buf, cnt);
+		written += cnt;
+		zg_progress(written);
+
+		pthread_mutex_lock(&ring->mutex);
+		ring->tail = (ring->tail + 1) % PIPE_BUF_CNT;
+		ring->used--;
+		pthread_cond_signal(&ring->cond_drained);
+		pthread_mutex_unlock(&ring->mutex);
+	}
+	return NULL;
+}
+
+/*
+ * Copy dump with reader (this thread) and writer thread in parallel
+ */
+static void stdout_write_dump_pipeline(void)
+{
+	struct pipe_ring ring;
+	u64 cnt, read = 0;
+	pthread_t thread;
+	unsigned int i;
+	int rc;
+
+	memset(&ring, 0, sizeof(ring));
+	for (i = 0; i < PIPE_BUF_CNT; i++) {
+		if (posix_memalign((void **) &ring.buf[i], PIPE_BUF_ALIGN,
+				   PIPE_BUF_SIZE))
+			ERR_EXIT("Alloc: Out of memory (%lu KiB)",
+				 TO_KIB(PIPE_BUF_SIZE));
+	}
+	pthread_mutex_init(&ring.mutex, NULL);
+	pthread_cond_init(&ring.cond_filled, NULL);
+	pthread_cond_init(&ring.cond_drained, NULL);
+	ring.direct = direct_enable();
+
+	rc = pthread_create(&thread, NULL, pipe_writer, &ring);
+	if (rc) {
+		errno = rc;
+		ERR_EXIT_ERRNO("Could not create writer thread");
+	}
+	while (read != dfo_size()) {
+		pthread_mutex_lock(&ring.mutex);
+		while (ring.used == PIPE_BUF_CNT)
+			pthread_cond_wait(&ring.cond_drained, &ring.mutex);
+		pthread_mutex_unlock(&ring.mutex);
+
+		cnt = dfo_read(ring.buf[ring.head], PIPE_BUF_SIZE);
+		if (cnt == 0)
+			break;
+		read += cnt;
+
+		pthread_mutex_lock(&ring.mutex);
+		ring.cnt[ring.head] = cnt;
+		ring.head = (ring.head + 1) % PIPE_BUF_CNT;
+		ring.used++;
+		pthread_cond_signal(&ring.cond_filled);
+		pthread_mutex_unlock(&ring.mutex);
+	}
+	pthread_mutex_lock(&ring.mutex);
+	ring.eof = 1;
+	pthread_cond_signal(&ring.cond_filled);
+	pthread_mutex_unlock(&ring.mutex);
+	pthread_join(thread, NULL);
+
+	direct_disable(&ring);
+	pthread_cond_destroy(&ring.cond_drained);
+	pthread_cond_destroy(&ring.cond_filled);
+	pthread_mutex_destroy(&ring.mutex);
+	for (i = 0; i < PIPE_BUF_CNT; i++)
+		free(ring.buf[i]);
+	if (read != dfo_size())
+		ERR_EXIT("Error: Could not read full dump");
+}
+
+/*
+ * Copy dump with synchronous read and write
+ */
+static void stdout_write_dump_sync(void)
 {
 	u64 cnt, written = 0;
 	char buf[32768];
 	ssize_t rc;
 
-	if (!dfi_feat_copy())
-		ERR_EXIT("Copying not possible for %s dumps", dfi_name());
-	STDERR("Format Info:\n");
-	STDERR("  Source: %s\n", dfi_name());
-	STDERR("  Target: %s\n", dfo_name());
-	STDERR("\n");
-	zg_progress_init("Copying dump", dfo_size());
 	do {
 		cnt = dfo_read(buf, sizeof(buf));
 		rc = write(STDOUT_FILENO, buf, cnt);
@@ -34,6 +215,21 @@ int stdout_write_dump(void)
 		written += cnt;
 		zg_progress(written);
 	} while (written != dfo_size());
+}
+
+int stdout_write_dump(void)
+{
+	if (!dfi_feat_copy())
+		ERR_EXIT("Copying not possible for %s dumps", dfi_name());
+	STDERR("Format Info:\n");
+	STDERR("  Source: %s\n", dfi_name());
+	STDERR("  Target: %s\n", dfo_name());
+	STDERR("\n");
+	zg_progress_init("Copying dump", dfo_size());
+	if (g.opts.pipeline_specified)
+		stdout_write_dump_pipeline();
+	else
+		stdout_write_dump_sync();
 	STDERR("\n");
 	STDERR("Success: Dump has been copied\n");
 	return 0;
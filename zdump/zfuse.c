@@ -25,6 +25,37 @@
 #include "zgetdump.h"
 
 #define DUMP_PATH_MAX	100
+#define STATS_PATH	"/cache_stats"
+#define STATS_SIZE_MAX	1024
+
+#define CACHE_BLK_SIZE	(64UL * 1024)	/* Size of one cache block */
+#define CACHE_RA_MAX	16U		/* Maximum read-ahead in blocks */
+
+/*
+ * Cache block with dump data
+ */
+struct cache_blk {
+	struct util_list_node	list;		/* LRU list */
+	struct cache_blk	*hash_next;	/* Hash chain */
+	u64			nr;		/* Block number */
+	char			*data;
+};
+
+/*
+ * Read cache for dump data
+ */
+struct cache {
+	struct util_list	lru_list;	/* Most recently used first */
+	struct cache_blk	**hash_vec;
+	unsigned int		blk_cnt;
+	unsigned int		blk_max;
+	u64			ra_off;		/* Next offset if sequential */
+	unsigned int		ra_cnt;		/* Read-ahead window in blocks */
+	u64			hits;
+	u64			misses;
+	u64			ra_blks;	/* Blocks read ahead */
+	u64			evictions;
+};
 
 /*
  * File local static data
@@ -33,8 +64,171 @@ static struct {
 	char		path[DUMP_PATH_MAX];
 	struct stat	stat_root;
 	struct stat	stat_dump;
+	struct stat	stat_stats;
+	struct cache	cache;
 } l;
 
+/*
+ * Return hash chain for cache block number
+ */
+static struct cache_blk **cache_hash(u64 nr)
+{
+	return &l.cache.hash_vec[nr % l.cache.blk_max];
+}
+
+/*
+ * Find block in cache
+ */
+static struct cache_blk *cache_find(u64 nr)
+{
+	struct cache_blk *blk;
+
+	for (blk = *cache_hash(nr); blk; blk = blk->hash_next) {
+		if (blk->nr == nr)
+			return blk;
+	}
+	return NULL;
+}
+
+/*
+ * Remove block from hash chain
+ */
+static void cache_hash_remove(struct cache_blk *blk)
+{
+	struct cache_blk **ptr = cache_hash(blk->nr);
+
+	while (*ptr != blk)
+		ptr = &(*ptr)->hash_next;
+	*ptr = blk->hash_next;
+}
+
+/*
+ * Read block from dump into cache
+ *
+ * If the cache is full, the least recently used block is replaced.
+ */
+static struct cache_blk *cache_load(u64 nr)
+{
+	struct cache_blk *blk;
+	u64 cnt;
+
+	if (l.cache.blk_cnt < l.cache.blk_max) {
+		blk = zg_alloc(sizeof(*blk));
+		blk->data = zg_alloc(CACHE_BLK_SIZE);
+		l.cache.blk_cnt++;
+	} else {
+		blk = util_list_end(&l.cache.lru_list);
+		util_list_remove(&l.cache.lru_list, blk);
+		cache_hash_remove(blk);
+		l.cache.evictions++;
+	}
+	blk->nr = nr;
+	dfo_seek(nr * CACHE_BLK_SIZE);
+	cnt = dfo_read(blk->data, CACHE_BLK_SIZE);
+	memset(blk->data + cnt, 0, CACHE_BLK_SIZE - cnt);
+	blk->hash_next = *cache_hash(nr);
+	*cache_hash(nr) = blk;
+	util_list_add_head(&l.cache.lru_list, blk);
+	return blk;
+}
+
+/*
+ * Get block from cache and read it from dump if necessary
+ */
+static struct cache_blk *cache_get(u64 nr)
+{
+	struct cache_blk *blk;
+
+	blk = cache_find(nr);
+	if (blk) {
+		l.cache.hits++;
+		util_list_remove(&l.cache.lru_list, blk);
+		util_list_add_head(&l.cache.lru_list, blk);
+		return blk;
+	}
+	l.cache.misses++;
+	return cache_load(nr);
+}
+
+/*
+ * Read ahead blocks following block "nr" for sequential access
+ *
+ * The read-ahead window is doubled for each sequential read up to
+ * CACHE_RA_MAX blocks but never exceeds half of the cache.
+ */
+static void cache_read_ahead(u64 off, size_t size, u64 nr)
+{
+	u64 nr_last = (dfo_size() - 1) / CACHE_BLK_SIZE;
+	unsigned int i, ra_max;
+
+	if (off != l.cache.ra_off) {
+		l.cache.ra_cnt = 0;
+		l.cache.ra_off = off + size;
+		return;
+	}
+	l.cache.ra_off = off + size;
+	ra_max = MIN(CACHE_RA_MAX, l.cache.blk_max / 2);
+	l.cache.ra_cnt = MIN(MAX(2 * l.cache.ra_cnt, 1U), ra_max);
+	for (i = 1; i <= l.cache.ra_cnt && nr + i <= nr_last; i++) {
+		if (cache_find(nr + i))
+			continue;
+		cache_load(nr + i);
+		l.cache.ra_blks++;
+	}
+}
+
+/*
+ * Read dump data through cache
+ */
+static void cache_read(char *buf, size_t size, u64 off)
+{
+	u64 nr, blk_off, cnt, copied = 0;
+	struct cache_blk *blk;
+
+	nr = off / CACHE_BLK_SIZE;
+	while (copied < size) {
+		nr = (off + copied) / CACHE_BLK_SIZE;
+		blk_off = (off + copied) % CACHE_BLK_SIZE;
+		cnt = MIN(size - copied, CACHE_BLK_SIZE - blk_off);
+		blk = cache_get(nr);
+		memcpy(buf + copied, blk->data + blk_off, cnt);
+		copied += cnt;
+	}
+	cache_read_ahead(off, size, nr);
+}
+
+/*
+ * Format cache statistics
+ */
+static int cache_stats_get(char *buf, size_t size)
+{
+	return snprintf(buf, size,
+			"block_size: %lu\n"
+			"blocks: %u\n"
+			"blocks_max: %u\n"
+			"hits: %llu\n"
+			"misses: %llu\n"
+			"read_ahead: %llu\n"
+			"evictions: %llu\n",
+			CACHE_BLK_SIZE, l.cache.blk_cnt, l.cache.blk_max,
+			l.cache.hits, l.cache.misses, l.cache.ra_blks,
+			l.cache.evictions);
+}
+
+/*
+ * Initialize cache
+ */
+static void cache_init(void)
+{
+	util_list_init(&l.cache.lru_list, struct cache_blk, list);
+	l.cache.blk_max = (u64) g.opts.cache_size * MIB / CACHE_BLK_SIZE;
+	if (l.cache.blk_max == 0)
+		return;
+	l.cache.hash_vec = zg_alloc(l.cache.blk_max *
+				    sizeof(l.cache.hash_vec[0]));
+	l.cache.ra_off = U64_MAX;
+}
+
 /*
  * Initialize default values for stat buffer
  */
@@ -76,6 +270,17 @@ static void stat_dump_init(void)
 	l.stat_dump.st_blocks = l.stat_dump.st_size / 4096;
 }
 
+/*
+ * Initialize stat buffer for cache statistics
+ */
+static void stat_stats_init(void)
+{
+	stat_default_init(&l.stat_stats);
+	l.stat_stats.st_mode = S_IFREG | 0400;
+	l.stat_stats.st_nlink = 1;
+	l.stat_stats.st_size = STATS_SIZE_MAX;
+}
+
 /*
  * FUSE callback: Getattr
  */
@@ -89,6 +294,10 @@ static int zfuse_getattr(const char *path, struct stat *stat)
 		*stat = l.stat_dump;
 		return 0;
 	}
+	if (l.cache.blk_max && strcmp(path, STATS_PATH) == 0) {
+		*stat = l.stat_stats;
+		return 0;
+	}
 	return -ENOENT;
 }
 
@@ -107,6 +316,8 @@ static int zfuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	filler(buf, ".", NULL, 0);
 	filler(buf, "..", NULL, 0);
 	filler(buf, &l.path[1], NULL, 0);
+	if (l.cache.blk_max)
+		filler(buf, &STATS_PATH[1], NULL, 0);
 	return 0;
 }
 
@@ -115,6 +326,13 @@ static int zfuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
  */
 static int zfuse_open(const char *path, struct fuse_file_info *fi)
 {
+	if (l.cache.blk_max && strcmp(path, STATS_PATH) == 0) {
+		if ((fi->flags & 3) != O_RDONLY)
+			return -EACCES;
+		/* Statistics change, so do not use the kernel page cache */
+		fi->direct_io = 1;
+		return 0;
+	}
 	if (strcmp(path, l.path) != 0)
 		return -ENOENT;
 	if ((fi->flags & 3) != O_RDONLY)
@@ -129,10 +347,25 @@ static int zfuse_open(const char *path, struct fuse_file_info *fi)
 static int zfuse_read(const char *path, char *buf, size_t size, off_t offset,
 		      struct fuse_file_info *fi)
 {
+	char stats[STATS_SIZE_MAX];
+	int len;
+
 	(void) fi;
 
+	if (l.cache.blk_max && strcmp(path, STATS_PATH) == 0) {
+		len = cache_stats_get(stats, sizeof(stats));
+		if (offset >= len)
+			return 0;
+		size = MIN(size, (size_t) (len - offset));
+		memcpy(buf, stats + offset, size);
+		return size;
+	}
 	if (strcmp(path, l.path) != 0)
 		return -ENOENT;
+	if (l.cache.blk_max) {
+		cache_read(buf, size, offset);
+		return size;
+	}
 	dfo_seek(offset);
 	dfo_read(buf, size);
 	return size;
@@ -208,6 +441,8 @@ int zfuse_mount_dump(void)
 	add_argv_fuse(&args);
 	stat_root_init();
 	stat_dump_init();
+	stat_stats_init();
+	cache_init();
 	snprintf(l.path, sizeof(l.path), "/dump.%s", dfo_name());
 	return fuse_main(args.argc, args.argv, &zfuse_ops);
 }
@@ -24,8 +24,9 @@
  * Progress information
  */
 struct prog {
-	time_t	time_next;
-	u64	mem_size;
+	time_t		time_next;
+	u64		mem_size;
+	struct timeval	time_start;
 };
 
 /*
@@ -350,6 +351,7 @@ void zg_progress_init(const char *msg, u64 mem_size)
 	STDERR("%s:\n", msg);
 	l.prog.time_next = 0;
 	l.prog.mem_size = mem_size;
+	gettimeofday(&l.prog.time_start, NULL);
 }
 
 /*
@@ -358,11 +360,17 @@ void zg_progress_init(const char *msg, u64 mem_size)
 void zg_progress(u64 addr)
 {
 	struct timeval tv;
+	u64 usecs, rate = 0;
 
 	gettimeofday(&tv, NULL);
 	if ((tv.tv_sec < l.prog.time_next) && (addr < l.prog.mem_size))
 		return;
-	STDERR("  %08Lu / %08Lu MB\n", TO_MIB(addr), TO_MIB(l.prog.mem_size));
+	usecs = (tv.tv_sec - l.prog.time_start.tv_sec) * 1000000ULL +
+		tv.tv_usec - l.prog.time_start.tv_usec;
+	if (usecs)
+		rate = TO_MIB(addr) * 1000000ULL / usecs;
+	STDERR("  %08Lu / %08Lu MB (%Lu MB/s)\n", TO_MIB(addr),
+	       TO_MIB(l.prog.mem_size), rate);
 	l.prog.time_next = tv.tv_sec + PROGRESS_INTERVAL_SECS;
 }
 
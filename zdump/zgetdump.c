@@ -147,6 +147,7 @@ static int do_mount(void)
 	dfo_init();
 	kdump_select_check();
 	rc = zfuse_mount_dump();
+	dfo_exit();
 	dfi_exit();
 	return rc;
 }
@@ -163,6 +164,7 @@ static int do_stdout(void)
 	dfo_init();
 	kdump_select_check();
 	rc = stdout_write_dump();
+	dfo_exit();
 	dfi_exit();
 	return rc;
 }
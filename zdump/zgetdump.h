@@ -13,6 +13,7 @@
 #define ZGETDUMP_H
 
 #include "df_elf.h"
+#include "df_kdump.h"
 #include "df_lkcd.h"
 #include "df_s390.h"
 #include "dfi.h"
@@ -23,6 +24,8 @@
 /*
  * zgetdump options
  */
+#define OPTS_CACHE_SIZE_DEFAULT	64	/* Mount read cache size in MiB */
+
 struct options {
 	int		action_specified;
 	enum zg_action	action;
@@ -36,6 +39,9 @@ struct options {
 	const char	*select;
 	int		select_specified;
 	int		verbose_specified;
+	int		pipeline_specified;
+	unsigned int	cache_size;
+	int		cache_size_specified;
 };
 
 extern const char *OPTS_SELECT_KDUMP;
@@ -90,6 +96,7 @@ extern struct dfi dfi_devmem;
  */
 extern struct dfo dfo_s390;
 extern struct dfo dfo_elf;
+extern struct dfo dfo_kdump;
 
 /*
  * Supported s390 dumpers
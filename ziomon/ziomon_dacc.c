@@ -873,6 +873,235 @@ void discard_aggr_data_struct(struct aggr_data *data)
 }
 
 
+static void swap_index_header(struct index_data *hdr)
+{
+	swap_32(hdr->magic);
+	swap_32(hdr->version);
+	swap_64(hdr->end_time);
+	swap_64(hdr->first_msg_offset);
+	swap_64(hdr->num_entries);
+}
+
+
+static void swap_index_entry(struct index_entry *entry)
+{
+	swap_64(entry->timestamp);
+	swap_64(entry->pos);
+}
+
+
+static int add_index_entry(struct index_data *data, __u64 *size,
+			   __u64 timestamp, long pos)
+{
+	struct index_entry *tmp;
+
+	if (data->num_entries == *size) {
+		*size = *size ? *size * 2 : 1024;
+		tmp = realloc(data->entries, *size * sizeof(struct index_entry));
+		if (!tmp) {
+			fprintf(stderr, "%s: Memory allocation error\n",
+				toolname);
+			return -1;
+		}
+		data->entries = tmp;
+	}
+	data->entries[data->num_entries].timestamp = timestamp;
+	data->entries[data->num_entries].pos = pos;
+	data->num_entries++;
+
+	return 0;
+}
+
+
+int build_index(FILE *fp, struct file_header *f_hdr, struct index_data *data)
+{
+	struct message_preview msg_prev;
+	__u64 max_ts = 0, size = 0;
+	long dist = 0;
+	int rc;
+
+	data->magic = DATA_MGR_MAGIC_IDX;
+	data->version = DATA_MGR_IDX_V1;
+	data->end_time = f_hdr->end_time;
+	data->first_msg_offset = f_hdr->first_msg_offset;
+	data->num_entries = 0;
+	data->entries = NULL;
+
+	wrapped = -1;
+	while ( (rc = get_next_msg_preview(fp, &msg_prev, f_hdr)) == 0 ) {
+		if (dist >= DACC_IDX_STEP) {
+			if (add_index_entry(data, &size, max_ts, msg_prev.pos))
+				break;
+			dist = 0;
+		}
+		dist += msg_prev.length + 8;
+		if (msg_prev.timestamp > max_ts)
+			max_ts = msg_prev.timestamp;
+	}
+	wrapped = -1;
+	if (rc <= 0) {
+		fprintf(stderr, "%s: Could not index messages\n", toolname);
+		return -1;
+	}
+	verbose_msg("indexed messages, %llu entries\n",
+		    (unsigned long long)data->num_entries);
+
+	return 0;
+}
+
+
+int write_index_file(FILE *fp, struct index_data *data)
+{
+	struct index_entry entry;
+	__u64 i;
+
+	swap_index_header(data);
+	rewind(fp);
+	i = fwrite(data, DACC_IDX_FILE_HDR_LEN, 1, fp);
+	swap_index_header(data);
+	if (i != 1)
+		return -1;
+
+	for (i = 0; i < data->num_entries; ++i) {
+		entry = data->entries[i];
+		swap_index_entry(&entry);
+		if (fwrite(&entry, sizeof(entry), 1, fp) != 1)
+			return -2;
+	}
+
+	return 0;
+}
+
+
+static int read_index_file(FILE *fp, struct file_header *f_hdr,
+			   struct index_data *data)
+{
+	__u64 i;
+
+	if (fread(data, DACC_IDX_FILE_HDR_LEN, 1, fp) != 1)
+		return -1;
+	swap_index_header(data);
+	data->entries = NULL;
+	if (data->magic != DATA_MGR_MAGIC_IDX)
+		return -1;
+	/* index from a previous run or of a different version? */
+	if (data->version != DATA_MGR_IDX_V1
+	    || data->end_time != f_hdr->end_time
+	    || data->first_msg_offset != f_hdr->first_msg_offset) {
+		verbose_msg("  .idx file does not match .log file, ignoring\n");
+		return 1;
+	}
+	data->entries = calloc(data->num_entries, sizeof(struct index_entry));
+	if (data->num_entries && !data->entries)
+		return -1;
+	if (fread(data->entries, sizeof(struct index_entry),
+		  data->num_entries, fp) != data->num_entries)
+		return -1;
+	for (i = 0; i < data->num_entries; ++i)
+		swap_index_entry(&data->entries[i]);
+
+	return 0;
+}
+
+
+int open_index_file(const char *filename, struct file_header *f_hdr,
+		    struct index_data *data)
+{
+	int rc = 0;
+	char *fname = NULL;
+	FILE *fp;
+
+	data->num_entries = 0;
+	data->entries = NULL;
+	fname = (char*)malloc(strlen(filename) + strlen(DACC_FILE_EXT_IDX) + 1);
+	sprintf(fname, "%s%s", filename, DACC_FILE_EXT_IDX);
+
+	/* the index is optional */
+	fp = fopen(fname, "r");
+	if (!fp) {
+		rc = 1;
+		goto out;
+	}
+	rc = read_index_file(fp, f_hdr, data);
+	if (rc < 0)
+		fprintf(stderr, "%s: Warning: Could not read %s,"
+			" ignoring\n", toolname, fname);
+	if (rc) {
+		discard_index_data_struct(data);
+		data->num_entries = 0;
+	}
+	else
+		verbose_msg("  found .idx file\n");
+	fclose(fp);
+
+out:
+	free(fname);
+
+	return rc;
+}
+
+
+void discard_index_data_struct(struct index_data *data)
+{
+	if (data) {
+		free(data->entries);
+		data->entries = NULL;
+	}
+}
+
+
+/**
+ * Return 1 if message at position pos2 comes after position pos1 in the
+ * logical order of messages. 'wrapped1' indicates whether we read pos1
+ * after wrapping around.
+ */
+static int is_later_msg(struct file_header *f_hdr, long pos1, int wrapped1,
+			long pos2)
+{
+	int wrapped2;
+
+	if (!f_hdr->first_msg_offset)
+		return pos2 > pos1;
+	wrapped2 = pos2 < (long)f_hdr->first_msg_offset;
+	if (wrapped1 != wrapped2)
+		return wrapped2;
+
+	return pos2 > pos1;
+}
+
+
+int seek_index(FILE *fp, struct file_header *f_hdr, struct index_data *data,
+	       __u64 timestamp)
+{
+	__u64 lo = 0, hi = data->num_entries, mid;
+	struct index_entry *entry;
+
+	/* find final entry with all preceding messages prior to timestamp */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (data->entries[mid].timestamp < timestamp)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return 1;
+	entry = &data->entries[lo - 1];
+
+	if (wrapped >= 0
+	    && !is_later_msg(f_hdr, ftell(fp), wrapped, entry->pos))
+		return 1;
+
+	vverbose_msg("seek to indexed msg at pos=%llu\n",
+		     (unsigned long long)entry->pos);
+	fseek(fp, entry->pos, SEEK_SET);
+	wrapped = !f_hdr->first_msg_offset
+		|| entry->pos < f_hdr->first_msg_offset;
+
+	return 0;
+}
+
+
 int open_data_files(FILE **fp, const char *filename, struct file_header *f_hdr,
 	      struct aggr_data **agg)
 {
@@ -19,8 +19,10 @@
 
 #define DATA_MGR_MAGIC		0x64616d67
 #define DATA_MGR_MAGIC_AGGR	0x61676772
+#define DATA_MGR_MAGIC_IDX	0x696e6478
 #define DATA_MGR_V2		2u
 #define DATA_MGR_V3		3u
+#define DATA_MGR_IDX_V1		1u
 
 
 /**
@@ -109,6 +111,31 @@ struct aggr_data {
 } __attribute__ ((packed));
 
 
+#define DACC_IDX_FILE_HDR_LEN	32
+#define DACC_FILE_EXT_IDX	".idx"
+/* distance in Bytes between two entries of the index */
+#define DACC_IDX_STEP		(64 * 1024)
+/**
+ * An index entry points to a message in the .log file. 'timestamp' is the
+ * latest timestamp of all messages preceding it, so everything before 'pos'
+ * can be skipped when looking for messages later than 'timestamp'.
+ */
+struct index_entry {
+	__u64	timestamp;
+	__u64	pos;
+} __attribute__ ((packed));
+
+struct index_data {
+	__u32	magic;
+	__u32	version;
+	__u64	end_time;	/* end_time of the indexed .log file */
+	__u64	first_msg_offset;	/* first_msg_offset of the
+					   indexed .log file */
+	__u64	num_entries;
+	struct index_entry *entries;
+} __attribute__ ((packed));
+
+
 /**
  * Write the initial file header and forward to place where first message would
  * go init_size gives the total size of the header block in the file.
@@ -229,6 +256,43 @@ void discard_aggr_data_struct(struct aggr_data *data);
  */
 int write_aggr_file(FILE *fp, struct aggr_data *data);
 
+/**
+ * Walk all messages of the .log file and collect an index entry every
+ * DACC_IDX_STEP Bytes. Resets the read position, so use before reading
+ * any messages.
+ * data must be discarded via discard_index_data_struct().
+ */
+int build_index(FILE *fp, struct file_header *f_hdr, struct index_data *data);
+
+/**
+ * Write index data to file.
+ * fp is assumed to have been opened.
+ */
+int write_index_file(FILE *fp, struct index_data *data);
+
+/**
+ * Read the .idx file that belongs to the .log file with header f_hdr.
+ * Returns <0 in case of error, >0 if file doesn't exist or does not match
+ * the .log file. 'data' is left without entries unless 0 is returned.
+ * 'filename' is assumed to NOT carry the .idx extension.
+ * data must be discarded via discard_index_data_struct().
+ */
+int open_index_file(const char *filename, struct file_header *f_hdr,
+		    struct index_data *data);
+
+/**
+ * Frees the alloc'd portion of the struct.
+ */
+void discard_index_data_struct(struct index_data *data);
+
+/**
+ * Forward to the latest indexed message so that all messages skipped are
+ * older than 'timestamp'. Never moves backwards.
+ * Returns 0 if fp was moved, >0 otherwise.
+ */
+int seek_index(FILE *fp, struct file_header *f_hdr, struct index_data *data,
+	       __u64 timestamp);
+
 
 #endif
 
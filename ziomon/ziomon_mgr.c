@@ -56,6 +56,7 @@ struct options {
 	long                    version;
 	char   		       *outfile_name;
 	char   		       *outfile_name_agg;
+	char		       *outfile_name_idx;
 	FILE   		       *outfile;
 	FILE		       *outfile_agg;
 	struct aggr_data	agg_data;
@@ -76,6 +77,7 @@ static void init_opts(struct options *opts)
 	opts->msg_id_zfcpdd = LONG_MIN;
 	opts->outfile_name = NULL;
 	opts->outfile_name_agg = NULL;
+	opts->outfile_name_idx = NULL;
 	opts->outfile = NULL;
 	opts->outfile_agg = NULL;
 	opts->size_limit = LONG_MAX;
@@ -100,6 +102,7 @@ static void deinit_opts(struct options *opts)
 		fclose(opts->outfile);
 	free(opts->outfile_name);
 	free(opts->outfile_name_agg);
+	free(opts->outfile_name_idx);
 	if (opts->outfile_agg) {
 		fclose(opts->outfile_agg);
 		discard_aggr_data_struct(&opts->agg_data);
@@ -399,10 +402,14 @@ static int parse_params(int argc, char **argv, struct options *opts)
 			}
 			opts->outfile_name_agg = malloc(strlen(optarg)
 					+ strlen(DACC_FILE_EXT_AGG) + 1);
+			opts->outfile_name_idx = malloc(strlen(optarg)
+					+ strlen(DACC_FILE_EXT_IDX) + 1);
 			sprintf(opts->outfile_name, "%s" DACC_FILE_EXT_LOG,
 				optarg);
 			sprintf(opts->outfile_name_agg, "%s" DACC_FILE_EXT_AGG,
 				optarg);
+			sprintf(opts->outfile_name_idx, "%s" DACC_FILE_EXT_IDX,
+				optarg);
 			break;
 		case 'l':
 			if (!optarg) {
@@ -503,6 +510,12 @@ static int parse_params(int argc, char **argv, struct options *opts)
 			" file: %s\n", toolname, strerror(errno));
 		return -1;
 	}
+	/* an index of a previous run would not match anymore */
+	if (unlink(opts->outfile_name_idx) && errno != ENOENT) {
+		fprintf(stderr, "%s: Could not remove index"
+			" file: %s\n", toolname, strerror(errno));
+		return -1;
+	}
 
 	if (setup_msg_q(opts))
 		return -1;
@@ -588,6 +601,42 @@ static int handle_msg(struct message *msg, struct options *opts)
 }
 
 
+/**
+ * Write an index of the final .log file, so the report tools
+ * can skip to the requested timeframe right away.
+ */
+static int write_index(struct options *opts)
+{
+	struct index_data data;
+	FILE *fp;
+	int rc;
+
+	verbose_msg("write index...\n");
+	rc = build_index(opts->outfile, &opts->f_hdr, &data);
+	if (rc)
+		goto out;
+	fp = fopen(opts->outfile_name_idx, "w");
+	if (!fp) {
+		fprintf(stderr, "%s: Could not open index"
+			" file: %s\n", toolname, strerror(errno));
+		rc = -1;
+		goto out;
+	}
+	rc = write_index_file(fp, &data);
+	if (fclose(fp))
+		rc = -1;
+	if (rc) {
+		fprintf(stderr, "%s: Failed to write index\n", toolname);
+		unlink(opts->outfile_name_idx);
+	}
+
+out:
+	discard_index_data_struct(&data);
+
+	return rc;
+}
+
+
 int main(int argc, char **argv)
 {
 	int rc = 0;
@@ -647,6 +696,8 @@ int main(int argc, char **argv)
 
 	} while (keep_running);
 
+	write_index(&opts);
+
 out:
 	deinit_opts(&opts);
 	free(data);
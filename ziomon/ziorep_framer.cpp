@@ -33,6 +33,8 @@ Framer::Framer(__u64 begin, __u64 end, __u32 interval_length,
 	m_device_filter(devFilter), m_filename(filename), m_fp(NULL),
 	m_agg_read(false)
 {
+	m_index.num_entries = 0;
+	m_index.entries = NULL;
 	m_begin = begin;
 	m_end = end;
 	assert(m_begin <= m_end);
@@ -44,6 +46,8 @@ Framer::Framer(__u64 begin, __u64 end, __u32 interval_length,
 	}
 	if (m_agg_data)
 		conv_aggr_data_msg_data_from_BE(m_agg_data);
+	// optional - without it, we simply read all messages
+	open_index_file(m_filename, &m_fhdr, &m_index);
 
 	if (filter_types) {
 		m_type_filter = new MsgTypeFilter;
@@ -72,6 +76,7 @@ Framer::Framer(__u64 begin, __u64 end, __u32 interval_length,
 Framer::~Framer()
 {
 	close_data_files(m_fp);
+	discard_index_data_struct(&m_index);
 
 	if (m_type_filter)
 		delete m_type_filter;
@@ -233,6 +238,10 @@ int Framer::get_next_frameset(Frameset &frameset, bool replace_missing)
 	if (frame_begin == 0)
 		frame_begin = timeFilter.get_begin_time();
 
+	// skip messages that the time filter would discard anyway
+	if (seek_index(m_fp, &m_fhdr, &m_index, shifted_begin) == 0)
+		verbose_msg("    skipped to indexed message\n");
+
 	while( (rc = get_next_msg_preview(m_fp, &msg_preview, &m_fhdr)) == 0 ) {
 		vverbose_msg("checking out next msg\n");
 		++msgs_read;
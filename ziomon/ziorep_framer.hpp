@@ -72,6 +72,8 @@ private:
 	FILE			*m_fp;
 	struct file_header	 m_fhdr;
 	struct aggr_data	*m_agg_data;
+	/// index of the .log file, no entries if not available
+	struct index_data	 m_index;
 	/// indicates whether the .agg file was already read or not
 	bool			 m_agg_read;
 };
@@ -559,30 +559,123 @@ disk_free_info(struct disk_info* info)
 #define REISERFS_IOC_UNPACK	_IOW(0xCD,1,long)
 #endif /* not REISERFS_IOC_UNPACK */
 
-/* Retrieve the physical blocknumber (block on disk) of the specified logical
- * block (block in file). FD provides the file descriptor, LOGICAL is the
- * logical block number. Upon success, return 0 and store the physical
- * blocknumber in the variable pointed to by PHYSICAL. Return non-zero
+/* Maximum number of extents returned by one FIEMAP call */
+#define FIEMAP_EXTENT_BATCH	256
+
+/* Convert the file system block MAPPED which contains the logical block
+ * LOGICAL to a physical blocknumber. A file system block of 0 denotes a hole
+ * in the file. */
+static blocknum_t
+fs_block_to_physical(blocknum_t mapped, blocknum_t logical,
+		     struct disk_info* info)
+{
+	blocknum_t phy_per_fs;
+
+	if (mapped == 0)
+		return 0;
+	phy_per_fs = info->fs_block_size / info->phy_block_size;
+	/* Convert file system block to physical and add partition start */
+	return mapped * phy_per_fs + logical % phy_per_fs + info->geo.start;
+}
+
+/* Map COUNT logical blocks starting at logical block FIRST with a walk over
+ * the FIEMAP extents of the file identified by FD. Store the physical
+ * blocknumbers in PHYSICAL. Return 0 on success, a positive value if FIEMAP
+ * is not supported and a negative value otherwise. */
+static int
+get_blocknums_fiemap(int fd, blocknum_t first, blocknum_t count,
+		     blocknum_t* physical, struct disk_info* info)
+{
+	struct fiemap_extent *extent;
+	struct fiemap *fiemap;
+	uint64_t offset, end;
+	unsigned int e;
+	blocknum_t i;
+	int fiemap_size;
+	int last;
+	int rc;
+
+	fiemap_size = sizeof(struct fiemap) +
+		      FIEMAP_EXTENT_BATCH * sizeof(struct fiemap_extent);
+	fiemap = misc_malloc(fiemap_size);
+	if (!fiemap)
+		return -1;
+	/* fm_start, fm_length in bytes; blocks are in physical block units */
+	end = (first + count) * info->phy_block_size;
+	i = 0;
+	last = 0;
+	rc = 0;
+	while (i < count && !last) {
+		memset(fiemap, 0, fiemap_size);
+		fiemap->fm_start = (first + i) * info->phy_block_size;
+		fiemap->fm_length = end - fiemap->fm_start;
+		fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+		fiemap->fm_extent_count = FIEMAP_EXTENT_BATCH;
+		if (ioctl(fd, FS_IOC_FIEMAP, (unsigned long)fiemap)) {
+			rc = 1;
+			goto out_free;
+		}
+		for (e = 0; e < fiemap->fm_mapped_extents; e++) {
+			extent = &fiemap->fm_extents[e];
+			if (extent->fe_flags & FIEMAP_EXTENT_ENCODED) {
+				error_reason("File mapping is encoded");
+				rc = -1;
+				goto out_free;
+			}
+			/* Blocks in front of the extent are holes */
+			for (; i < count; i++) {
+				offset = (first + i) * info->phy_block_size;
+				if (offset >= extent->fe_logical +
+					      extent->fe_length)
+					break;
+				if (offset < extent->fe_logical) {
+					physical[i] = 0;
+					continue;
+				}
+				physical[i] = fs_block_to_physical(
+					(extent->fe_physical + offset -
+					 extent->fe_logical) /
+					info->fs_block_size, first + i, info);
+			}
+			if (extent->fe_flags & FIEMAP_EXTENT_LAST)
+				last = 1;
+		}
+		/* A partial batch covers the rest of the requested range */
+		if (fiemap->fm_mapped_extents < FIEMAP_EXTENT_BATCH)
+			last = 1;
+	}
+	/* No more extents: the remaining blocks are holes */
+	for (; i < count; i++)
+		physical[i] = 0;
+out_free:
+	free(fiemap);
+	return rc;
+}
+
+/* Retrieve the physical blocknumbers (blocks on disk) of COUNT logical
+ * blocks (blocks in file) starting at logical block FIRST. FD provides the
+ * file descriptor. The file system is queried with a single FIEMAP walk over
+ * all extents in the range, FIBMAP is used as fallback. Upon success, return
+ * 0 and store the physical blocknumbers in the array pointed to by PHYSICAL.
+ * Holes in the file are stored as blocknumber 0. Return non-zero
  * otherwise. */
-int
-disk_get_blocknum(int fd, int fd_is_basedisk, blocknum_t logical,
-		  blocknum_t* physical, struct disk_info* info)
+static int
+get_blocknums(int fd, int fd_is_basedisk, blocknum_t first, blocknum_t count,
+	      blocknum_t* physical, struct disk_info* info)
 {
 	struct statfs buf;
 	blocknum_t phy_per_fs;
-	blocknum_t mapped;
+	blocknum_t i;
 	int block;
-	int subblock;
-	int fiemap_size;
-	int map_offset;
-	struct fiemap *fiemap;
+	int rc;
 
 	/* No file system: partition or raw disk */
 	if (info->fs_block_size == -1) {
-		if (fd_is_basedisk)
-			*physical = logical;
-		else
-			*physical = logical + info->geo.start;
+		for (i = 0; i < count; i++) {
+			physical[i] = first + i;
+			if (!fd_is_basedisk)
+				physical[i] += info->geo.start;
+		}
 		return 0;
 	}
 
@@ -598,69 +691,35 @@ disk_get_blocknum(int fd, int fd_is_basedisk, blocknum_t logical,
 			return -1;
 		}
 	}
-	/* Get mapping in file system blocks */
+	/* First try FIEMAP */
+	rc = get_blocknums_fiemap(fd, first, count, physical, info);
+	if (rc <= 0)
+		return rc;
+	/* FIEMAP failed, fall back to FIBMAP */
 	phy_per_fs = info->fs_block_size / info->phy_block_size;
-	subblock = logical % phy_per_fs;
-
-	/* First try FIEMAP, more complicated to set up */
-	fiemap_size = sizeof(struct fiemap) + sizeof(struct fiemap_extent);
-
-	fiemap = misc_malloc(fiemap_size);
-	if (!fiemap)
-		return -1;
-	memset(fiemap, 0, fiemap_size);
-
-	fiemap->fm_extent_count = 1;
-	fiemap->fm_flags = FIEMAP_FLAG_SYNC;
-	/* fm_start, fm_length in bytes; logical is in physical block units */
-	fiemap->fm_start = logical * info->phy_block_size;
-	fiemap->fm_length = info->phy_block_size;
-
-	if (ioctl(fd, FS_IOC_FIEMAP, (unsigned long)fiemap)) {
-		/* FIEMAP failed, fall back to FIBMAP */
-		block = logical / phy_per_fs;
+	for (i = 0; i < count; i++) {
+		block = (first + i) / phy_per_fs;
 		if (ioctl(fd, FIBMAP, &block)) {
 			error_reason("Could not get file mapping");
-			free(fiemap);
 			return -1;
 		}
-		mapped = block;
-	} else {
-		if (fiemap->fm_mapped_extents) {
-			if (fiemap->fm_extents[0].fe_flags &
-			    FIEMAP_EXTENT_ENCODED) {
-				error_reason("File mapping is encoded");
-				free(fiemap);
-				return -1;
-			}
-			/*
-			 * returned extent may start prior to our request
-			 */
-			map_offset = fiemap->fm_start -
-				     fiemap->fm_extents[0].fe_logical;
-			mapped = fiemap->fm_extents[0].fe_physical +
-				 map_offset;
-			/* set mapped to fs block units */
-			mapped = mapped / info->fs_block_size;
-		} else {
-			mapped = 0;
-		}
-	}
-
-	free(fiemap);
-
-	if (mapped == 0) {
-		/* This is a hole in the file */
-		*physical = 0;
-	} else {
-		/* Convert file system block to physical */
-		*physical = mapped * phy_per_fs + subblock;
-		/* Add partition start */
-		*physical += info->geo.start;
+		physical[i] = fs_block_to_physical(block, first + i, info);
 	}
 	return 0;
 }
 
+/* Retrieve the physical blocknumber (block on disk) of the specified logical
+ * block (block in file). FD provides the file descriptor, LOGICAL is the
+ * logical block number. Upon success, return 0 and store the physical
+ * blocknumber in the variable pointed to by PHYSICAL. Return non-zero
+ * otherwise. */
+int
+disk_get_blocknum(int fd, int fd_is_basedisk, blocknum_t logical,
+		  blocknum_t* physical, struct disk_info* info)
+{
+	return get_blocknums(fd, fd_is_basedisk, logical, 1, physical, info);
+}
+
 
 /* Return the cylinder on which the block number BLOCKNUM is stored on the
  * CHS device identified by INFO. */
@@ -726,19 +785,13 @@ disk_blockptr_from_blocknum(disk_blockptr_t* ptr, blocknum_t blocknum,
 }
 
 
-/* Write BYTECOUNT bytes of data from memory at location DATA as a block to
- * the file identified by file descriptor FD. Make sure that the data is
- * aligned on a block size boundary and that at most INFO->PHY_BLOCK_SIZE
- * bytes are written. INFO provides information about the disk layout. Upon
- * success, return 0 and store the pointer to the resulting disk block to BLOCK
- * (if BLOCK is not NULL). Return non-zero otherwise. */
+/* Move the position of the file identified by file descriptor FD to the
+ * next block size boundary. Upon success, return 0 and store the number of
+ * the block at the new position in CURRENT_BLOCK. Return non-zero
+ * otherwise. */
 static int
-disk_write_block_aligned_base(int fd, int is_base_disk, const void* data,
-			      size_t bytecount, disk_blockptr_t* block,
-			      struct disk_info* info)
+align_file_pos(int fd, blocknum_t* current_block, struct disk_info* info)
 {
-	blocknum_t current_block;
-	blocknum_t blocknum;
 	off_t current_pos;
 	int align;
 
@@ -756,10 +809,30 @@ disk_write_block_aligned_base(int fd, int is_base_disk, const void* data,
 			return -1;
 		}
 	}
-	current_block = current_pos / align;
+	*current_block = current_pos / align;
+	return 0;
+}
+
+
+/* Write BYTECOUNT bytes of data from memory at location DATA as a block to
+ * the file identified by file descriptor FD. Make sure that the data is
+ * aligned on a block size boundary and that at most INFO->PHY_BLOCK_SIZE
+ * bytes are written. INFO provides information about the disk layout. Upon
+ * success, return 0 and store the pointer to the resulting disk block to BLOCK
+ * (if BLOCK is not NULL). Return non-zero otherwise. */
+static int
+disk_write_block_aligned_base(int fd, int is_base_disk, const void* data,
+			      size_t bytecount, disk_blockptr_t* block,
+			      struct disk_info* info)
+{
+	blocknum_t current_block;
+	blocknum_t blocknum;
+
+	if (align_file_pos(fd, &current_block, info))
+		return -1;
 	/* Ensure maximum size */
-	if (bytecount > (size_t) align)
-		bytecount = align;
+	if (bytecount > (size_t) info->phy_block_size)
+		bytecount = info->phy_block_size;
 	/* Write data block */
 	if (misc_write(fd, data, bytecount))
 		return -1;
@@ -793,11 +866,10 @@ disk_write_block_buffer(int fd, int fd_is_basedisk, const void* buffer,
 			struct disk_info* info)
 {
 	disk_blockptr_t* list;
+	blocknum_t* blocknums;
+	blocknum_t first;
 	blocknum_t count;
 	blocknum_t i;
-	size_t written;
-	size_t chunk_size;
-	int rc;
 
 	count = (bytecount + info->phy_block_size - 1) / info->phy_block_size;
 	list = (disk_blockptr_t *) misc_malloc(sizeof(disk_blockptr_t) *
@@ -807,22 +879,29 @@ disk_write_block_buffer(int fd, int fd_is_basedisk, const void* buffer,
 		return 0;
 	}
 	memset((void *) list, 0, sizeof(disk_blockptr_t) * count);
+	blocknums = misc_malloc(sizeof(blocknum_t) * count);
+	if (blocknums == NULL)
+		goto out_free_list;
+	/* After the first block all blocks are written back to back, so the
+	 * whole buffer can be written and mapped at once */
+	if (align_file_pos(fd, &first, info))
+		goto out_free_blocknums;
+	if (misc_write(fd, buffer, bytecount))
+		goto out_free_blocknums;
 	/* Build list */
-	for (i=0, written=0; i < count; i++, written += chunk_size) {
-		chunk_size = bytecount - written;
-		if (chunk_size > (size_t) info->phy_block_size)
-			chunk_size = info->phy_block_size;
-		rc = disk_write_block_aligned_base(fd, fd_is_basedisk,
-						   VOID_ADD(buffer, written),
-				chunk_size,
-				&list[i], info);
-		if (rc) {
-			free(list);
-			return 0;
-		}
-	}
+	if (get_blocknums(fd, fd_is_basedisk, first, count, blocknums, info))
+		goto out_free_blocknums;
+	for (i = 0; i < count; i++)
+		disk_blockptr_from_blocknum(&list[i], blocknums[i], info);
+	free(blocknums);
 	*blocklist = list;
 	return count;
+
+out_free_blocknums:
+	free(blocknums);
+out_free_list:
+	free(list);
+	return 0;
 }
 
 
@@ -1071,11 +1150,11 @@ disk_get_blocklist_from_file(const char* filename, disk_blockptr_t** blocklist,
 			     struct disk_info* info)
 {
 	disk_blockptr_t* list;
+	blocknum_t* blocknums;
 	struct stat stats;
 	int fd;
 	blocknum_t count;
 	blocknum_t i;
-	blocknum_t blocknum;
 
 	fd = open(filename, O_RDONLY);
 	if (fd == -1) {
@@ -1105,15 +1184,22 @@ disk_get_blocklist_from_file(const char* filename, disk_blockptr_t** blocklist,
 		return 0;
 	}
 	memset((void *) list, 0, sizeof(disk_blockptr_t) * count);
-	/* Build list */
-	for (i=0; i < count; i++) {
-		if (disk_get_blocknum(fd, 0, i, &blocknum, info)) {
-			free(list);
-			close(fd);
-			return 0;
-		}
-		disk_blockptr_from_blocknum(&list[i], blocknum, info);
+	blocknums = misc_malloc(sizeof(blocknum_t) * count);
+	if (blocknums == NULL) {
+		free(list);
+		close(fd);
+		return 0;
+	}
+	/* Build list from one walk over the extents of the file */
+	if (get_blocknums(fd, 0, 0, count, blocknums, info)) {
+		free(blocknums);
+		free(list);
+		close(fd);
+		return 0;
 	}
+	for (i=0; i < count; i++)
+		disk_blockptr_from_blocknum(&list[i], blocknums[i], info);
+	free(blocknums);
 	close(fd);
 	*blocklist = list;
 	return count;
@@ -14,12 +14,14 @@
 #include <err.h>
 #include <errno.h>
 #include <fnmatch.h>
+#include <pthread.h>
 #include <regex.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
+#include <openssl/evp.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -49,6 +51,12 @@ struct key_filenames {
 
 #define LOCK_FILE_NAME		".lock"
 
+#define INDEX_FILE_NAME		".index"
+#define INDEX_VERSION		"zkey-index-1"
+#define INDEX_HASH_NAME		"__hash__"
+#define INDEX_DIGEST_LEN	32
+#define INDEX_RACY_SECONDS	1
+
 #define VOLUME_TYPE_PLAIN	"plain"
 #define VOLUME_TYPE_LUKS2	"luks2"
 #ifdef HAVE_LUKS2_SUPPORT
@@ -941,6 +949,573 @@ static int _keystore_info_file_filter(const struct dirent *dirent)
 	return 0;
 }
 
+/*
+ * The key repository index caches the properties that are used for
+ * filtering (volumes, APQNs, volume and key type, KMS binding) of every key.
+ * An entry is only used as long as the size, inode and time stamps of the
+ * key's info file are unchanged, otherwise the info file is loaded again.
+ * The index is only read and written while the repository lock is held.
+ */
+struct key_index_entry {
+	char *name;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct timespec ctime;
+	char *volumes;
+	char *apqns;
+	char *volume_type;
+	char *key_type;
+	bool kms_bound;
+	bool seen;
+};
+
+struct key_index {
+	struct key_index_entry *entries;
+	size_t num;
+	size_t size;
+	bool dirty;
+};
+
+/**
+ * Frees the strings of an index entry
+ *
+ * @param[in] entry      the index entry
+ */
+static void _keystore_index_free_entry(struct key_index_entry *entry)
+{
+	free(entry->name);
+	free(entry->volumes);
+	free(entry->apqns);
+	free(entry->volume_type);
+	free(entry->key_type);
+}
+
+/**
+ * Frees a key repository index
+ *
+ * @param[in] index      the index
+ */
+static void _keystore_index_free(struct key_index *index)
+{
+	size_t i;
+
+	if (index == NULL)
+		return;
+
+	for (i = 0; i < index->num; i++)
+		_keystore_index_free_entry(&index->entries[i]);
+	free(index->entries);
+	free(index);
+}
+
+/**
+ * Searches the index entry for a key. The entries are sorted by name.
+ *
+ * @param[in] index      the index
+ * @param[in] name       the name of the key
+ * @param[out] pos       the position of the entry, or the position where it
+ *                       would have to be inserted
+ *
+ * @returns the index entry, or NULL if the key is not in the index
+ */
+static struct key_index_entry *_keystore_index_find(struct key_index *index,
+						    const char *name,
+						    size_t *pos)
+{
+	size_t low = 0, high = index->num, mid;
+	int cmp;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		cmp = strcmp(name, index->entries[mid].name);
+		if (cmp == 0) {
+			low = mid;
+			break;
+		}
+		if (cmp < 0)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	if (pos != NULL)
+		*pos = low;
+	if (low < index->num && strcmp(name, index->entries[low].name) == 0)
+		return &index->entries[low];
+	return NULL;
+}
+
+/**
+ * Removes the index entry of a key, if there is one
+ *
+ * @param[in] index      the index
+ * @param[in] name       the name of the key
+ */
+static void _keystore_index_remove(struct key_index *index, const char *name)
+{
+	struct key_index_entry *entry;
+	size_t pos;
+
+	entry = _keystore_index_find(index, name, &pos);
+	if (entry == NULL)
+		return;
+
+	_keystore_index_free_entry(entry);
+	memmove(entry, entry + 1, (index->num - pos - 1) * sizeof(*entry));
+	index->num--;
+	index->dirty = true;
+}
+
+/**
+ * Returns the index entry of a key. A new entry is inserted if the key is
+ * not yet in the index.
+ *
+ * @param[in] index      the index
+ * @param[in] name       the name of the key
+ *
+ * @returns the index entry
+ */
+static struct key_index_entry *_keystore_index_get_entry(
+						struct key_index *index,
+						const char *name)
+{
+	struct key_index_entry *entry;
+	size_t pos;
+
+	entry = _keystore_index_find(index, name, &pos);
+	if (entry != NULL) {
+		_keystore_index_free_entry(entry);
+	} else {
+		if (index->num == index->size) {
+			index->size = index->size ? index->size * 2 : 64;
+			index->entries = util_realloc(index->entries,
+					index->size * sizeof(*entry));
+		}
+		entry = &index->entries[pos];
+		memmove(entry + 1, entry, (index->num - pos) * sizeof(*entry));
+		index->num++;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->name = util_strdup(name);
+	index->dirty = true;
+	return entry;
+}
+
+/**
+ * Checks if an index entry still describes the info file of the key
+ *
+ * @param[in] entry      the index entry
+ * @param[in] sb         the stat information of the info file
+ *
+ * @returns true if the entry is up to date, false otherwise
+ */
+static bool _keystore_index_entry_valid(struct key_index_entry *entry,
+					struct stat *sb)
+{
+	return entry->ino == sb->st_ino && entry->size == sb->st_size &&
+	       entry->mtime.tv_sec == sb->st_mtim.tv_sec &&
+	       entry->mtime.tv_nsec == sb->st_mtim.tv_nsec &&
+	       entry->ctime.tv_sec == sb->st_ctim.tv_sec &&
+	       entry->ctime.tv_nsec == sb->st_ctim.tv_nsec;
+}
+
+/**
+ * Adds or updates the index entry of a key from its properties
+ *
+ * Info files that have been changed within the last INDEX_RACY_SECONDS are
+ * not indexed, because a further change within the granularity of the file
+ * system time stamps could not be detected.
+ *
+ * @param[in] index      the index
+ * @param[in] name       the name of the key
+ * @param[in] sb         the stat information of the info file
+ * @param[in] key_props  the properties of the key
+ */
+static void _keystore_index_update(struct key_index *index, const char *name,
+				   struct stat *sb,
+				   struct properties *key_props)
+{
+	char *volumes, *apqns, *volume_type, *key_type;
+	struct key_index_entry *entry;
+	time_t now = time(NULL);
+
+	volumes = properties_get(key_props, PROP_NAME_VOLUMES);
+	apqns = properties_get(key_props, PROP_NAME_APQNS);
+	volume_type = _keystore_get_volume_type(key_props);
+	key_type = _keystore_get_key_type(key_props);
+
+	if (sb->st_mtim.tv_sec >= now - INDEX_RACY_SECONDS ||
+	    sb->st_ctim.tv_sec >= now - INDEX_RACY_SECONDS ||
+	    strchr(name, '\t') != NULL ||
+	    (volumes != NULL && strchr(volumes, '\t') != NULL) ||
+	    (apqns != NULL && strchr(apqns, '\t') != NULL) ||
+	    strchr(volume_type, '\t') != NULL ||
+	    strchr(key_type, '\t') != NULL) {
+		_keystore_index_remove(index, name);
+		free(volumes);
+		free(apqns);
+		free(volume_type);
+		free(key_type);
+		return;
+	}
+
+	entry = _keystore_index_get_entry(index, name);
+	entry->ino = sb->st_ino;
+	entry->size = sb->st_size;
+	entry->mtime = sb->st_mtim;
+	entry->ctime = sb->st_ctim;
+	entry->volumes = volumes != NULL ? volumes : util_strdup("");
+	entry->apqns = apqns != NULL ? apqns : util_strdup("");
+	entry->volume_type = volume_type;
+	entry->key_type = key_type;
+	entry->kms_bound = _keystore_is_kms_bound_key(key_props, NULL);
+	entry->seen = true;
+}
+
+/**
+ * Marks the index entry of a key as seen in the repository directory
+ *
+ * @param[in] index      the index
+ * @param[in] name       the name of the key
+ */
+static void _keystore_index_mark_seen(struct key_index *index,
+				      const char *name)
+{
+	struct key_index_entry *entry;
+
+	entry = _keystore_index_find(index, name, NULL);
+	if (entry != NULL)
+		entry->seen = true;
+}
+
+/**
+ * Removes all index entries of keys that have not been seen in the
+ * repository directory and resets the seen marks
+ *
+ * @param[in] index      the index
+ */
+static void _keystore_index_prune(struct key_index *index)
+{
+	size_t i, k;
+
+	for (i = 0, k = 0; i < index->num; i++) {
+		if (!index->entries[i].seen) {
+			_keystore_index_free_entry(&index->entries[i]);
+			index->dirty = true;
+			continue;
+		}
+		index->entries[i].seen = false;
+		index->entries[k++] = index->entries[i];
+	}
+	index->num = k;
+}
+
+/**
+ * Computes the SHA-256 digest of the index data as hex string
+ *
+ * @param[in] data       the index data
+ * @param[in] len        the length of the data
+ * @param[out] hex       buffer for the hex string
+ */
+static void _keystore_index_digest(const char *data, size_t len,
+				   char hex[INDEX_DIGEST_LEN * 2 + 1])
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_len, i;
+	int rc;
+
+	rc = EVP_Digest(data, len, digest, &digest_len, EVP_sha256(), NULL);
+	util_assert(rc == 1 && digest_len == INDEX_DIGEST_LEN,
+		    "Internal error: SHA-256 digest failed");
+
+	for (i = 0; i < digest_len; i++)
+		sprintf(&hex[i * 2], "%02x", digest[i]);
+	hex[digest_len * 2] = '\0';
+}
+
+/**
+ * Parses one line of the index file and adds the entry to the index
+ *
+ * @param[in] index      the index
+ * @param[in] line       the line without the trailing newline
+ *
+ * @returns 0 on success, -EINVAL if the line is not valid
+ */
+static int _keystore_index_parse_line(struct key_index *index, char *line)
+{
+	char *field[12], *end;
+	struct key_index_entry *entry;
+	unsigned long long val[6];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(field); i++) {
+		field[i] = strsep(&line, "\t");
+		if (field[i] == NULL)
+			return -EINVAL;
+	}
+	if (line != NULL || strlen(field[0]) == 0)
+		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(val); i++) {
+		errno = 0;
+		val[i] = strtoull(field[i + 1], &end, 10);
+		if (errno != 0 || *end != '\0' || end == field[i + 1])
+			return -EINVAL;
+	}
+	if (strcmp(field[11], "0") != 0 && strcmp(field[11], "1") != 0)
+		return -EINVAL;
+	if (index->num > 0 &&
+	    strcmp(index->entries[index->num - 1].name, field[0]) >= 0)
+		return -EINVAL;
+
+	entry = _keystore_index_get_entry(index, field[0]);
+	entry->ino = val[0];
+	entry->size = val[1];
+	entry->mtime.tv_sec = val[2];
+	entry->mtime.tv_nsec = val[3];
+	entry->ctime.tv_sec = val[4];
+	entry->ctime.tv_nsec = val[5];
+	entry->volumes = util_strdup(field[7]);
+	entry->apqns = util_strdup(field[8]);
+	entry->volume_type = util_strdup(field[9]);
+	entry->key_type = util_strdup(field[10]);
+	entry->kms_bound = field[11][0] == '1';
+	return 0;
+}
+
+/**
+ * Loads the index of the key repository. If the index file does not exist
+ * or is not valid, an empty index is returned, that is then rebuilt while
+ * the keys are processed.
+ *
+ * @param[in] keystore   the key store
+ *
+ * @returns the index
+ */
+static struct key_index *_keystore_index_load(struct keystore *keystore)
+{
+	char hex[INDEX_DIGEST_LEN * 2 + 1];
+	struct key_index *index;
+	char *filename, *data = NULL;
+	char *line, *next, *hash;
+	size_t data_len = 0;
+	struct stat sb;
+	FILE *fp;
+
+	index = util_zalloc(sizeof(struct key_index));
+	index->dirty = true;
+
+	util_asprintf(&filename, "%s/%s", keystore->directory,
+		      INDEX_FILE_NAME);
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		pr_verbose(keystore, "No repository index, rebuilding it");
+		goto out;
+	}
+	if (fstat(fileno(fp), &sb) != 0 || sb.st_size == 0) {
+		fclose(fp);
+		goto invalid;
+	}
+	data = util_malloc(sb.st_size + 1);
+	data_len = fread(data, 1, sb.st_size, fp);
+	fclose(fp);
+	data[data_len] = '\0';
+
+	/* The last line contains the digest of all lines before it */
+	if (data_len == 0 || data[data_len - 1] != '\n')
+		goto invalid;
+	data[data_len - 1] = '\0';
+	hash = strrchr(data, '\n');
+	if (hash == NULL)
+		goto invalid;
+	hash++;
+	if (strncmp(hash, INDEX_HASH_NAME "\t",
+		    strlen(INDEX_HASH_NAME) + 1) != 0)
+		goto invalid;
+	_keystore_index_digest(data, hash - data, hex);
+	if (strcmp(hash + strlen(INDEX_HASH_NAME) + 1, hex) != 0)
+		goto invalid;
+
+	next = strchr(data, '\n');
+	*next = '\0';
+	if (strcmp(data, INDEX_VERSION) != 0)
+		goto invalid;
+	for (line = next + 1; line < hash; line = next + 1) {
+		next = strchr(line, '\n');
+		*next = '\0';
+		if (_keystore_index_parse_line(index, line) != 0)
+			goto invalid;
+	}
+	index->dirty = false;
+	pr_verbose(keystore, "Repository index loaded with %lu keys",
+		   (unsigned long)index->num);
+	goto out;
+
+invalid:
+	pr_verbose(keystore, "Repository index is not valid, rebuilding it");
+	_keystore_index_free(index);
+	index = util_zalloc(sizeof(struct key_index));
+	index->dirty = true;
+out:
+	free(data);
+	free(filename);
+	return index;
+}
+
+/**
+ * Returns the index of the key repository. The index is loaded on first use.
+ *
+ * @param[in] keystore   the key store
+ *
+ * @returns the index
+ */
+static struct key_index *_keystore_index(struct keystore *keystore)
+{
+	if (keystore->index == NULL)
+		keystore->index = _keystore_index_load(keystore);
+	return keystore->index;
+}
+
+/**
+ * Writes the index of the key repository, if it has been changed. The index
+ * is written to a temporary file which then replaces the index file.
+ *
+ * @param[in] keystore   the key store
+ *
+ * @returns 0 on success, or a negative errno value on failure
+ */
+static int _keystore_index_save(struct keystore *keystore)
+{
+	char hex[INDEX_DIGEST_LEN * 2 + 1];
+	struct key_index *index = keystore->index;
+	char *filename, *tmp_filename;
+	struct key_index_entry *entry;
+	char *data = NULL;
+	size_t data_len;
+	FILE *fp;
+	size_t i;
+	int rc;
+
+	if (index == NULL || !index->dirty)
+		return 0;
+
+	fp = open_memstream(&data, &data_len);
+	if (fp == NULL)
+		return -ENOMEM;
+	fprintf(fp, "%s\n", INDEX_VERSION);
+	for (i = 0; i < index->num; i++) {
+		entry = &index->entries[i];
+		fprintf(fp, "%s\t%llu\t%llu\t%llu\t%lu\t%llu\t%lu\t%s\t%s\t%s\t"
+			"%s\t%d\n", entry->name,
+			(unsigned long long)entry->ino,
+			(unsigned long long)entry->size,
+			(unsigned long long)entry->mtime.tv_sec,
+			(unsigned long)entry->mtime.tv_nsec,
+			(unsigned long long)entry->ctime.tv_sec,
+			(unsigned long)entry->ctime.tv_nsec,
+			entry->volumes, entry->apqns, entry->volume_type,
+			entry->key_type, entry->kms_bound ? 1 : 0);
+	}
+	fclose(fp);
+	_keystore_index_digest(data, data_len, hex);
+
+	util_asprintf(&filename, "%s/%s", keystore->directory,
+		      INDEX_FILE_NAME);
+	util_asprintf(&tmp_filename, "%s.tmp", filename);
+
+	fp = fopen(tmp_filename, "w");
+	if (fp == NULL) {
+		rc = -errno;
+		goto out;
+	}
+	fwrite(data, 1, data_len, fp);
+	fprintf(fp, "%s\t%s\n", INDEX_HASH_NAME, hex);
+	if (fclose(fp) != 0) {
+		rc = -errno;
+		remove(tmp_filename);
+		goto out;
+	}
+
+	rc = _keystore_set_file_permission(keystore, tmp_filename);
+	if (rc != 0) {
+		remove(tmp_filename);
+		goto out;
+	}
+
+	if (rename(tmp_filename, filename) != 0) {
+		rc = -errno;
+		remove(tmp_filename);
+		goto out;
+	}
+	index->dirty = false;
+	rc = 0;
+
+out:
+	if (rc != 0)
+		pr_verbose(keystore, "Failed to write the repository index: "
+			   "%s", strerror(-rc));
+	free(tmp_filename);
+	free(filename);
+	free(data);
+	return rc;
+}
+
+/**
+ * Checks if an index entry matches the filters of _keystore_process_filtered.
+ *
+ * @returns 1 for a match, 0 for not matched
+ */
+static int _keystore_index_match(struct keystore *keystore,
+				 struct key_index_entry *entry,
+				 char **vol_filter_list,
+				 char **apqn_filter_list,
+				 const char *volume_type,
+				 const char *key_type,
+				 bool local, bool kms_bound)
+{
+	if (_keystore_match_filter(entry->volumes, vol_filter_list,
+				   NULL) == 0) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out due to volumes filter",
+			   entry->name);
+		return 0;
+	}
+	if (_keystore_match_filter(entry->apqns, apqn_filter_list,
+				   _keystore_apqn_match) == 0) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out due to APQN filter",
+			   entry->name);
+		return 0;
+	}
+	if (volume_type != NULL &&
+	    strcasecmp(entry->volume_type, volume_type) != 0) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out due to volume type",
+			   entry->name);
+		return 0;
+	}
+	if (key_type != NULL && strcasecmp(entry->key_type, key_type) != 0) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out due to key type",
+			   entry->name);
+		return 0;
+	}
+	if (local && entry->kms_bound) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out because it is KMS "
+			   "bound", entry->name);
+		return 0;
+	}
+	if (kms_bound && !entry->kms_bound) {
+		pr_verbose(keystore,
+			   "Key '%s' filtered out because it is not "
+			   "KMS bound", entry->name);
+		return 0;
+	}
+	return 1;
+}
+
 typedef int (*process_key_t)(struct keystore *keystore,
 			     const char *name, struct properties *properties,
 			     struct key_filenames *file_names, void *private);
@@ -986,12 +1561,16 @@ static int _keystore_process_filtered(struct keystore *keystore,
 				      void *process_private)
 {
 	struct key_filenames file_names = { NULL, NULL, NULL };
+	struct key_index_entry *index_entry;
 	char **apqn_filter_list = NULL;
 	char **vol_filter_list = NULL;
 	struct properties *key_props;
 	struct dirent **namelist;
+	struct key_index *index;
 	int n, i, rc = 0;
 	bool skip = 0;
+	struct stat sb;
+	bool have_sb;
 	char *name;
 	int len;
 
@@ -1014,15 +1593,18 @@ static int _keystore_process_filtered(struct keystore *keystore,
 		return rc;
 	}
 
-	for (i = 0; i < n ; i++) {
-		if (skip)
-			goto free;
+	index = _keystore_index(keystore);
 
+	for (i = 0; i < n ; i++) {
 		name = namelist[i]->d_name;
 		len = strlen(name);
 		if (len > FILE_EXTENSION_LEN)
 			name[len - FILE_EXTENSION_LEN] = '\0';
 
+		_keystore_index_mark_seen(index, name);
+		if (skip)
+			goto free;
+
 		if (_keystore_match_name_filter(name, name_filter) == 0) {
 			pr_verbose(keystore,
 				   "Key '%s' filtered out due to name filter",
@@ -1038,6 +1620,27 @@ static int _keystore_process_filtered(struct keystore *keystore,
 		if (rc != 0)
 			goto free_names;
 
+		/*
+		 * Use the index to filter out keys without loading their
+		 * info file, as long as the info file has not changed.
+		 */
+		index_entry = NULL;
+		have_sb = stat(file_names.info_filename, &sb) == 0;
+		if (have_sb) {
+			index_entry = _keystore_index_find(index, name, NULL);
+			if (index_entry != NULL &&
+			    !_keystore_index_entry_valid(index_entry, &sb))
+				index_entry = NULL;
+		}
+		if (index_entry != NULL &&
+		    _keystore_index_match(keystore, index_entry,
+					  vol_filter_list, apqn_filter_list,
+					  volume_type, key_type, local,
+					  kms_bound) == 0) {
+			rc = 0;
+			goto free_names;
+		}
+
 		key_props = properties_new();
 		rc = properties_load(key_props, file_names.info_filename, 1);
 		if (rc != 0) {
@@ -1045,6 +1648,9 @@ static int _keystore_process_filtered(struct keystore *keystore,
 			goto free_prop;
 		}
 
+		if (have_sb && index_entry == NULL)
+			_keystore_index_update(index, name, &sb, key_props);
+
 		rc = _keystore_match_filter_property(key_props,
 						     PROP_NAME_VOLUMES,
 						     vol_filter_list, NULL);
@@ -1116,6 +1722,8 @@ free:
 	}
 	free(namelist);
 
+	_keystore_index_prune(index);
+
 	if (vol_filter_list)
 		str_list_free_string_array(vol_filter_list);
 	if (apqn_filter_list)
@@ -2810,10 +3418,392 @@ static void _keystore_print_record(struct util_rec *rec,
 		free(label_argz);
 }
 
+/*
+ * Reading and validating the secure keys of a bulk operation is done by a
+ * pool of worker threads, because the validation blocks in the pkey device
+ * driver until the crypto adapters have answered. The worker threads do not
+ * print anything, they only store the key and the validation result.
+ * Everything else, like printing messages, calling the CCA or EP11 host
+ * library and writing files, is still done in the main thread, key by key in
+ * repository order. A key that a worker thread could not read is read again
+ * by the main thread, which then reports the error.
+ */
+struct key_prefetch {
+	char *name;
+	char *key_filename;
+	char *apqns;
+	u8 *secure_key;
+	size_t secure_key_size;
+	size_t clear_key_bitsize;
+	int is_old_mk;
+	int rc;
+	bool done;
+};
+
+struct key_prefetch_pool {
+	int pkey_fd;
+	bool complete;
+	struct key_prefetch *keys;
+	unsigned long num;
+	unsigned long size;
+	unsigned long next_work;
+	unsigned long next_use;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	int num_threads;
+};
+
+/**
+ * Adds a key to the prefetch pool.
+ *
+ * @param[in] pool       the prefetch pool
+ * @param[in] name       the name of the key
+ * @param[in] apqns      the APQNs of the key (can be empty)
+ * @param[in] file_names the file names used by this key
+ */
+static void _keystore_prefetch_add(struct key_prefetch_pool *pool,
+				   const char *name, const char *apqns,
+				   struct key_filenames *file_names)
+{
+	struct key_prefetch *key;
+
+	if (pool->num == pool->size) {
+		pool->size = pool->size ? pool->size * 2 : 64;
+		pool->keys = util_realloc(pool->keys,
+					  pool->size * sizeof(*key));
+	}
+	key = &pool->keys[pool->num++];
+	memset(key, 0, sizeof(*key));
+	key->name = util_strdup(name);
+	/* An empty APQN list is the same as no APQN list */
+	if (*apqns != '\0')
+		key->apqns = util_strdup(apqns);
+
+	/* Completing a re-encipherment uses the re-enciphered key */
+	if (!pool->complete)
+		key->key_filename = util_strdup(file_names->skey_filename);
+	else if (_keystore_reencipher_key_exists(file_names))
+		key->key_filename = util_strdup(file_names->renc_filename);
+
+	/* Inconsistent keys are reported when they are processed */
+	if (key->key_filename == NULL ||
+	    _keystore_exists_keyfiles(file_names) != 1)
+		key->done = true;
+}
+
+/**
+ * Collects the keys that match the name and APQN filters in the order in
+ * which _keystore_process_filtered processes them.
+ *
+ * The APQNs of the keys are taken from the repository index, so that the
+ * info files are not loaded a second time. Only the info files of keys
+ * without an up-to-date index entry are loaded here, and their index
+ * entries are updated.
+ *
+ * @param[in] keystore    the key store
+ * @param[in] pool        the prefetch pool
+ * @param[in] name_filter the name filter (can be NULL)
+ * @param[in] apqn_filter the APQN filter (can be NULL)
+ *
+ * @returns 0 for success or a negative errno in case of an error
+ */
+static int _keystore_prefetch_collect(struct keystore *keystore,
+				      struct key_prefetch_pool *pool,
+				      const char *name_filter,
+				      const char *apqn_filter)
+{
+	struct key_filenames file_names = { NULL, NULL, NULL };
+	struct key_index_entry *entry;
+	char **apqn_filter_list = NULL;
+	struct properties *key_props;
+	struct dirent **namelist;
+	struct key_index *index;
+	char *name, *apqns;
+	struct stat sb;
+	int n, i, len;
+
+	n = scandir(keystore->directory, &namelist, _keystore_info_file_filter,
+		    alphasort);
+	if (n == -1)
+		return -errno;
+
+	if (apqn_filter != NULL)
+		apqn_filter_list = str_list_split(apqn_filter);
+	index = _keystore_index(keystore);
+
+	for (i = 0; i < n; i++) {
+		name = namelist[i]->d_name;
+		len = strlen(name);
+		if (len > FILE_EXTENSION_LEN)
+			name[len - FILE_EXTENSION_LEN] = '\0';
+
+		if (_keystore_match_name_filter(name, name_filter) == 0)
+			goto free;
+		if (_keystore_get_key_filenames(keystore, name,
+						&file_names) != 0)
+			goto free;
+		if (stat(file_names.info_filename, &sb) != 0)
+			goto free_names;
+
+		entry = _keystore_index_find(index, name, NULL);
+		if (entry != NULL && _keystore_index_entry_valid(entry, &sb)) {
+			apqns = util_strdup(entry->apqns);
+		} else {
+			/* Invalid keys are reported when they are processed */
+			key_props = properties_new();
+			if (properties_load(key_props, file_names.info_filename,
+					    1) != 0) {
+				properties_free(key_props);
+				goto free_names;
+			}
+			_keystore_index_update(index, name, &sb, key_props);
+			apqns = properties_get(key_props, PROP_NAME_APQNS);
+			if (apqns == NULL)
+				apqns = util_strdup("");
+			properties_free(key_props);
+		}
+
+		if (_keystore_match_filter(apqns, apqn_filter_list,
+					   _keystore_apqn_match) != 0)
+			_keystore_prefetch_add(pool, name, apqns, &file_names);
+		free(apqns);
+
+free_names:
+		_keystore_free_key_filenames(&file_names);
+free:
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	if (apqn_filter_list)
+		str_list_free_string_array(apqn_filter_list);
+	return 0;
+}
+
+/**
+ * Reads the secure key of a prefetched key without printing any messages.
+ *
+ * @param[in] key        the prefetched key
+ * @param[in] size       the size of the key file
+ *
+ * @returns a buffer containing the secure key, or NULL in case of an error
+ */
+static u8 *_keystore_prefetch_read(struct key_prefetch *key, size_t size)
+{
+	FILE *fp;
+	u8 *buf;
+
+	fp = fopen(key->key_filename, "r");
+	if (fp == NULL)
+		return NULL;
+
+	buf = util_malloc(size);
+	if (fread(buf, 1, size, fp) != size) {
+		free(buf);
+		buf = NULL;
+	} else {
+		key->secure_key_size = size;
+	}
+	fclose(fp);
+	return buf;
+}
+
+/**
+ * Worker thread that reads and validates the keys of the prefetch pool.
+ *
+ * @param[in] arg        the prefetch pool
+ *
+ * @returns NULL
+ */
+static void *_keystore_prefetch_thread(void *arg)
+{
+	struct key_prefetch_pool *pool = (struct key_prefetch_pool *)arg;
+	struct key_prefetch *key;
+	char **apqn_list;
+	struct stat sb;
+	unsigned long i;
+
+	while (1) {
+		pthread_mutex_lock(&pool->mutex);
+		do {
+			i = pool->next_work++;
+		} while (i < pool->num && pool->keys[i].done);
+		pthread_mutex_unlock(&pool->mutex);
+		if (i >= pool->num)
+			break;
+		key = &pool->keys[i];
+
+		/*
+		 * Leave unusable key files to the main thread, so that the
+		 * error messages appear in the order of the keys.
+		 */
+		if (stat(key->key_filename, &sb) != 0 ||
+		    (size_t)sb.st_size < MIN_SECURE_KEY_SIZE ||
+		    (size_t)sb.st_size > 2 * MAX_SECURE_KEY_SIZE)
+			goto done;
+
+		key->secure_key = _keystore_prefetch_read(key, sb.st_size);
+		if (key->secure_key != NULL) {
+			apqn_list = key->apqns != NULL ?
+					str_list_split(key->apqns) : NULL;
+			key->rc = validate_secure_key(pool->pkey_fd,
+						      key->secure_key,
+						      key->secure_key_size,
+						      &key->clear_key_bitsize,
+						      &key->is_old_mk,
+						      (const char **)apqn_list,
+						      false);
+			if (apqn_list != NULL)
+				str_list_free_string_array(apqn_list);
+		}
+
+done:
+		pthread_mutex_lock(&pool->mutex);
+		key->done = true;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+	return NULL;
+}
+
+/**
+ * Frees the prefetch pool after all worker threads have finished.
+ *
+ * @param[in] pool       the prefetch pool (can be NULL)
+ */
+static void _keystore_prefetch_stop(struct key_prefetch_pool *pool)
+{
+	unsigned long i;
+	int k;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->next_work = pool->num;
+	pthread_mutex_unlock(&pool->mutex);
+	for (k = 0; k < pool->num_threads; k++)
+		pthread_join(pool->threads[k], NULL);
+
+	for (i = 0; i < pool->num; i++) {
+		free(pool->keys[i].name);
+		free(pool->keys[i].key_filename);
+		free(pool->keys[i].apqns);
+		free(pool->keys[i].secure_key);
+	}
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->cond);
+	free(pool->threads);
+	free(pool->keys);
+	free(pool);
+}
+
+/**
+ * Collects the keys that match the filters and starts worker threads that
+ * read and validate them in the background.
+ *
+ * @param[in] keystore    the key store
+ * @param[in] name_filter the name filter (can be NULL)
+ * @param[in] apqn_filter the APQN filter (can be NULL)
+ * @param[in] complete    if true, the re-enciphered keys are validated
+ * @param[in] jobs        the maximum number of worker threads
+ * @param[in] pkey_fd     the file descriptor of /dev/pkey
+ *
+ * @returns the prefetch pool, or NULL if the keys are to be processed
+ *          without worker threads
+ *
+ * In verbose mode the keys are always processed without worker threads, so
+ * that the verbose messages of each key appear together and in order.
+ */
+static struct key_prefetch_pool *_keystore_prefetch_start(
+						struct keystore *keystore,
+						const char *name_filter,
+						const char *apqn_filter,
+						bool complete, int jobs,
+						int pkey_fd)
+{
+	struct key_prefetch_pool *pool;
+	int rc;
+
+	if (jobs <= 1 || keystore->verbose)
+		return NULL;
+
+	pool = util_zalloc(sizeof(struct key_prefetch_pool));
+	pool->pkey_fd = pkey_fd;
+	pool->complete = complete;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	rc = _keystore_prefetch_collect(keystore, pool, name_filter,
+					apqn_filter);
+	if (rc != 0 || pool->num < 2)
+		goto out_free;
+
+	if ((unsigned long)jobs > pool->num)
+		jobs = pool->num;
+	pool->threads = util_malloc(jobs * sizeof(pthread_t));
+	for (; pool->num_threads < jobs; pool->num_threads++) {
+		rc = pthread_create(&pool->threads[pool->num_threads], NULL,
+				    _keystore_prefetch_thread, pool);
+		if (rc != 0)
+			break;
+	}
+	if (pool->num_threads == 0)
+		goto out_free;
+
+	return pool;
+
+out_free:
+	_keystore_prefetch_stop(pool);
+	return NULL;
+}
+
+/**
+ * Returns the prefetched secure key and its validation result. Waits until
+ * a worker thread has processed the key.
+ *
+ * @param[in] pool       the prefetch pool (can be NULL)
+ * @param[in] name       the name of the key
+ *
+ * @returns the prefetched key, or NULL if the key was not prefetched
+ */
+static struct key_prefetch *_keystore_prefetch_get(
+					struct key_prefetch_pool *pool,
+					const char *name)
+{
+	struct key_prefetch *key = NULL;
+	unsigned long i;
+
+	if (pool == NULL)
+		return NULL;
+
+	/* Keys are processed in the order in which they were collected */
+	for (i = pool->next_use; i < pool->num; i++) {
+		if (strcmp(pool->keys[i].name, name) == 0) {
+			key = &pool->keys[i];
+			pool->next_use = i + 1;
+			break;
+		}
+	}
+	if (key == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!key->done)
+		pthread_cond_wait(&pool->cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+	if (key->secure_key == NULL)
+		return NULL;
+
+	return key;
+}
+
 struct validate_info {
 	struct util_rec *rec;
 	int pkey_fd;
 	bool noapqncheck;
+	struct key_prefetch_pool *prefetch;
 	unsigned long int num_valid;
 	unsigned long int num_invalid;
 	unsigned long int num_warnings;
@@ -2920,6 +3910,7 @@ static int _keystore_process_validate(struct keystore *keystore,
 				      void *private)
 {
 	struct validate_info *info = (struct validate_info *)private;
+	struct key_prefetch *prefetch;
 	char **apqn_list = NULL;
 	size_t clear_key_bitsize;
 	size_t secure_key_size;
@@ -2929,24 +3920,40 @@ static int _keystore_process_validate(struct keystore *keystore,
 	int is_old_mk;
 	int rc, valid;
 
+	prefetch = _keystore_prefetch_get(info->prefetch, name);
+
 	rc = _keystore_ensure_keyfiles_exist(file_names, name);
 	if (rc != 0)
 		goto out;
 
-	secure_key = read_secure_key(file_names->skey_filename,
-				     &secure_key_size, keystore->verbose);
+	if (prefetch != NULL) {
+		secure_key = prefetch->secure_key;
+		secure_key_size = prefetch->secure_key_size;
+		prefetch->secure_key = NULL;
+	} else {
+		secure_key = read_secure_key(file_names->skey_filename,
+					     &secure_key_size,
+					     keystore->verbose);
+	}
 	if (secure_key == NULL) {
 		rc = -ENOENT;
 		goto out;
 	}
 
-	apqns = properties_get(properties, PROP_NAME_APQNS);
-	if (apqns != NULL)
-		apqn_list = str_list_split(apqns);
+	if (prefetch != NULL) {
+		rc = prefetch->rc;
+		clear_key_bitsize = prefetch->clear_key_bitsize;
+		is_old_mk = prefetch->is_old_mk;
+	} else {
+		apqns = properties_get(properties, PROP_NAME_APQNS);
+		if (apqns != NULL)
+			apqn_list = str_list_split(apqns);
 
-	rc = validate_secure_key(info->pkey_fd, secure_key, secure_key_size,
-				 &clear_key_bitsize, &is_old_mk,
-				 (const char **)apqn_list, keystore->verbose);
+		rc = validate_secure_key(info->pkey_fd, secure_key,
+					 secure_key_size, &clear_key_bitsize,
+					 &is_old_mk, (const char **)apqn_list,
+					 keystore->verbose);
+	}
 	if (rc != 0) {
 		valid = 0;
 		info->num_invalid++;
@@ -3005,12 +4012,13 @@ out:
  * @param[in] noapqncheck if true, the specified APQN(s) are not checked for
  *                        existence and type.
  * @param[in] pkey_fd     the file descriptor of /dev/pkey
+ * @param[in] jobs        the number of keys that are validated in parallel
  *
  * @returns 0 for success or a negative errno in case of an error
  */
 int keystore_validate_key(struct keystore *keystore, const char *name_filter,
 			  const char *apqn_filter, bool noapqncheck,
-			  int pkey_fd)
+			  int pkey_fd, int jobs)
 {
 	struct validate_info info;
 	struct util_rec *rec;
@@ -3026,11 +4034,15 @@ int keystore_validate_key(struct keystore *keystore, const char *name_filter,
 	info.num_valid = 0;
 	info.num_invalid = 0;
 	info.num_warnings = 0;
+	info.prefetch = _keystore_prefetch_start(keystore, name_filter,
+						 apqn_filter, false, jobs,
+						 pkey_fd);
 
 	rc = _keystore_process_filtered(keystore, name_filter, NULL,
 					apqn_filter, NULL, NULL, false, false,
 					_keystore_process_validate, &info);
 
+	_keystore_prefetch_stop(info.prefetch);
 	util_rec_free(rec);
 
 	if (rc != 0) {
@@ -3056,6 +4068,7 @@ struct reencipher_info {
 	struct reencipher_params params;
 	int pkey_fd;
 	struct ext_lib *lib;
+	struct key_prefetch_pool *prefetch;
 	unsigned long num_reenciphered;
 	unsigned long num_failed;
 	unsigned long num_skipped;
@@ -3184,6 +4197,7 @@ static int _keystore_process_reencipher(struct keystore *keystore,
 {
 	struct reencipher_info *info = (struct reencipher_info *)private;
 	struct reencipher_params params = info->params;
+	struct key_prefetch *prefetch;
 	size_t clear_key_bitsize;
 	size_t secure_key_size;
 	char **apqn_list = NULL;
@@ -3194,6 +4208,8 @@ static int _keystore_process_reencipher(struct keystore *keystore,
 	char *temp;
 	int rc;
 
+	prefetch = _keystore_prefetch_get(info->prefetch, name);
+
 	rc = _keystore_ensure_keyfiles_exist(file_names, name);
 	if (rc != 0)
 		goto out;
@@ -3216,22 +4232,37 @@ static int _keystore_process_reencipher(struct keystore *keystore,
 		params.inplace = 1;
 	}
 
-	secure_key = read_secure_key(params.complete ?
+	if (prefetch != NULL) {
+		secure_key = prefetch->secure_key;
+		secure_key_size = prefetch->secure_key_size;
+		prefetch->secure_key = NULL;
+	} else {
+		secure_key = read_secure_key(params.complete ?
 						file_names->renc_filename :
 						file_names->skey_filename,
-				     &secure_key_size, keystore->verbose);
+					     &secure_key_size,
+					     keystore->verbose);
+	}
 	if (secure_key == NULL) {
 		rc = -ENOENT;
 		goto out;
 	}
 
 	apqns = properties_get(properties, PROP_NAME_APQNS);
-	if (apqns != NULL)
-		apqn_list = str_list_split(apqns);
 
-	rc = validate_secure_key(info->pkey_fd, secure_key, secure_key_size,
-				 &clear_key_bitsize, &is_old_mk,
-				 (const char **)apqn_list, keystore->verbose);
+	if (prefetch != NULL) {
+		rc = prefetch->rc;
+		clear_key_bitsize = prefetch->clear_key_bitsize;
+		is_old_mk = prefetch->is_old_mk;
+	} else {
+		if (apqns != NULL)
+			apqn_list = str_list_split(apqns);
+
+		rc = validate_secure_key(info->pkey_fd, secure_key,
+					 secure_key_size, &clear_key_bitsize,
+					 &is_old_mk, (const char **)apqn_list,
+					 keystore->verbose);
+	}
 	if (rc != 0) {
 		if (params.complete) {
 			warnx("Key '%s' is not valid, re-enciphering is not "
@@ -3362,6 +4393,9 @@ out:
  * @param[in] complete     if true, a pending re-encipherment is completed
  * @param[in] pkey_fd      the file descriptor of /dev/pkey
  * @param[in] lib          the external library struct
+ * @param[in] jobs         the number of keys that are read and validated in
+ *                         parallel. The keys are still re-enciphered and
+ *                         written one after the other.
  * Note: if both fromOld and toNew are FALSE, then the reencipherement mode is
  *       detected automatically. If both are TRUE then the key is reenciphered
  *       from the OLD to the NEW master key.
@@ -3374,7 +4408,7 @@ int keystore_reencipher_key(struct keystore *keystore, const char *name_filter,
 			    const char *apqn_filter,
 			    bool from_old, bool to_new, bool inplace,
 			    bool staged, bool complete, int pkey_fd,
-			    struct ext_lib *lib)
+			    struct ext_lib *lib, int jobs)
 {
 	struct reencipher_info info;
 	int rc;
@@ -3394,11 +4428,16 @@ int keystore_reencipher_key(struct keystore *keystore, const char *name_filter,
 	info.num_failed = 0;
 	info.num_reenciphered = 0;
 	info.num_skipped = 0;
+	info.prefetch = _keystore_prefetch_start(keystore, name_filter,
+						 apqn_filter, complete, jobs,
+						 pkey_fd);
 
 	rc = _keystore_process_filtered(keystore, name_filter, NULL,
 					apqn_filter, NULL, NULL, false, false,
 					_keystore_process_reencipher, &info);
 
+	_keystore_prefetch_stop(info.prefetch);
+
 	if (rc != 0) {
 		pr_verbose(keystore, "Failed to re-encipher keys: %s",
 			   strerror(-rc));
@@ -5459,6 +6498,9 @@ void keystore_free(struct keystore *keystore)
 {
 	util_assert(keystore != NULL, "Internal error: keystore is NULL");
 
+	if (keystore->lock_fd != -1)
+		_keystore_index_save(keystore);
+	_keystore_index_free(keystore->index);
 	_keystore_unlock_repository(keystore);
 	free(keystore->directory);
 	free(keystore);
@@ -0,0 +1,100 @@
+/*
+ * zkey - Generate, re-encipher, and validate secure keys
+ *
+ * Mock pkey backend for benchmarking without crypto hardware
+ *
+ * Preload this library to let zkey validate secure keys without the pkey
+ * device driver, for example:
+ *
+ *   LD_PRELOAD=./pkey-mock.so zkey validate --jobs 16
+ *
+ * Opening /dev/pkey opens /dev/null instead. The PKEY_VERIFYKEY2 ioctl
+ * sleeps for ZKEY_PKEY_MOCK_DELAY_US microseconds (default 20000) to model
+ * the round trip to a crypto adapter, and then reports a CCA AES-256 data
+ * key. Keys with the lowest bit of byte 20 set are reported as enciphered
+ * with the OLD master key, all other keys with the CURRENT master key. All
+ * other pkey ioctls fail with ENOTTY, as with a kernel that does not
+ * support them.
+ *
+ * Copyright IBM Corp. 2026
+ *
+ * s390-tools is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "lib/zt_common.h"
+
+#include "pkey.h"
+
+#define DEFAULT_DELAY_US	20000
+
+static int pkey_fd = -1;
+
+int open(const char *path, int flags, ...)
+{
+	static int (*real_open)(const char *, int, ...);
+	mode_t mode = 0;
+	va_list ap;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (real_open == NULL)
+		real_open = dlsym(RTLD_NEXT, "open");
+	if (strcmp(path, PKEYDEVICE) == 0) {
+		pkey_fd = real_open("/dev/null", O_RDWR);
+		return pkey_fd;
+	}
+	return real_open(path, flags, mode);
+}
+
+static void mock_verifykey2(struct pkey_verifykey2 *verifykey2)
+{
+	static long delay_us = -1;
+	const char *env;
+
+	if (delay_us < 0) {
+		env = getenv("ZKEY_PKEY_MOCK_DELAY_US");
+		delay_us = env != NULL ? atol(env) : DEFAULT_DELAY_US;
+	}
+	usleep(delay_us);
+
+	verifykey2->type = PKEY_TYPE_CCA_DATA;
+	verifykey2->size = PKEY_SIZE_AES_256;
+	verifykey2->flags = (verifykey2->key[20] & 1) ?
+		PKEY_FLAGS_MATCH_ALT_MKVP : PKEY_FLAGS_MATCH_CUR_MKVP;
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	static int (*real_ioctl)(int, unsigned long, ...);
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	if (real_ioctl == NULL)
+		real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	if (fd != pkey_fd || pkey_fd == -1)
+		return real_ioctl(fd, request, arg);
+
+	if (request == PKEY_VERIFYKEY2) {
+		mock_verifykey2(arg);
+		return 0;
+	}
+	errno = ENOTTY;
+	return -1;
+}
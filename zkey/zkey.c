@@ -90,6 +90,7 @@ static struct zkey_globals {
 	bool open;
 	bool format;
 	bool refresh_properties;
+	long int jobs;
 	struct ext_lib lib;
 	struct cca_lib cca;
 	struct ep11_lib ep11;
@@ -102,6 +103,7 @@ static struct zkey_globals {
 } g = {
 	.pkey_fd = -1,
 	.sector_size = -1,
+	.jobs = 1,
 	.lib.cca = &g.cca,
 	.lib.ep11 = &g.ep11,
 };
@@ -338,6 +340,14 @@ static struct util_opt opt_vec[] = {
 			"associated with specific crypto cards",
 		.command = COMMAND_REENCIPHER,
 	},
+	{
+		.option = { "jobs", required_argument, NULL, 'j'},
+		.argument = "NUMBER",
+		.desc = "Number of secure AES keys in the repository that are "
+			"read and validated in parallel. The keys are still "
+			"re-enciphered one after the other. The default is 1",
+		.command = COMMAND_REENCIPHER,
+	},
 	/***********************************************************/
 	{
 		.flags = UTIL_OPT_FLAG_SECTION,
@@ -367,6 +377,13 @@ static struct util_opt opt_vec[] = {
 		.command = COMMAND_VALIDATE,
 		.flags = UTIL_OPT_FLAG_NOSHORT,
 	},
+	{
+		.option = { "jobs", required_argument, NULL, 'j'},
+		.argument = "NUMBER",
+		.desc = "Number of secure AES keys in the repository that are "
+			"validated in parallel. The default is 1",
+		.command = COMMAND_VALIDATE,
+	},
 	/***********************************************************/
 	{
 		.flags = UTIL_OPT_FLAG_SECTION,
@@ -1934,7 +1951,7 @@ static int command_reencipher_repository(void)
 
 	rc = keystore_reencipher_key(g.keystore, g.name, g.apqns, g.fromold,
 				     g.tonew, g.inplace, g.staged, g.complete,
-				     g.pkey_fd, &g.lib);
+				     g.pkey_fd, &g.lib, g.jobs);
 
 	return rc != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -2068,7 +2085,7 @@ static int command_validate_repository(void)
 	int rc;
 
 	rc = keystore_validate_key(g.keystore, g.name, g.apqns, g.noapqncheck,
-				   g.pkey_fd);
+				   g.pkey_fd, g.jobs);
 
 	return rc != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -3036,6 +3053,16 @@ int main(int argc, char *argv[])
 		case 'q':
 			g.batch_mode = 1;
 			break;
+		case 'j':
+			g.jobs = strtol(optarg, &endp, 0);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    g.jobs <= 0 || g.jobs > 256) {
+				warnx("Invalid value for '--jobs'|'-j': '%s'",
+				      optarg);
+				util_prg_print_parse_error();
+				return EXIT_FAILURE;
+			}
+			break;
 #ifdef HAVE_LUKS2_SUPPORT
 		case OPT_CRYPTSETUP_OPEN:
 			g.open = 1;